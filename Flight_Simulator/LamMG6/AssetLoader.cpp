@@ -0,0 +1,109 @@
+#include "AssetLoader.h"
+#include <iomanip>
+#include <sstream>
+
+using LoaderClock = std::chrono::high_resolution_clock;
+
+static double secondsSince(LoaderClock::time_point from)
+{
+    return std::chrono::duration<double>(LoaderClock::now() - from).count();
+}
+
+AssetLoader::AssetLoader(unsigned int nrOfThreads)
+    : pool(nrOfThreads)
+{
+    start = LoaderClock::now();
+}
+
+void AssetLoader::recordWorkerTime(const std::string& name, double seconds)
+{
+    std::lock_guard<std::mutex> lock(timesMutex);
+    workerTimes[name] = seconds;
+}
+
+void AssetLoader::queueMesh(const std::string& OBJfile)
+{
+    if (meshes.count(OBJfile))
+        return;
+    meshes[OBJfile] = pool.submit([this, OBJfile]() {
+        LoaderClock::time_point begin = LoaderClock::now();
+        OBJIndexedMesh mesh = LoadMeshData(OBJfile);
+        recordWorkerTime(OBJfile, secondsSince(begin));
+        return mesh;
+    });
+}
+
+void AssetLoader::queueTexture(const std::string& path)
+{
+    if (textures.count(path) || uploaded.count(path))
+        return;
+    textures[path] = pool.submit([this, path]() {
+        LoaderClock::time_point begin = LoaderClock::now();
+        TextureData data = LoadTextureData(path);
+        recordWorkerTime(path, secondsSince(begin));
+        return data;
+    });
+}
+
+OBJIndexedMesh AssetLoader::takeMesh(const std::string& OBJfile)
+{
+    queueMesh(OBJfile);
+    auto job = meshes.find(OBJfile);
+    OBJIndexedMesh mesh = job->second.get();
+    meshes.erase(job);
+    return mesh;
+}
+
+unsigned int AssetLoader::takeTexture(const std::string& path)
+{
+    //several meshes can share one image, it is decoded and uploaded once
+    auto done = uploaded.find(path);
+    if (done != uploaded.end())
+        return done->second;
+    TextureData data = takeTextureData(path);
+    unsigned int texture = uploadTexture(path, data);
+    uploaded[path] = texture;
+    return texture;
+}
+
+TextureData AssetLoader::takeTextureData(const std::string& path)
+{
+    queueTexture(path);
+    auto job = textures.find(path);
+    //already handed out by takeTexture, nothing was queued
+    if (job == textures.end())
+        return LoadTextureData(path);
+    TextureData data = job->second.get();
+    textures.erase(job);
+    return data;
+}
+
+unsigned int AssetLoader::uploadTexture(const std::string& path, TextureData& data)
+{
+    LoaderClock::time_point begin = LoaderClock::now();
+    unsigned int texture = UploadTextureData(data);
+    uploadTimes[path] = secondsSince(begin);
+    return texture;
+}
+
+void AssetLoader::report()
+{
+    std::lock_guard<std::mutex> lock(timesMutex);
+    double workerTotal = 0.0;
+    //formatted on the side, std::cout keeps its own flags
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "Asset loading on " << pool.size() << " threads:\n";
+    for (const auto& time : workerTimes)
+    {
+        workerTotal += time.second;
+        out << "  " << std::left << std::setw(44) << time.first << std::right
+            << std::setw(9) << time.second * 1000.0 << " ms";
+        auto upload = uploadTimes.find(time.first);
+        if (upload != uploadTimes.end())
+            out << "  upload " << std::setw(8) << upload->second * 1000.0 << " ms";
+        out << '\n';
+    }
+    out << "  worker time " << workerTotal * 1000.0 << " ms, wall time " << secondsSince(start) * 1000.0 << " ms\n";
+    std::cout << out.str();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include "ThreadPool.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+
+//Parses meshes and reads cooked or decodes images on worker threads; take* hands the
+//result back on the GL thread, where the upload happens.
+class AssetLoader
+{
+private:
+	ThreadPool pool;
+	std::map<std::string, std::future<OBJIndexedMesh>> meshes;
+	std::map<std::string, std::future<TextureData>> textures;
+	std::map<std::string, unsigned int> uploaded;
+	std::mutex timesMutex;
+	std::map<std::string, double> workerTimes;
+	std::map<std::string, double> uploadTimes;
+	std::chrono::high_resolution_clock::time_point start;
+
+	void recordWorkerTime(const std::string& name, double seconds);
+
+public:
+	AssetLoader(unsigned int nrOfThreads = std::thread::hardware_concurrency());
+	void queueMesh(const std::string& OBJfile);
+	void queueTexture(const std::string& path);
+	OBJIndexedMesh takeMesh(const std::string& OBJfile);
+	unsigned int takeTexture(const std::string& path);
+	//the decoded or cooked data alone, for callers that share textures themselves
+	TextureData takeTextureData(const std::string& path);
+	//timed for report(); not remembered, the caller owns the texture
+	unsigned int uploadTexture(const std::string& path, TextureData& data);
+	void report();
+};
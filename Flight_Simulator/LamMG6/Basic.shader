@@ -1,12 +1,8 @@
 #shader vertex
 #version 330 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aColor;
 layout(location = 2) in vec2 aTexCoord;
 layout(location = 3) in vec3 aNormal;
-layout(location = 4) in vec3 aAmbient;
-layout(location = 5) in vec3 aDiffuse;
-layout(location = 6) in vec3 aSpecular;
 
 out vec3 vs_FragPos;
 out vec3 vs_Color;
@@ -19,16 +15,32 @@ out vec3 vs_Specular;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+//the material of the range being drawn
+uniform int materialIndex;
+
+//per mesh material table, indexed by materialIndex (MaterialEntry in Material.h)
+struct Material
+{
+vec4 color;
+vec4 ambient;
+vec4 diffuse;
+vec4 specular;
+};
+layout(std140) uniform Materials
+{
+Material materials[16];
+};
 
 void main()
 {
+int id = clamp(materialIndex, 0, 15);
 vs_FragPos = vec4(model * vec4(aPos, 1.0f)).xyz;
-vs_Color = aColor;
+vs_Color = materials[id].color.rgb;
 vs_TexCoord = vec2(aTexCoord.x, aTexCoord.y * -1.f);
 vs_Normal = mat3(model) * aNormal;
-vs_Ambient = aAmbient;
-vs_Diffuse = aDiffuse;
-vs_Specular = aSpecular;
+vs_Ambient = materials[id].ambient.rgb;
+vs_Diffuse = materials[id].diffuse.rgb;
+vs_Specular = materials[id].specular.rgb;
 
 gl_Position = projection * view * vec4(vs_FragPos, 1.0f);
 }
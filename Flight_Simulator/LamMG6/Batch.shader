@@ -0,0 +1,106 @@
+#shader vertex
+#version 430 core
+layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in vec3 aNormal;
+//per instance, baseInstance of each indirect command selects the draw
+layout(location = 8) in uint aDrawID;
+
+out vec3 vs_FragPos;
+out vec3 vs_Color;
+out vec2 vs_TexCoord;
+out vec3 vs_Normal;
+out vec3 vs_Ambient;
+out vec3 vs_Diffuse;
+out vec3 vs_Specular;
+flat out int vs_TextureIndex;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+//BatchDraw and MaterialEntry in StaticBatch.h / Material.h
+struct BatchDraw
+{
+mat4 model;
+int textureIndex;
+int materialIndex;
+int padding0;
+int padding1;
+};
+struct Material
+{
+vec4 color;
+vec4 ambient;
+vec4 diffuse;
+vec4 specular;
+};
+layout(std430, binding = 1) readonly buffer BatchDraws
+{
+BatchDraw draws[];
+};
+layout(std430, binding = 2) readonly buffer BatchMaterials
+{
+Material materials[];
+};
+
+void main()
+{
+BatchDraw draw = draws[aDrawID];
+//each command is one material range, its draw points at that material
+int id = draw.materialIndex;
+vs_FragPos = vec4(draw.model * vec4(aPos, 1.0f)).xyz;
+vs_Color = materials[id].color.rgb;
+vs_TexCoord = aTexCoord;
+vs_Normal = mat3(draw.model) * aNormal;
+vs_Ambient = materials[id].ambient.rgb;
+vs_Diffuse = materials[id].diffuse.rgb;
+vs_Specular = materials[id].specular.rgb;
+vs_TextureIndex = draw.textureIndex;
+
+gl_Position = projection * view * vec4(vs_FragPos, 1.0f);
+}
+
+#shader fragment
+#version 430 core
+
+in vec3 vs_FragPos;
+in vec3 vs_Color;
+in vec2 vs_TexCoord;
+in vec3 vs_Normal;
+in vec3 vs_Ambient;
+in vec3 vs_Diffuse;
+in vec3 vs_Specular;
+flat in int vs_TextureIndex;
+out vec4 FragColor;
+
+uniform vec3 lightPos = vec3(2000.0f, 1002600.0f, 2000.0f);
+uniform vec3 viewPos;
+uniform vec3 lightColor;
+uniform int n = 1;
+//one texture per multi-draw, StaticBatch groups the commands by it
+uniform sampler2D batchTexture;
+
+void main()
+{
+//textured objects: terrain.shader
+if (vs_TextureIndex >= 0)
+{
+	vec4 texColor = texture(batchTexture, vs_TexCoord);
+	if (texColor.a < 0.1)
+		discard;
+	FragColor = texColor * vec4(lightColor, 1.0f);
+	return;
+}
+
+//material colored objects: Basic.shader
+vec3 ambiental = (vec4(lightColor, 1.f) * vec4(vs_Ambient, 1.f)).xyz;
+
+vec3 lightDir = normalize(vs_FragPos - lightPos);
+vec3 viewDir = normalize(viewPos - vs_FragPos);
+vec3 reflectDir = reflect(lightDir, vs_Normal);
+float specFactor = pow(max(dot(viewDir, reflectDir), 0.0f), n);
+vec3 diffuse = lightColor * vs_Diffuse * clamp(dot(lightDir, vs_Normal), 0, 1);
+vec3 specular = vs_Specular.x * specFactor * (lightColor - vec3(0.1f, 0.1f, 0.1f));
+
+FragColor = (vec4((diffuse + ambiental), 1.0f) + 0.2f * vec4(specular, 1.0f)) * vec4(vs_Color, 1.0f) * 0.8f + 0.2f * vec4(specular, 1.0f);
+}
@@ -0,0 +1,1801 @@
+#include "Benchmark.h"
+#include "OBJLoader.h"
+#include "MeshCache.h"
+#include "AssetLoader.h"
+#include "Frustum.h"
+#include "Terrain.h"
+#include "TerrainStreamer.h"
+#include "TerrainQuery.h"
+#include "Bvh.h"
+#include "Transform.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "ResourceManager.h"
+#include "FlightModel.h"
+#include "ThreadPool.h"
+#include "GLState.h"
+#include "GLStats.h"
+#include "ProcessMemory.h"
+#include <glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <list>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <gtc/matrix_transform.hpp>
+
+//one "name ... ok/FAIL" line per check; the Verify* modes end with finish()
+class SelfCheck
+{
+private:
+    int failed = 0;
+
+public:
+    void operator()(const std::string& name, bool passed)
+    {
+        std::cout << std::left << std::setw(48) << name << std::right << (passed ? "ok" : "FAIL") << '\n';
+        if (!passed)
+            failed++;
+    }
+    //prints PASS or FAIL, true when every check passed
+    bool finish() const
+    {
+        std::cout << (failed == 0 ? "PASS" : "FAIL") << '\n';
+        return failed == 0;
+    }
+};
+
+//invisible window whose context is current while it lives, for the modes that need GL
+class HiddenWindow
+{
+private:
+    GLFWwindow* window = nullptr;
+
+public:
+    HiddenWindow(int width, int height, const char* title)
+    {
+        if (!glfwInit())
+            return;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(width, height, title, NULL, NULL);
+        if (!window)
+        {
+            glfwTerminate();
+            return;
+        }
+        glfwMakeContextCurrent(window);
+        glewInit();
+    }
+    ~HiddenWindow()
+    {
+        if (!window)
+            return;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    HiddenWindow(const HiddenWindow&) = delete;
+    HiddenWindow& operator=(const HiddenWindow&) = delete;
+    explicit operator bool() const { return window != nullptr; }
+};
+
+//materials off for loadOBJ, which numbers usemtl lines in order instead of by name
+static bool sameVertices(const std::vector<Vertex>& a, const std::vector<Vertex>& b, bool materials = true)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].position != b[i].position || a[i].texcoord != b[i].texcoord ||
+            a[i].normal != b[i].normal || (materials && a[i].colorID != b[i].colorID))
+            return false;
+    }
+    return true;
+}
+
+//a loadOBJFast triangle soup in the order loadOBJIndexed draws it: grouped by material,
+//file order kept within each
+static std::vector<Vertex> groupByMaterial(const std::vector<Vertex>& soup)
+{
+    std::vector<size_t> triangles(soup.size() / 3);
+    for (size_t t = 0; t < triangles.size(); t++)
+        triangles[t] = t;
+    std::stable_sort(triangles.begin(), triangles.end(), [&soup](size_t a, size_t b) { return soup[a * 3].colorID < soup[b * 3].colorID; });
+    std::vector<Vertex> grouped;
+    grouped.reserve(soup.size());
+    for (size_t t : triangles)
+        grouped.insert(grouped.end(), soup.begin() + t * 3, soup.begin() + t * 3 + 3);
+    return grouped;
+}
+
+//the triangle soup an index buffer draws, for comparing against loadOBJFast
+static std::vector<Vertex> expandIndexed(const OBJIndexedMesh& mesh)
+{
+    std::vector<Vertex> soup;
+    soup.reserve(mesh.indices.size());
+    for (GLuint index : mesh.indices)
+        soup.push_back(mesh.vertices[index]);
+    return soup;
+}
+
+template <typename Loader>
+static double timeLoader(Loader loader, const std::string& file, std::vector<Vertex>& vertices)
+{
+    const int runs = 3;
+    double best = 1e30;
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::pair <std::vector<Vertex>, std::vector<Material>> result = loader(file.c_str());
+        auto stop = std::chrono::high_resolution_clock::now();
+        vertices = std::move(result.first);
+        best = std::min(best, std::chrono::duration<double>(stop - start).count());
+    }
+    return best;
+}
+
+void BenchmarkOBJLoaders(const std::string& directory)
+{
+    struct Row
+    {
+        std::string file;
+        double megabytes;
+        size_t vertices;
+        double streamTime;
+        double fastTime;
+        double indexedTime;
+        size_t uniqueVertices;
+        bool match;
+    };
+    std::vector<Row> rows;
+
+    for (const std::string& file : findOBJFiles(directory))
+    {
+        Row row;
+        row.file = std::filesystem::relative(file, directory).string();
+        row.megabytes = std::filesystem::file_size(file) / 1e6;
+        std::vector<Vertex> streamVertices, fastVertices;
+        row.streamTime = timeLoader(loadOBJ, file, streamVertices);
+        row.fastTime = timeLoader(loadOBJFast, file, fastVertices);
+        row.vertices = fastVertices.size();
+
+        OBJIndexedMesh indexed;
+        row.indexedTime = 1e30;
+        for (int i = 0; i < 3; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            indexed = loadOBJIndexed(file.c_str());
+            auto stop = std::chrono::high_resolution_clock::now();
+            row.indexedTime = std::min(row.indexedTime, std::chrono::duration<double>(stop - start).count());
+        }
+        row.uniqueVertices = indexed.vertices.size();
+        row.match = sameVertices(streamVertices, fastVertices, false) && sameVertices(groupByMaterial(fastVertices), expandIndexed(indexed));
+        rows.push_back(row);
+    }
+
+    std::cout << "\n" << std::left << std::setw(42) << "file" << std::right
+        << std::setw(10) << "MB" << std::setw(12) << "vertices"
+        << std::setw(14) << "stream MB/s" << std::setw(14) << "fast MB/s"
+        << std::setw(16) << "stream vert/s" << std::setw(16) << "fast vert/s"
+        << std::setw(14) << "indexed MB/s" << std::setw(10) << "unique" << std::setw(8) << "dedup" << "  same\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const Row& row : rows)
+    {
+        std::cout << std::left << std::setw(42) << row.file << std::right
+            << std::setw(10) << row.megabytes << std::setw(12) << row.vertices
+            << std::setw(14) << row.megabytes / row.streamTime << std::setw(14) << row.megabytes / row.fastTime
+            << std::setw(16) << std::setprecision(0) << row.vertices / row.streamTime
+            << std::setw(16) << row.vertices / row.fastTime << std::setprecision(2)
+            << std::setw(14) << row.megabytes / row.indexedTime << std::setw(10) << row.uniqueVertices
+            << std::setw(7) << (row.uniqueVertices ? (double)row.vertices / row.uniqueVertices : 0.0) << "x"
+            << "  " << (row.match ? "yes" : "NO") << '\n';
+    }
+}
+
+
+void BenchmarkMeshCache(const std::string& directory)
+{
+    double totalText = 0.0, totalBinary = 0.0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const std::string& file : findOBJFiles(directory))
+    {
+        double textTime = 1e30, binaryTime = 1e30;
+        OBJIndexedMesh text, binary;
+        for (int i = 0; i < 3; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            text = loadOBJIndexed(file.c_str());
+            auto stop = std::chrono::high_resolution_clock::now();
+            textTime = std::min(textTime, std::chrono::duration<double>(stop - start).count());
+        }
+        SaveMeshCache(file, text);
+        for (int i = 0; i < 3; i++)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            bool hit = LoadMeshCache(file, binary);
+            auto stop = std::chrono::high_resolution_clock::now();
+            if (!hit)
+                binaryTime = 1e30;
+            else
+                binaryTime = std::min(binaryTime, std::chrono::duration<double>(stop - start).count());
+        }
+        bool same = sameVertices(text.vertices, binary.vertices) && text.indices == binary.indices;
+        totalText += textTime;
+        totalBinary += binaryTime;
+        std::cout << std::left << std::setw(42) << std::filesystem::relative(file, directory).string() << std::right
+            << "  text " << std::setw(9) << textTime * 1000.0 << " ms"
+            << "  binary " << std::setw(9) << binaryTime * 1000.0 << " ms"
+            << "  " << (same ? "yes" : "NO") << '\n';
+    }
+    std::cout << "total: text " << totalText * 1000.0 << " ms, binary " << totalBinary * 1000.0 << " ms\n";
+}
+
+void ReportVertexMemory(const std::string& directory)
+{
+    size_t totalFull = 0, totalCompact = 0, totalIndices = 0;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Vertex " << sizeof(Vertex) << " bytes, CompactVertex " << sizeof(CompactVertex) << " bytes\n";
+    for (const std::string& file : findOBJFiles(directory))
+    {
+        OBJIndexedMesh mesh = loadOBJIndexed(file.c_str());
+        size_t indexBytes = mesh.indices.size() * sizeof(GLuint);
+        size_t full = mesh.vertices.size() * sizeof(Vertex);
+        size_t compact = mesh.vertices.size() * sizeof(CompactVertex);
+        totalFull += full;
+        totalCompact += compact;
+        totalIndices += indexBytes;
+        std::cout << std::left << std::setw(42) << std::filesystem::relative(file, directory).string() << std::right
+            << "  vertices full " << std::setw(8) << full / 1024.0 << " KB"
+            << "  compact " << std::setw(8) << compact / 1024.0 << " KB"
+            << "  indices " << std::setw(8) << indexBytes / 1024.0 << " KB"
+            << "  total " << std::setw(4) << (double)(full + indexBytes) / (compact + indexBytes) << "x\n";
+    }
+    std::cout << "total vertices: full " << totalFull / 1024.0 << " KB, compact " << totalCompact / 1024.0 << " KB ("
+        << (double)totalFull / totalCompact << "x), indices " << totalIndices / 1024.0 << " KB\n";
+}
+
+void BenchmarkMaterials(const std::string& OBJfile)
+{
+    using clock = std::chrono::high_resolution_clock;
+    auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+    //before: expanded vertices, materials baked by a materials x vertices loop, setColor scans every vertex
+    auto start = clock::now();
+    std::pair <std::vector<Vertex>, std::vector<Material>> legacy = loadOBJ(OBJfile.c_str());
+    auto loaded = clock::now();
+    for (size_t i = 0; i < legacy.second.size(); i++)
+    {
+        for (size_t j = 0; j < legacy.first.size(); j++)
+        {
+            if (legacy.first[j].colorID == (GLint)i)
+            {
+                legacy.first[j].ambient = legacy.second[i].ambient;
+                legacy.first[j].diffuse = legacy.second[i].diffuse;
+                legacy.first[j].specular = legacy.second[i].specular;
+            }
+        }
+    }
+    for (Vertex& vertex : legacy.first)
+    {
+        if (vertex.colorID == 0)
+            vertex.color = glm::vec3(0.8f, 0.15f, 0.3f);
+    }
+    auto legacyDone = clock::now();
+
+    //after: indexed load, material table, setColor touches one entry
+    auto start2 = clock::now();
+    OBJIndexedMesh mesh = loadOBJIndexed(OBJfile.c_str());
+    auto loaded2 = clock::now();
+    std::vector<MaterialEntry> table(std::min(mesh.materials.size(), (size_t)MAX_MATERIALS));
+    for (size_t i = 0; i < table.size(); i++)
+    {
+        table[i].color = glm::vec4(1.0f, 0.0f, 1.0f, 1.0f);
+        table[i].ambient = glm::vec4(mesh.materials[i].ambient, 1.0f);
+        table[i].diffuse = glm::vec4(mesh.materials[i].diffuse, 1.0f);
+        table[i].specular = glm::vec4(mesh.materials[i].specular, 1.0f);
+    }
+    if (!table.empty())
+        table[0].color = glm::vec4(0.8f, 0.15f, 0.3f, 1.0f);
+    auto tableDone = clock::now();
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << OBJfile << "\n"
+        << "  before: load " << ms(start, loaded) << " ms, materials " << ms(loaded, legacyDone) << " ms, total " << ms(start, legacyDone) << " ms\n"
+        << "  after:  load " << ms(start2, loaded2) << " ms, materials " << ms(loaded2, tableDone) << " ms, total " << ms(start2, tableDone) << " ms\n";
+    std::cout << out.str();
+}
+
+bool VerifyParallelLoading(const std::vector<std::string>& files)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::vector<OBJIndexedMesh> serial, parallel;
+
+    //warm the .mgmesh caches so both passes read the same inputs
+    for (const std::string& file : files)
+        LoadMeshData(file);
+
+    auto start = clock::now();
+    for (const std::string& file : files)
+        serial.push_back(LoadMeshData(file));
+    double serialTime = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    {
+        AssetLoader loader;
+        for (const std::string& file : files)
+            loader.queueMesh(file);
+        for (const std::string& file : files)
+            parallel.push_back(loader.takeMesh(file));
+        loader.report();
+    }
+    double parallelTime = std::chrono::duration<double>(clock::now() - start).count();
+
+    bool same = true;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        bool match = serial[i].vertices.size() == parallel[i].vertices.size() &&
+            serial[i].indices.size() == parallel[i].indices.size() &&
+            serial[i].materials.size() == parallel[i].materials.size();
+        same = same && match;
+        std::cout << std::left << std::setw(32) << files[i] << std::right << std::setw(10) << serial[i].vertices.size()
+            << std::setw(10) << parallel[i].vertices.size() << "  " << (match ? "ok" : "MISMATCH") << '\n';
+    }
+    std::cout << std::fixed << std::setprecision(2) << "serial " << serialTime * 1000.0 << " ms, parallel "
+        << parallelTime * 1000.0 << " ms: " << (same ? "PASS" : "FAIL") << '\n';
+    return same;
+}
+
+bool VerifyFrustumCulling()
+{
+    SelfCheck check;
+    auto sphere = [](glm::vec3 center, float radius) {
+        BoundingSphere result;
+        result.center = center;
+        result.radius = radius;
+        return result;
+    };
+    auto box = [](glm::vec3 min, glm::vec3 max) {
+        AABB result;
+        result.min = min;
+        result.max = max;
+        return result;
+    };
+
+    //camera at the origin looking down -z, 90 degrees wide, near 1, far 100
+    glm::mat4 projection = glm::perspective(glm::radians(90.f), 1.f, 1.f, 100.f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+    Frustum frustum(projection * view);
+
+    check("sphere in front", frustum.intersects(sphere(glm::vec3(0.f, 0.f, -10.f), 1.f)));
+    check("sphere behind", !frustum.intersects(sphere(glm::vec3(0.f, 0.f, 10.f), 1.f)));
+    check("sphere beyond far", !frustum.intersects(sphere(glm::vec3(0.f, 0.f, -110.f), 1.f)));
+    check("sphere straddling far", frustum.intersects(sphere(glm::vec3(0.f, 0.f, -100.5f), 1.f)));
+    check("sphere left of the 45 degree plane", !frustum.intersects(sphere(glm::vec3(-20.f, 0.f, -10.f), 1.f)));
+    check("sphere touching the left plane", frustum.intersects(sphere(glm::vec3(-11.f, 0.f, -10.f), 1.f)));
+    check("sphere above", !frustum.intersects(sphere(glm::vec3(0.f, 30.f, -10.f), 2.f)));
+    check("box in front", frustum.intersects(box(glm::vec3(-1.f, -1.f, -6.f), glm::vec3(1.f, 1.f, -4.f))));
+    check("box behind", !frustum.intersects(box(glm::vec3(-1.f, -1.f, 2.f), glm::vec3(1.f, 1.f, 4.f))));
+    check("box right of the frustum", !frustum.intersects(box(glm::vec3(20.f, -1.f, -6.f), glm::vec3(22.f, 1.f, -4.f))));
+    check("box straddling the near plane", frustum.intersects(box(glm::vec3(-1.f, -1.f, -2.f), glm::vec3(1.f, 1.f, 2.f))));
+    check("box around the camera", frustum.intersects(box(glm::vec3(-500.f), glm::vec3(500.f))));
+    check("default frustum accepts everything", Frustum().intersects(sphere(glm::vec3(1e6f), 0.f)));
+
+    //same answers from the SSE and scalar paths on random input, against a turned camera
+    glm::mat4 turned = glm::lookAt(glm::vec3(10.f, 5.f, 3.f), glm::vec3(-2.f, 1.f, -7.f), glm::vec3(0.f, 1.f, 0.f));
+    Frustum turnedFrustum(glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 200.f) * turned);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> coordinate(-150.f, 150.f);
+    std::uniform_real_distribution<float> extent(0.f, 20.f);
+    const size_t count = 10003;
+    std::vector<float> x(count), y(count), z(count), radius(count);
+    std::vector<uint8_t> visible(count);
+    bool spheresAgree = true, boxesAgree = true;
+    size_t expected = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        x[i] = coordinate(random);
+        y[i] = coordinate(random);
+        z[i] = coordinate(random);
+        radius[i] = extent(random);
+        BoundingSphere s = sphere(glm::vec3(x[i], y[i], z[i]), radius[i]);
+        bool inside = turnedFrustum.intersectsScalar(s);
+        expected += inside;
+        spheresAgree = spheresAgree && inside == turnedFrustum.intersects(s);
+        AABB b = box(s.center, s.center + glm::vec3(extent(random), extent(random), extent(random)));
+        boxesAgree = boxesAgree && turnedFrustum.intersectsScalar(b) == turnedFrustum.intersects(b);
+    }
+    size_t nrVisible = turnedFrustum.cullSpheres(x.data(), y.data(), z.data(), radius.data(), count, visible.data());
+    bool batchAgrees = nrVisible == expected;
+    for (size_t i = 0; i < count && batchAgrees; i++)
+        batchAgrees = (visible[i] != 0) == turnedFrustum.intersectsScalar(sphere(glm::vec3(x[i], y[i], z[i]), radius[i]));
+    check("SSE sphere test matches scalar", spheresAgree);
+    check("SSE box test matches scalar", boxesAgree);
+    check("cullSpheres matches scalar", batchAgrees);
+    std::cout << "  " << nrVisible << " of " << count << " random spheres visible\n";
+
+    //transformed box equals the box around the 8 transformed corners
+    AABB local = box(glm::vec3(-1.f, -2.f, -3.f), glm::vec3(4.f, 5.f, 6.f));
+    glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(7.f, -3.f, 2.f));
+    model = glm::rotate(model, glm::radians(37.f), glm::normalize(glm::vec3(1.f, 2.f, 3.f)));
+    model = glm::scale(model, glm::vec3(2.f, 0.5f, 3.f));
+    AABB world = TransformAABB(local, model);
+    glm::vec3 cornerMin(1e30f), cornerMax(-1e30f);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 p((corner & 1) ? local.max.x : local.min.x, (corner & 2) ? local.max.y : local.min.y, (corner & 4) ? local.max.z : local.min.z);
+        p = glm::vec3(model * glm::vec4(p, 1.f));
+        cornerMin = glm::min(cornerMin, p);
+        cornerMax = glm::max(cornerMax, p);
+    }
+    check("TransformAABB matches transformed corners", glm::length(world.min - cornerMin) < 1e-4f && glm::length(world.max - cornerMax) < 1e-4f);
+
+    //radius follows the largest scale, the center follows the matrix
+    BoundingSphere scaled = TransformSphere(sphere(glm::vec3(1.f, 0.f, 0.f), 2.f), glm::scale(glm::mat4(1.f), glm::vec3(1.f, 3.f, 0.5f)));
+    check("TransformSphere under non-uniform scale", std::abs(scaled.radius - 6.f) < 1e-5f && glm::length(scaled.center - glm::vec3(1.f, 0.f, 0.f)) < 1e-5f);
+
+    return check.finish();
+}
+
+void BenchmarkTerrain(int size)
+{
+    using clock = std::chrono::high_resolution_clock;
+    auto start = clock::now();
+    Heightmap heightmap = GenerateHeightmap(size, 7);
+    double generateTime = std::chrono::duration<double>(clock::now() - start).count();
+
+    const int width = 1280, height = 720;
+    HiddenWindow window(width, height, "Terrain benchmark");
+    if (!window)
+        return;
+    glViewport(0, 0, width, height);
+    glState.setDepthTest(true);
+    {
+        Shader shader;
+        shader.Set("terrain.shader");
+        start = clock::now();
+        Terrain terrain(heightmap);
+        double treeTime = std::chrono::duration<double>(clock::now() - start).count();
+        std::cout << std::fixed << std::setprecision(1) << size << 'x' << size << " samples generated in " << generateTime * 1000.0
+            << " ms, " << terrain.getLevels() << " level quadtree in " << treeTime * 1000.0 << " ms\n";
+        terrain.initGPU();
+
+        //one pass over the map 300 m above the ground, weaving and looking down ahead
+        const int frames = 1000;
+        const float fovY = glm::radians(45.f);
+        glm::mat4 projection = glm::perspective(fovY, (float)width / height, 1.f, 1e6f);
+        float extentX = (heightmap.width - 1) * heightmap.spacingX;
+        float extentZ = (heightmap.height - 1) * heightmap.spacingZ;
+        double updateTime = 0.0, frameTime = 0.0, maxUpdate = 0.0, maxFrame = 0.0;
+        size_t triangles = 0, maxTriangles = 0, chunks = 0, builds = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            float t = (frame + 0.5f) / frames;
+            glm::vec3 eye(extentX * (0.05f + 0.9f * t), 0.f, extentZ * (0.5f + 0.3f * std::sin(t * 12.566f)));
+            eye.y = heightmap.at((int)(eye.x / heightmap.spacingX), (int)(eye.z / heightmap.spacingZ)) + 300.f;
+            eye += heightmap.origin * glm::vec3(1.f, 0.f, 1.f);
+            glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(1.f, -0.2f, 0.3f * std::cos(t * 12.566f)), glm::vec3(0.f, 1.f, 0.f));
+            Frustum frustum(projection * view);
+
+            auto frameStart = clock::now();
+            terrain.update(eye, frustum, (float)height, fovY);
+            double update = std::chrono::duration<double>(clock::now() - frameStart).count();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.Use();
+            shader.SetMat4(shader.ViewUniform, view);
+            shader.SetMat4(shader.ProjectionUniform, projection);
+            terrain.draw(&shader);
+            glFinish();
+            double total = std::chrono::duration<double>(clock::now() - frameStart).count();
+
+            updateTime += update;
+            frameTime += total;
+            maxUpdate = std::max(maxUpdate, update);
+            maxFrame = std::max(maxFrame, total);
+            triangles += terrain.getDrawnTriangles();
+            maxTriangles = std::max(maxTriangles, terrain.getDrawnTriangles());
+            chunks += terrain.getDrawnChunks();
+            builds += terrain.getBuildsLastUpdate();
+        }
+        std::cout << std::setprecision(3) << "LOD update " << updateTime * 1000.0 / frames << " ms avg, " << maxUpdate * 1000.0
+            << " ms max; frame with GPU " << frameTime * 1000.0 / frames << " ms avg, " << maxFrame * 1000.0 << " ms max\n";
+        std::cout << chunks / frames << " chunks, " << triangles / frames << " triangles avg, " << maxTriangles << " max (bound "
+            << terrain.getMaxTriangles() << "), " << (double)builds / frames << " chunk builds/frame, "
+            << (size_t)heightmap.width * heightmap.height * 2 << " triangles at full resolution\n";
+    }
+}
+
+bool VerifyHgtStreaming()
+{
+    SelfCheck check;
+
+    int latitude = 0, longitude = 0;
+    check("tile names", HgtName(45, 24) == "N45E024.hgt" && HgtName(-12, -77) == "S12W077.hgt");
+    check("parse S12W077.hgt", ParseHgtName("SRTM/S12W077.hgt", latitude, longitude) && latitude == -12 && longitude == -77);
+    check("reject Transilvania.hgt", !ParseHgtName("Transilvania.hgt", latitude, longitude));
+
+    //2 rows x 3 columns of tiles from N45E024 to N46E026
+    const int size = 241;
+    const unsigned int seed = 11;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "LamMG6_hgt_test";
+    std::filesystem::remove_all(directory);
+    check("write synthetic tiles", WriteSyntheticHgt(directory.string(), 45, 24, 2, 3, size, seed));
+
+    HgtTile southWest, southEast, northWest;
+    check("map N45E024", southWest.open((directory / "N45E024.hgt").string()) && southWest.getSize() == size);
+    southEast.open((directory / "N45E025.hgt").string());
+    northWest.open((directory / "N46E024.hgt").string());
+    //N45E024 is the bottom left of the generated relief
+    Heightmap relief = GenerateHeightmap((size - 1) * 3 + 1, seed);
+    bool same = true;
+    for (int row = 0; row < size; row++)
+    {
+        for (int column = 0; column < size; column++)
+            same = same && southWest.sample(column, row) == relief.samples[(size_t)(size - 1 + row) * relief.width + column];
+    }
+    check("mapped big-endian samples match", same);
+    bool east = true, north = true;
+    for (int k = 0; k < size; k++)
+    {
+        east = east && southWest.sample(size - 1, k) == southEast.sample(0, k);
+        north = north && southWest.sample(k, 0) == northWest.sample(k, size - 1);
+    }
+    check("east neighbour shares the border column", east);
+    check("north neighbour shares the border row", north);
+
+    GeoOrigin origin;
+    origin.latitude = 45.0;
+    origin.longitude = 24.0;
+    Heightmap west = HgtToHeightmap(southWest, origin), eastMap = HgtToHeightmap(southEast, origin);
+    glm::vec3 edge = west.position(size - 1, size / 2), neighbour = eastMap.position(0, size / 2);
+    check("neighbours line up on the plane", glm::length(edge - neighbour) < 0.05f);
+    glm::vec3 corner = west.position(0, size - 1);
+    check("south west corner at the origin", glm::length(corner - glm::vec3(0.f, corner.y, 0.f)) < 0.05f);
+
+    //a void takes the sample before it
+    std::filesystem::path voids = directory / "voids";
+    std::filesystem::create_directories(voids);
+    {
+        const unsigned char bytes[] = { 0x00, 0x64, 0x80, 0x00, 0x00, 0x10, 0x00, 0x01 };
+        std::ofstream out(voids / "N00E000.hgt", std::ios::binary);
+        out.write((const char*)bytes, sizeof(bytes));
+    }
+    HgtTile voidTile;
+    voidTile.open((voids / "N00E000.hgt").string());
+    Heightmap filled = HgtToHeightmap(voidTile, GeoOrigin());
+    check("void filled from the previous sample", filled.samples.size() == 4 && filled.samples[0] == 100 && filled.samples[1] == 100 && filled.samples[2] == 16);
+
+    //a budget for two and a half tiles: the third one pushes out the least recently used
+    TerrainStreamerSettings settings;
+    settings.radius = 0;
+    size_t tileBytes = west.samples.size() * sizeof(int16_t) + Terrain(west, settings.terrain).getMemoryBytes();
+    settings.memoryBudget = tileBytes * 5 / 2;
+    TerrainStreamer streamer(directory.string(), settings);
+    streamer.setOrigin(origin);
+    check("index finds the 6 tiles", streamer.getAvailableTiles() == 6);
+    auto flyTo = [&](double lat, double lon) {
+        streamer.update(origin.toLocal(lat, lon));
+        streamer.waitForLoads();
+    };
+    flyTo(45.5, 24.5);
+    check("tile under the aircraft pages in", streamer.isLoaded(45, 24) && streamer.getLoadedTiles() == 1);
+    //the query kept with the tile, against one over the same map, and after the streamer moves
+    glm::vec3 point = origin.toLocal(45.3, 24.6);
+    GroundSample streamed, direct;
+    bool sampled = streamer.sample(point.x, point.z, streamed) && TerrainQuery(west).sample(point.x, point.z, direct);
+    check("a loaded tile samples the ground", sampled && streamed.height == direct.height);
+    streamer.setModel(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 100.f, 0.f)));
+    sampled = streamer.sample(point.x, point.z, streamed);
+    check("its query follows setModel", sampled && std::abs(streamed.height - direct.height - 100.f) < 1e-3f);
+    streamer.setModel(glm::mat4(1.f));
+    flyTo(45.5, 25.5);
+    flyTo(45.5, 26.5);
+    streamer.update(origin.toLocal(45.5, 26.5));
+    check("least recently used tile evicted", !streamer.isLoaded(45, 24) && streamer.isLoaded(45, 25) && streamer.isLoaded(45, 26));
+    check("resident bytes within budget", streamer.getResidentBytes() <= settings.memoryBudget && streamer.getEvictions() == 1);
+    flyTo(50.5, 30.5);
+    check("nothing requested off the tile set", streamer.getLoadedTiles() == 2 && streamer.getLoads() == 3);
+
+    std::filesystem::remove_all(directory);
+    return check.finish();
+}
+
+void BenchmarkHgtStreaming(int size)
+{
+    using clock = std::chrono::high_resolution_clock;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "LamMG6_hgt_bench";
+    std::filesystem::remove_all(directory);
+    auto start = clock::now();
+    if (!WriteSyntheticHgt(directory.string(), 45, 20, 6, 6, size, 5))
+        return;
+    std::cout << std::fixed << std::setprecision(1) << "36 tiles of " << size << 'x' << size << " written in "
+        << std::chrono::duration<double>(clock::now() - start).count() * 1000.0 << " ms\n";
+
+    //diagonal from N45E020 to N50E025 at 60 frames a second, one tile every 100 frames
+    TerrainStreamerSettings settings;
+    settings.memoryBudget = (size_t)128 * 1024 * 1024;
+    {
+        TerrainStreamer streamer(directory.string(), settings);
+        const int frames = 600;
+        int waiting = 0;
+        size_t peakBytes = 0;
+        double updateTime = 0.0, maxUpdate = 0.0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            auto frameStart = clock::now();
+            double t = (frame + 0.5) / frames;
+            double latitude = 45.0 + 6.0 * t, longitude = 20.0 + 6.0 * t;
+            streamer.update(streamer.getOrigin().toLocal(latitude, longitude));
+            double update = std::chrono::duration<double>(clock::now() - frameStart).count();
+            updateTime += update;
+            maxUpdate = std::max(maxUpdate, update);
+            peakBytes = std::max(peakBytes, streamer.getResidentBytes());
+            if (!streamer.isLoaded((int)std::floor(latitude), (int)std::floor(longitude)))
+                waiting++;
+            std::this_thread::sleep_until(frameStart + std::chrono::microseconds(16667));
+        }
+        std::cout << std::setprecision(3) << streamer.getLoads() << " page-ins, " << streamer.getAveragePageIn() * 1000.0 << " ms avg, "
+            << streamer.getMaxPageIn() * 1000.0 << " ms max (map, decode, quadtree on a worker); " << streamer.getEvictions() << " evictions\n";
+        std::cout << "update " << updateTime * 1000.0 / frames << " ms avg, " << maxUpdate * 1000.0 << " ms max; peak "
+            << peakBytes / (1024 * 1024) << " MB of " << settings.memoryBudget / (1024 * 1024) << " MB budget; "
+            << waiting << " of " << frames << " frames without the tile under the aircraft\n";
+    }
+    std::filesystem::remove_all(directory);
+}
+
+//take off, turn left, level, turn right, throttle back to the ground
+static FlightControls FlightScript(double time)
+{
+    FlightControls controls;
+    controls.throttleUp = time < 18.0;
+    controls.left = time >= 15.0 && time < 18.0;
+    controls.right = time >= 22.0 && time < 25.0;
+    controls.throttleDown = time >= 25.0;
+    return controls;
+}
+
+//every step's starting state for frames of frameTime(frame) seconds until seconds have been simulated
+static std::vector<FlightState> ReplayFlight(double rate, double seconds, const std::function<double(int)>& frameTime)
+{
+    FlightModel model(rate);
+    model.reset(FlightState());
+    std::vector<FlightState> trajectory;
+    for (int frame = 0; model.getTime() < seconds; frame++)
+    {
+        model.advance(frameTime(frame), [&](double time) {
+            trajectory.push_back(model.getState());
+            return FlightScript(time);
+        });
+    }
+    trajectory.push_back(model.getState());
+    return trajectory;
+}
+
+static bool SameFlight(const FlightState& a, const FlightState& b)
+{
+    return a.position == b.position && a.rotation == b.rotation && a.speed == b.speed &&
+        a.turnSpeed == b.turnSpeed && a.tiltSpeed == b.tiltSpeed && a.grounded == b.grounded && a.crashed == b.crashed;
+}
+
+bool VerifyFlightReplay()
+{
+    SelfCheck check;
+
+    const double seconds = 40.0;
+    const size_t steps = 4800;
+    std::vector<FlightState> reference = ReplayFlight(120.0, seconds, [](int) { return 1.0 / 60.0; });
+    check("60 fps replay covers 40 s", reference.size() > steps);
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> jitter(0.002, 0.05);
+    std::vector<double> jittered(20000);
+    for (double& frame : jittered)
+        frame = jitter(random);
+    struct Run
+    {
+        const char* name;
+        std::function<double(int)> frameTime;
+    };
+    Run runs[] = {
+        { "same steps at 30 fps", [](int) { return 1.0 / 30.0; } },
+        { "same steps at 144 fps", [](int) { return 1.0 / 144.0; } },
+        { "same steps at 1000 fps", [](int) { return 0.001; } },
+        { "same steps with 2-50 ms jitter", [&jittered](int frame) { return jittered[frame]; } },
+        { "same steps replaying 60 fps again", [](int) { return 1.0 / 60.0; } },
+    };
+    for (const Run& run : runs)
+    {
+        std::vector<FlightState> trajectory = ReplayFlight(120.0, seconds, run.frameTime);
+        bool same = trajectory.size() > steps;
+        for (size_t i = 0; i < steps && same; i++)
+            same = SameFlight(trajectory[i], reference[i]);
+        check(run.name, same);
+    }
+
+    //the script's effect on the aircraft
+    const FlightState& takeOff = reference[15 * 120];
+    const FlightState& turned = reference[18 * 120];
+    check("airborne after 15 s of throttle", takeOff.position.y > 0.f && !takeOff.grounded);
+    check("left turn raises the heading", turned.rotation.y > takeOff.rotation.y + 1.f);
+    check("back on the ground after throttling down", reference[steps].grounded && reference[steps].speed < 0.5f);
+
+    //a coarser step lands close to the same place: the increments scale with the step
+    std::vector<FlightState> coarse = ReplayFlight(60.0, seconds, [](int) { return 1.0 / 60.0; });
+    glm::vec3 fine = reference[18 * 120].position, rough = coarse[18 * 60].position;
+    float travelled = glm::length(fine - reference[0].position);
+    std::cout << "  60 Hz vs 120 Hz after 18 s: " << glm::length(fine - rough) << " apart over " << travelled << '\n';
+    check("60 Hz and 120 Hz within 2% of the path", glm::length(fine - rough) < 0.02f * travelled);
+
+    //half a step left over draws halfway between the last two steps
+    FlightModel half, whole;
+    FlightState moving;
+    moving.speed = 0.9f;
+    half.reset(moving);
+    whole.reset(moving);
+    half.advance(half.getStep() * 1.5, FlightScript);
+    whole.advance(whole.getStep(), FlightScript);
+    glm::vec3 midpoint = (whole.interpolated().position + whole.getState().position) * 0.5f;
+    check("interpolates by the leftover time", glm::length(half.interpolated().position - midpoint) < 1e-4f);
+
+    return check.finish();
+}
+
+void SimulateFlightBatch(size_t count, double seconds)
+{
+    using clock = std::chrono::high_resolution_clock;
+    const double rate = 120.0;
+    const float dt = (float)(1.0 / rate);
+    const size_t steps = (size_t)(seconds * rate);
+
+    //take-off runs of different lengths, a turn somewhere in the climb, landings at different times
+    FlightBatch start;
+    start.resize(count);
+    std::mt19937 random(2024);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    for (size_t i = 0; i < count; i++)
+    {
+        FlightPlan& plan = start.plans[i];
+        plan.throttleUpUntil = 14.f + 16.f * unit(random);
+        plan.turnFrom = plan.throttleUpUntil - 5.f * unit(random);
+        plan.turnUntil = plan.turnFrom + 1.f + 5.f * unit(random);
+        plan.turnLeft = unit(random) < 0.5f;
+        plan.throttleDownFrom = plan.throttleUpUntil + 5.f + 35.f * unit(random);
+        start.heading[i] = 360.f * unit(random);
+        start.x[i] = (float)(i % 100) * 50.f;
+        start.z[i] = (float)(i / 100) * 50.f;
+    }
+
+    FlightBatch serial = start;
+    auto begin = clock::now();
+    for (size_t step = 0; step < steps; step++)
+        StepFlightBatch(serial, 0, count, step / rate, dt);
+    double serialTime = std::chrono::duration<double>(clock::now() - begin).count();
+
+    //aircraft don't interact: each job flies its slice for the whole run, no sync per step
+    FlightBatch parallel = start;
+    ThreadPool pool;
+    size_t slices = std::min(count, pool.size() * 4);
+    begin = clock::now();
+    {
+        std::vector<std::future<void>> jobs;
+        for (size_t slice = 0; slice < slices; slice++)
+        {
+            size_t first = count * slice / slices, last = count * (slice + 1) / slices;
+            jobs.push_back(pool.submit([&parallel, first, last, steps, rate, dt]() {
+                for (size_t step = 0; step < steps; step++)
+                    StepFlightBatch(parallel, first, last, step / rate, dt);
+            }));
+        }
+        for (std::future<void>& job : jobs)
+            job.get();
+    }
+    double parallelTime = std::chrono::duration<double>(clock::now() - begin).count();
+
+    bool same = true;
+    size_t airborne = 0, landed = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        same = same && serial.x[i] == parallel.x[i] && serial.y[i] == parallel.y[i] && serial.z[i] == parallel.z[i] &&
+            serial.heading[i] == parallel.heading[i] && serial.speed[i] == parallel.speed[i];
+        if (parallel.y[i] > 0.f)
+            airborne++;
+        else if (parallel.speed[i] < 0.5f)
+            landed++;
+    }
+    //and the batch flies like the one aircraft in the window
+    bool matchesModel = true;
+    for (size_t i = 0; i < std::min<size_t>(count, 8); i++)
+    {
+        FlightModel model(rate);
+        model.reset(start.get(i));
+        const FlightPlan& plan = start.plans[i];
+        for (size_t step = 0; step < steps; step++)
+            model.advance(model.getStep(), [&plan](double time) { return plan.controlsAt(time); });
+        FlightState batched = parallel.get(i);
+        matchesModel = matchesModel && model.getState().position == batched.position && model.getState().rotation == batched.rotation;
+    }
+
+    double aircraftSteps = (double)count * steps;
+    std::cout << std::fixed << std::setprecision(1) << count << " aircraft, " << seconds << " s at " << rate << " Hz: "
+        << airborne << " still flying, " << landed << " back on the ground\n";
+    std::cout << std::setprecision(2) << "1 thread:  " << serialTime * 1000.0 << " ms, " << aircraftSteps / serialTime / 1e6 << " M aircraft-steps/s\n";
+    std::cout << pool.size() << " threads: " << parallelTime * 1000.0 << " ms, " << aircraftSteps / parallelTime / 1e6 << " M aircraft-steps/s ("
+        << serialTime / parallelTime << "x)\n";
+    std::cout << "parallel " << (same ? "matches" : "DIFFERS FROM") << " serial, batch " << (matchesModel ? "matches" : "DIFFERS FROM")
+        << " FlightModel\n";
+}
+
+//Moller-Trumbore, distance along dir or -1 on a miss
+static float RayTriangle(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a, ac = c - a;
+    glm::vec3 p = glm::cross(dir, ac);
+    float det = glm::dot(ab, p);
+    if (std::abs(det) < 1e-12f)
+        return -1.f;
+    float inverse = 1.f / det;
+    glm::vec3 t = origin - a;
+    float u = glm::dot(t, p) * inverse;
+    if (u < 0.f || u > 1.f)
+        return -1.f;
+    glm::vec3 q = glm::cross(t, ab);
+    float v = glm::dot(dir, q) * inverse;
+    if (v < 0.f || u + v > 1.f)
+        return -1.f;
+    return glm::dot(ac, q) * inverse;
+}
+
+bool VerifyTerrainQuery()
+{
+    SelfCheck check;
+
+    //a generated relief placed with a turn, an offset and uneven scales
+    Heightmap relief = GenerateHeightmap(97, 7);
+    glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(500.f, -200.f, -300.f));
+    model = glm::rotate(model, glm::radians(35.f), glm::vec3(0.f, 1.f, 0.f));
+    model = glm::scale(model, glm::vec3(0.1f, 0.2f, 0.1f));
+    TerrainQuery query(relief, model);
+
+    //the same triangles Terrain draws, in world space, for the brute force
+    std::vector<glm::vec3> triangles;
+    auto world = [&model](const glm::vec3& local) { return glm::vec3(model * glm::vec4(local, 1.f)); };
+    for (int z = 0; z + 1 < relief.height; z++)
+    {
+        for (int x = 0; x + 1 < relief.width; x++)
+        {
+            glm::vec3 v00 = world(relief.position(x, z)), v10 = world(relief.position(x + 1, z));
+            glm::vec3 v01 = world(relief.position(x, z + 1)), v11 = world(relief.position(x + 1, z + 1));
+            triangles.insert(triangles.end(), { v00, v01, v11, v00, v11, v10 });
+        }
+    }
+
+    std::mt19937 random(19);
+    std::uniform_real_distribution<float> across(0.f, (relief.width - 1) * relief.spacingX);
+    int heightsWrong = 0, normalsWrong = 0, missed = 0;
+    const int points = 300;
+    for (int i = 0; i < points; i++)
+    {
+        glm::vec3 point = world(glm::vec3(across(random), 0.f, across(random)));
+        glm::vec3 from(point.x, 1e5f, point.z), down(0.f, -1.f, 0.f);
+        float nearest = 1e30f;
+        glm::vec3 hitNormal(0.f);
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            float distance = RayTriangle(from, down, triangles[t], triangles[t + 1], triangles[t + 2]);
+            if (distance >= 0.f && distance < nearest)
+            {
+                nearest = distance;
+                hitNormal = glm::normalize(glm::cross(triangles[t + 1] - triangles[t], triangles[t + 2] - triangles[t]));
+            }
+        }
+        GroundSample ground;
+        if (nearest == 1e30f || !query.sample(point.x, point.z, ground))
+        {
+            missed++;
+            continue;
+        }
+        if (std::abs(ground.height - (from.y - nearest)) > 0.02f)
+            heightsWrong++;
+        if (hitNormal.y < 0.f)
+            hitNormal = -hitNormal;
+        if (glm::dot(hitNormal, ground.normal) < 0.9999f)
+            normalsWrong++;
+    }
+    check("every point is on the map and hit by its ray", missed == 0);
+    check("heights match the ray casts", heightsWrong == 0);
+    check("normals match the triangles hit", normalsWrong == 0);
+
+    bool corners = true;
+    for (int z = 0; z < relief.height; z += 8)
+    {
+        for (int x = 0; x < relief.width; x += 8)
+        {
+            glm::vec3 sample = world(relief.position(x, z));
+            corners = corners && std::abs(query.heightAt(sample.x, sample.z) - sample.y) < 1e-3f;
+        }
+    }
+    check("grid points give their samples", corners);
+
+    glm::vec3 corner = world(relief.position(relief.width - 1, relief.height - 1));
+    glm::vec3 beyond = world(relief.position(relief.width - 1, relief.height - 1) + glm::vec3(100.f, 0.f, 100.f));
+    GroundSample outside;
+    bool onMap = query.sample(beyond.x, beyond.z, outside);
+    check("off the map is reported, at the border height", !onMap && std::abs(outside.height - corner.y) < 1e-3f);
+
+    AABB apron = { glm::vec3(-10.f, -1.f, -10.f), glm::vec3(10.f, 1.f, 10.f) };
+    TerrainQuery withApron(relief, glm::mat4(1.f));
+    withApron.addFlatArea(apron, 5.f);
+    GroundSample onApron = withApron.sample(3.f, -4.f);
+    check("flat areas cover the relief", onApron.height == 5.f && onApron.normal == glm::vec3(0.f, 1.f, 0.f) &&
+        withApron.heightAt(500.f, 500.f) != 5.f);
+    GroundSample plane;
+    check("no heightmap is the y = 0 plane", !TerrainQuery().sample(123.f, 456.f, plane) && plane.height == 0.f);
+
+    //flight over hand made grounds, 100 apart, heading 0 flies towards +z
+    auto flat = [](float level) {
+        Heightmap ground;
+        ground.width = ground.height = 64;
+        ground.spacingX = ground.spacingZ = 100.f;
+        ground.samples.assign(64 * 64, (int16_t)level);
+        return ground;
+    };
+    auto fly = [](const TerrainQuery& terrain, FlightState state, double seconds, const std::function<bool(const FlightState&)>& each) {
+        auto groundAt = [&terrain](float x, float z) { return terrain.sample(x, z); };
+        bool always = true;
+        for (int step = 0; step < (int)(seconds * 120.0); step++)
+        {
+            StepFlight(state, FlightControls(), 1.f / 120.f, groundAt);
+            always = always && each(state);
+        }
+        return std::make_pair(state, always);
+    };
+    FlightState start;
+    start.position = glm::vec3(3000.f, 0.f, 500.f);
+    start.rotation = glm::vec3(0.f);
+
+    //an 11 degree ramp up the z axis, taxied up without throttle
+    Heightmap ramp = flat(0.f);
+    for (int z = 0; z < 64; z++)
+        std::fill_n(ramp.samples.begin() + z * 64, 64, (int16_t)(z * 20));
+    TerrainQuery rampQuery(ramp);
+    FlightState taxi = start;
+    taxi.speed = 0.3f;
+    auto taxied = fly(rampQuery, taxi, 5.0, [&rampQuery](const FlightState& state) {
+        return !state.crashed && state.grounded && std::abs(state.position.y - rampQuery.heightAt(state.position.x, state.position.z)) < 1e-3f;
+    });
+    check("taxiing follows the ground uphill", taxied.second && taxied.first.position.y > 200.f);
+
+    //sinking onto a plateau 100 up
+    Heightmap plateau = flat(100.f);
+    TerrainQuery plateauQuery(plateau);
+    FlightState approach = start;
+    approach.position.y = 300.f;
+    approach.speed = 0.45f;
+    approach.grounded = false;
+    auto landed = fly(plateauQuery, approach, 5.0, [](const FlightState& state) { return state.position.y >= 100.f; });
+    check("lands on the plateau, never below it", landed.second && landed.first.grounded && !landed.first.crashed &&
+        landed.first.position.y == 100.f);
+
+    //gliding 200 up into a 2000 high cliff at z = 1000
+    Heightmap cliff = flat(0.f);
+    for (int z = 10; z < 64; z++)
+        std::fill_n(cliff.samples.begin() + z * 64, 64, (int16_t)2000);
+    TerrainQuery cliffQuery(cliff);
+    FlightState level = start;
+    level.position.y = 200.f;
+    level.speed = 0.5f;
+    level.grounded = false;
+    auto hit = fly(cliffQuery, level, 3.0, [](const FlightState&) { return true; });
+    auto after = fly(cliffQuery, hit.first, 1.0, [](const FlightState&) { return true; });
+    check("flying into a cliff crashes", hit.first.crashed && hit.first.position.z < 1100.f);
+    check("a crashed aircraft stays put", after.first.position == hit.first.position);
+
+    return check.finish();
+}
+
+void BenchmarkTerrainQuery(int size)
+{
+    using clock = std::chrono::high_resolution_clock;
+    auto begin = clock::now();
+    Heightmap relief = GenerateHeightmap(size, 11);
+    double generateTime = std::chrono::duration<double>(clock::now() - begin).count();
+    //placed like the Transilvania relief
+    glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(0.f, -200.f, -180.f));
+    model = glm::scale(model, glm::vec3(0.1f));
+    TerrainQuery query(relief, model);
+    float extent = (size - 1) * relief.spacingX * 0.1f;
+
+    //scattered points miss the cache, a flight path walks through neighbouring cells
+    const size_t count = 1 << 20;
+    std::vector<float> scatteredX(count), scatteredZ(count), pathX(count), pathZ(count);
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> across(0.f, extent);
+    for (size_t i = 0; i < count; i++)
+    {
+        scatteredX[i] = across(random);
+        scatteredZ[i] = -180.f + across(random);
+        float t = (float)i / count;
+        pathX[i] = extent * (0.1f + 0.8f * t);
+        pathZ[i] = -180.f + extent * (0.5f + 0.3f * std::sin(t * 20.f));
+    }
+
+    std::cout << size << " x " << size << " heightmap generated in " << std::fixed << std::setprecision(2) << generateTime << " s, "
+        << relief.samples.size() * sizeof(int16_t) / (1024 * 1024) << " MB\n";
+    const int passes = 10;
+    auto run = [&](const char* name, const std::vector<float>& xs, const std::vector<float>& zs) {
+        double sum = 0.0;
+        auto start = clock::now();
+        for (int pass = 0; pass < passes; pass++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                GroundSample ground = query.sample(xs[i], zs[i]);
+                sum += ground.height + ground.normal.y;
+            }
+        }
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        double queries = (double)count * passes;
+        std::cout << std::left << std::setw(12) << name << std::right << std::setw(8) << queries / seconds / 1e6 << " M queries/s, "
+            << seconds * 1e9 / queries << " ns each (checksum " << sum / queries << ")\n";
+    };
+    run("scattered", scatteredX, scatteredZ);
+    run("flight path", pathX, pathZ);
+}
+
+//closest hit of a ray over every triangle of a soup, three corners each
+static bool BruteForceRaycast(const std::vector<glm::vec3>& soup, const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+    float& distance, uint32_t& triangle)
+{
+    distance = maxDistance;
+    bool found = false;
+    for (size_t i = 0; i < soup.size(); i += 3)
+    {
+        float t = RayTriangle(origin, direction, soup[i], soup[i + 1], soup[i + 2]);
+        if (t >= 0.f && t < distance)
+        {
+            distance = t;
+            triangle = (uint32_t)(i / 3);
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool VerifyBvh()
+{
+    SelfCheck check;
+
+    //a patch of relief, scattered triangles of all sizes, a pile of identical ones and a few degenerate
+    std::vector<glm::vec3> soup;
+    std::vector<uint32_t> owners;
+    Heightmap relief = GenerateHeightmap(33, 3, 10.f, 50.f);
+    for (int z = 0; z + 1 < relief.height; z++)
+    {
+        for (int x = 0; x + 1 < relief.width; x++)
+        {
+            glm::vec3 v00 = relief.position(x, z) - glm::vec3(160.f, 0.f, 160.f), v10 = relief.position(x + 1, z) - glm::vec3(160.f, 0.f, 160.f);
+            glm::vec3 v01 = relief.position(x, z + 1) - glm::vec3(160.f, 0.f, 160.f), v11 = relief.position(x + 1, z + 1) - glm::vec3(160.f, 0.f, 160.f);
+            soup.insert(soup.end(), { v00, v01, v11, v00, v11, v10 });
+            owners.insert(owners.end(), { 0, 0 });
+        }
+    }
+    std::mt19937 random(20);
+    std::uniform_real_distribution<float> inside(-200.f, 200.f), size(-20.f, 20.f), unit(-1.f, 1.f);
+    for (int i = 0; i < 3000; i++)
+    {
+        glm::vec3 a(inside(random), inside(random), inside(random));
+        float scale = i % 10 == 0 ? 5.f : 1.f;
+        soup.insert(soup.end(), { a, a + glm::vec3(size(random), size(random), size(random)) * scale,
+            a + glm::vec3(size(random), size(random), size(random)) * scale });
+        owners.push_back(1);
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        soup.insert(soup.end(), { glm::vec3(50.f, 60.f, 70.f), glm::vec3(60.f, 60.f, 70.f), glm::vec3(50.f, 70.f, 75.f) });
+        owners.push_back(2);
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        glm::vec3 a(inside(random), inside(random), inside(random));
+        soup.insert(soup.end(), { a, a, a + glm::vec3(1.f, 0.f, 0.f) });
+        owners.push_back(3);
+    }
+
+    Bvh serial;
+    BvhSettings small;
+    small.parallelSize = 256;
+    Bvh parallel(small);
+    for (size_t i = 0; i < owners.size(); i++)
+    {
+        serial.addTriangle(soup[i * 3], soup[i * 3 + 1], soup[i * 3 + 2], owners[i]);
+        parallel.addTriangle(soup[i * 3], soup[i * 3 + 1], soup[i * 3 + 2], owners[i]);
+    }
+    serial.build();
+    ThreadPool pool;
+    parallel.build(&pool);
+    std::cout << "  " << serial.getTriangleCount() << " triangles, " << serial.getNodeCount() << " nodes, depth " << serial.getDepth() << '\n';
+    check("pool build makes the same tree", parallel.getNodeCount() == serial.getNodeCount() && parallel.getDepth() == serial.getDepth());
+
+    //random rays, and axis aligned ones whose zero components stress the slab test
+    std::vector<std::pair<glm::vec3, glm::vec3>> rays;
+    for (int i = 0; i < 1500; i++)
+    {
+        glm::vec3 direction(unit(random), unit(random), unit(random));
+        if (glm::length(direction) < 1e-3f)
+            continue;
+        rays.push_back({ glm::vec3(inside(random), inside(random), inside(random)) * 1.5f, glm::normalize(direction) });
+    }
+    glm::vec3 axes[6] = { glm::vec3(1.f, 0.f, 0.f), glm::vec3(-1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f),
+        glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 0.f, -1.f) };
+    for (int i = 0; i < 600; i++)
+        rays.push_back({ glm::vec3(inside(random), inside(random), inside(random)), axes[i % 6] });
+    int rayErrors = 0, ownerErrors = 0, parallelErrors = 0, hits = 0;
+    for (const auto& ray : rays)
+    {
+        float distance;
+        uint32_t triangle = 0;
+        bool expected = BruteForceRaycast(soup, ray.first, ray.second, 1e4f, distance, triangle);
+        BvhHit hit, other;
+        bool found = serial.raycast(ray.first, ray.second, 1e4f, hit);
+        bool foundParallel = parallel.raycast(ray.first, ray.second, 1e4f, other);
+        if (found != foundParallel || (found && (hit.distance != other.distance || hit.triangle != other.triangle)))
+            parallelErrors++;
+        if (found != expected)
+        {
+            rayErrors++;
+            continue;
+        }
+        if (!found)
+            continue;
+        hits++;
+        //ties on shared edges may pick either triangle, at the same distance
+        if (std::abs(hit.distance - distance) > 1e-4f * std::max(1.f, distance) || (hit.triangle != triangle && hit.distance != distance))
+            rayErrors++;
+        if (hit.owner != owners[hit.triangle] || glm::dot(hit.normal, ray.second) > 0.f)
+            ownerErrors++;
+    }
+    std::cout << "  " << hits << " of " << rays.size() << " rays hit\n";
+    check("ray hits match brute force", rayErrors == 0);
+    check("hits carry their owner, normals face the ray", ownerErrors == 0);
+    check("pool built tree gives the same hits", parallelErrors == 0);
+
+    int segmentErrors = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        glm::vec3 from(inside(random), inside(random), inside(random));
+        glm::vec3 to = from + glm::vec3(size(random), size(random), size(random)) * 5.f;
+        float distance;
+        uint32_t triangle;
+        float length = glm::length(to - from);
+        bool expected = BruteForceRaycast(soup, from, (to - from) / length, length, distance, triangle);
+        BvhHit hit;
+        if (serial.segment(from, to, hit) != expected)
+            segmentErrors++;
+    }
+    check("segments hit exactly when brute force does", segmentErrors == 0);
+
+    int boxErrors = 0;
+    size_t touched = 0;
+    for (int i = 0; i < 300; i++)
+    {
+        glm::vec3 centre(inside(random), inside(random), inside(random)), half(std::abs(size(random)) + 1.f, std::abs(size(random)) + 1.f, 10.f);
+        AABB box = { centre - half, centre + half };
+        std::vector<uint32_t> expected, found;
+        for (uint32_t t = 0; t < owners.size(); t++)
+        {
+            if (TriangleOverlapsBox(soup[t * 3], soup[t * 3 + 1], soup[t * 3 + 2], box))
+                expected.push_back(t);
+        }
+        serial.overlap(box, found);
+        std::sort(found.begin(), found.end());
+        touched += found.size();
+        if (found != expected)
+            boxErrors++;
+    }
+    std::cout << "  " << touched << " triangles touched by 300 boxes\n";
+    check("box queries match brute force", boxErrors == 0);
+
+    AABB unit3 = { glm::vec3(-1.f), glm::vec3(1.f) };
+    check("triangle through a box without a corner in it", TriangleOverlapsBox(glm::vec3(-5.f, 0.f, 0.f), glm::vec3(5.f, 0.f, 0.f), glm::vec3(0.f, 5.f, 0.f), unit3));
+    check("triangle past a box's edge", !TriangleOverlapsBox(glm::vec3(2.5f, 0.f, -5.f), glm::vec3(0.f, 2.5f, -5.f), glm::vec3(1.25f, 1.25f, 5.f), unit3));
+
+    Bvh empty;
+    empty.build();
+    BvhHit none;
+    std::vector<uint32_t> nothing;
+    check("an empty tree hits nothing", !empty.raycast(glm::vec3(0.f), glm::vec3(0.f, -1.f, 0.f), 1e4f, none) && empty.overlap(unit3, nothing) == 0);
+
+    return check.finish();
+}
+
+void BenchmarkBvh(int size)
+{
+    using clock = std::chrono::high_resolution_clock;
+    ThreadPool pool;
+    //best of a few builds, serial and on the pool
+    auto timeBuilds = [&pool](Bvh& bvh, double& serialTime, double& parallelTime) {
+        serialTime = parallelTime = 1e30;
+        for (int run = 0; run < 3; run++)
+        {
+            auto start = clock::now();
+            bvh.build();
+            serialTime = std::min(serialTime, std::chrono::duration<double>(clock::now() - start).count());
+            start = clock::now();
+            bvh.build(&pool);
+            parallelTime = std::min(parallelTime, std::chrono::duration<double>(clock::now() - start).count());
+        }
+    };
+    auto report = [&pool](const char* name, const Bvh& bvh, double serialTime, double parallelTime) {
+        std::cout << std::fixed << std::setprecision(2) << name << ": " << bvh.getTriangleCount() << " triangles, " << bvh.getNodeCount()
+            << " nodes, depth " << bvh.getDepth() << ", " << bvh.getMemoryBytes() / (1024 * 1024) << " MB\n";
+        std::cout << "  build 1 thread " << serialTime * 1000.0 << " ms, " << pool.size() << " threads " << parallelTime * 1000.0
+            << " ms (" << serialTime / parallelTime << "x)\n";
+    };
+
+    //the airport and the relief as the game places them; meshes need a context to live in
+    HiddenWindow window(64, 64, "BVH benchmark");
+    if (!window)
+        return;
+    {
+        Scene aeroport;
+        aeroport.load("Aeroport.scene");
+        AssetLoader loader;
+        aeroport.queue(loader);
+        loader.queueMesh("Transilvania.obj");
+        //placed by the scene itself, parents included
+        aeroport.init(loader);
+        Bvh scene;
+        AABB airport = { glm::vec3(1e30f), glm::vec3(-1e30f) };
+        for (size_t i = 0; i < aeroport.getMeshes().size(); i++)
+        {
+            Mesh& mesh = aeroport.getMeshes()[i];
+            scene.addMesh(mesh, (uint32_t)i);
+            AABB bounds = mesh.getWorldBounds();
+            airport.min = glm::min(airport.min, bounds.min);
+            airport.max = glm::max(airport.max, bounds.max);
+        }
+        Mesh relief(loader.takeMesh("Transilvania.obj"));
+        relief.setScale(glm::vec3(0.1f));
+        relief.setPosition(glm::vec3(0.f, -200.f, -180.f));
+        scene.addMesh(relief, (uint32_t)aeroport.getObjects().size());
+        double serialTime, parallelTime;
+        timeBuilds(scene, serialTime, parallelTime);
+        report("airport + relief", scene, serialTime, parallelTime);
+
+        //picks from around the airport, camera segments of 50, aircraft sized boxes
+        const int count = 200000;
+        std::mt19937 random(8);
+        std::uniform_real_distribution<float> unit(0.f, 1.f), side(-1.f, 1.f);
+        glm::vec3 extent = airport.max - airport.min;
+        std::vector<glm::vec3> origins(count), directions(count), centres(count);
+        for (int i = 0; i < count; i++)
+        {
+            origins[i] = airport.min + extent * glm::vec3(unit(random), 1.f, unit(random)) + glm::vec3(0.f, 20.f, 0.f);
+            directions[i] = glm::normalize(glm::vec3(side(random), -0.2f - unit(random), side(random)));
+            centres[i] = airport.min + extent * glm::vec3(unit(random), 0.f, unit(random)) + glm::vec3(0.f, 4.f, 0.f);
+        }
+        auto run = [count](const char* name, const std::function<bool(int)>& query) {
+            int hits = 0;
+            auto start = clock::now();
+            for (int i = 0; i < count; i++)
+                hits += query(i) ? 1 : 0;
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+            std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(8) << count / seconds / 1e6 << " M/s, "
+                << seconds * 1e9 / count << " ns each, " << 100.0 * hits / count << "% hit\n";
+        };
+        BvhHit hit;
+        std::vector<uint32_t> found;
+        run("rays", [&](int i) { return scene.raycast(origins[i], directions[i], 1e6f, hit); });
+        run("segments", [&](int i) { return scene.segment(origins[i], origins[i] + directions[i] * 50.f, hit); });
+        run("boxes", [&](int i) {
+            found.clear();
+            return scene.overlap({ centres[i] - glm::vec3(10.f, 4.f, 10.f), centres[i] + glm::vec3(10.f, 4.f, 10.f) }, found) > 0;
+        });
+    }
+
+    //size x size relief, two triangles a cell, for how the build scales
+    Heightmap heightmap = GenerateHeightmap(size, 4);
+    Bvh large;
+    for (int z = 0; z + 1 < heightmap.height; z++)
+    {
+        for (int x = 0; x + 1 < heightmap.width; x++)
+        {
+            glm::vec3 v00 = heightmap.position(x, z), v10 = heightmap.position(x + 1, z);
+            glm::vec3 v01 = heightmap.position(x, z + 1), v11 = heightmap.position(x + 1, z + 1);
+            large.addTriangle(v00, v01, v11, 0);
+            large.addTriangle(v00, v11, v10, 0);
+        }
+    }
+    double serialTime, parallelTime;
+    timeBuilds(large, serialTime, parallelTime);
+    report("generated relief", large, serialTime, parallelTime);
+}
+
+//the model matrix as Mesh built it before the transform graph
+static glm::mat4 GlmTransform(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.f), position);
+    model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1.f, 0.f, 0.f));
+    model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0.f, 0.f, 1.f));
+    model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0.f, 1.f, 0.f));
+    return glm::scale(model, scale);
+}
+
+static float MatrixDifference(const glm::mat4& a, const glm::mat4& b)
+{
+    float difference = 0.f;
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+            difference = std::max(difference, std::abs(a[column][row] - b[column][row]));
+    }
+    return difference;
+}
+
+bool VerifyTransforms()
+{
+    SelfCheck check;
+
+    std::mt19937 random(23);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    auto randomVec = [&](float range) { return glm::vec3(unit(random), unit(random), unit(random)) * range; };
+
+    float composeError = 0.f;
+    for (int i = 0; i < 1000; i++)
+    {
+        glm::vec3 position = randomVec(500.f), rotation = randomVec(360.f), scale = glm::abs(randomVec(10.f)) + glm::vec3(0.1f);
+        composeError = std::max(composeError, MatrixDifference(ComposeTransform(position, rotation, scale), GlmTransform(position, rotation, scale)) /
+            std::max(1.f, glm::length(position)));
+    }
+    check("compose matches translate, rotate x z y, scale", composeError < 1e-5f);
+
+    //random forest, then worlds checked against walking each chain from the root
+    TransformGraph graph;
+    const int nodes = 1000;
+    std::vector<TransformHandle> handles;
+    for (int i = 0; i < nodes; i++)
+    {
+        TransformHandle parent = i > 0 && unit(random) > -0.6f ? handles[(size_t)(std::abs(unit(random)) * (i - 1))] : NO_TRANSFORM;
+        handles.push_back(graph.create(parent));
+        graph.setPosition(handles.back(), randomVec(20.f));
+        graph.setRotation(handles.back(), randomVec(180.f));
+        graph.setScale(handles.back(), glm::abs(randomVec(1.f)) + glm::vec3(0.5f));
+    }
+    //a few moved under later nodes, so parents don't always come first
+    for (int i = 0; i < 50; i++)
+        graph.setParent(handles[(size_t)(std::abs(unit(random)) * (nodes - 1))], handles[(size_t)(std::abs(unit(random)) * (nodes - 1))]);
+    auto reference = [&graph](TransformHandle node) {
+        glm::mat4 world(1.f);
+        for (TransformHandle above = node; above != NO_TRANSFORM; above = graph.getParent(above))
+            world = ComposeTransform(graph.getPosition(above), graph.getRotation(above), graph.getScale(above)) * world;
+        return world;
+    };
+    auto worldError = [&]() {
+        float error = 0.f;
+        for (TransformHandle node : handles)
+            error = std::max(error, MatrixDifference(graph.getWorld(node), reference(node)) / std::max(1.f, glm::length(glm::vec3(reference(node)[3]))));
+        return error;
+    };
+    //lazily through getWorld on a fresh copy of the flags, then through update
+    TransformGraph lazy = graph;
+    float lazyError = 0.f;
+    for (TransformHandle node : handles)
+        lazyError = std::max(lazyError, MatrixDifference(lazy.getWorld(node), reference(node)) / std::max(1.f, glm::length(glm::vec3(reference(node)[3]))));
+    check("getWorld on demand matches the chain product", lazyError < 1e-4f);
+    check("each world rebuilt once on demand", lazy.getRecomputeCount() == (size_t)nodes);
+    check("update rebuilds every new node", graph.update() == (size_t)nodes);
+    check("update matches the chain product", worldError() < 1e-4f);
+    check("a clean graph rebuilds nothing", graph.update() == 0);
+    graph.setPosition(handles[5], graph.getPosition(handles[5]));
+    graph.setRotation(handles[5], graph.getRotation(handles[5]));
+    check("setting the same values flags nothing", graph.update() == 0);
+
+    //moving a node rebuilds exactly its subtree
+    TransformGraph tree;
+    TransformHandle root = tree.create();
+    TransformHandle left = tree.create(root), right = tree.create(root);
+    TransformHandle leaf = tree.create(left);
+    tree.create(right);
+    tree.update();
+    tree.setPosition(left, glm::vec3(1.f, 2.f, 3.f));
+    tree.setRotation(left, glm::vec3(0.f, 90.f, 0.f));
+    check("moving a node rebuilds only its subtree", tree.update() == 2);
+    tree.setPosition(root, glm::vec3(5.f, 0.f, 0.f));
+    check("moving the root rebuilds everything", tree.update() == 5);
+    check("a child follows its parent", MatrixDifference(tree.getWorld(leaf), tree.getWorld(left) * tree.getLocal(leaf)) < 1e-5f);
+    check("a node can't go below its own subtree", !tree.setParent(left, leaf) && !tree.setParent(root, root) && tree.getParent(left) == root);
+    check("reparenting moves the subtree along", tree.setParent(leaf, right) && tree.update() == 1 &&
+        MatrixDifference(tree.getWorld(leaf), tree.getWorld(right)) < 1e-5f);
+    glm::mat4 explicitLocal = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 10.f, 0.f));
+    tree.setLocal(right, explicitLocal);
+    check("setLocal replaces position, rotation and scale", MatrixDifference(tree.getWorld(right), tree.getWorld(root) * explicitLocal) < 1e-5f);
+    tree.setPosition(right, glm::vec3(0.f));
+    check("and lasts until the next setter", MatrixDifference(tree.getWorld(right), tree.getWorld(root)) < 1e-5f);
+    tree.release(right);
+    check("a released node's children become roots", tree.getParent(leaf) == NO_TRANSFORM &&
+        MatrixDifference(tree.getWorld(leaf), tree.getLocal(leaf)) < 1e-5f);
+    check("released slots are reused", tree.create() == right && tree.getNodeCount() == 5);
+
+    //the Mesh side: same matrices as before, nothing rebuilt by drawing
+    OBJIndexedMesh triangle;
+    triangle.vertices.resize(3);
+    triangle.vertices[0].position = glm::vec3(0.f);
+    triangle.vertices[1].position = glm::vec3(1.f, 0.f, 0.f);
+    triangle.vertices[2].position = glm::vec3(0.f, 1.f, 0.f);
+    Mesh body(triangle), part(triangle);
+    body.setPosition(glm::vec3(100.f, 20.f, -40.f));
+    body.setRotation(glm::vec3(10.f, 180.f, -15.f));
+    part.setParent(&body);
+    part.setPosition(glm::vec3(0.f, 1.f, 2.f));
+    part.setScale(glm::vec3(1.f));
+    glm::mat4 bodyModel = GlmTransform(glm::vec3(100.f, 20.f, -40.f), glm::vec3(10.f, 180.f, -15.f), glm::vec3(5.f));
+    check("a mesh's model is what it was", MatrixDifference(body.getModel(), bodyModel) < 1e-4f);
+    check("a part moves with the body", MatrixDifference(part.getModel(), bodyModel * glm::translate(glm::mat4(1.f), glm::vec3(0.f, 1.f, 2.f))) < 1e-4f);
+    size_t before = sceneTransforms.getRecomputeCount();
+    for (int frame = 0; frame < 10; frame++)
+    {
+        body.getModel();
+        part.getWorldBounds();
+    }
+    check("reading a still mesh rebuilds nothing", sceneTransforms.getRecomputeCount() == before);
+    Mesh moved(std::move(part));
+    body.setPosition(glm::vec3(0.f));
+    check("a moved mesh keeps its node", MatrixDifference(moved.getModel(), body.getModel() * glm::translate(glm::mat4(1.f), glm::vec3(0.f, 1.f, 2.f))) < 1e-4f);
+
+    return check.finish();
+}
+
+void BenchmarkTransforms(size_t count)
+{
+    using clock = std::chrono::high_resolution_clock;
+    //groups of eight like an aircraft: body, three parts, four sub-parts hanging off the first two
+    TransformGraph graph;
+    std::vector<TransformHandle> bodies;
+    std::vector<glm::vec3> positions, rotations, scales;
+    std::vector<int> parents;
+    for (size_t i = 0; i + 8 <= count; i += 8)
+    {
+        TransformHandle body = graph.create();
+        TransformHandle parts[3] = { graph.create(body), graph.create(body), graph.create(body) };
+        for (int sub = 0; sub < 4; sub++)
+            graph.setPosition(graph.create(parts[sub / 2]), glm::vec3(0.f, 0.f, 1.f + sub));
+        for (int part = 0; part < 3; part++)
+            graph.setPosition(parts[part], glm::vec3(part - 1.f, 0.f, 0.f));
+        bodies.push_back(body);
+        int base = (int)positions.size();
+        parents.insert(parents.end(), { -1, base, base, base, base + 1, base + 1, base + 2, base + 2 });
+    }
+    size_t nodes = graph.getNodeCount();
+    positions.assign(nodes, glm::vec3(0.f));
+    rotations.assign(nodes, glm::vec3(0.f));
+    scales.assign(nodes, glm::vec3(1.f));
+    graph.update();
+
+    const int frames = 200;
+    std::cout << nodes << " transforms in " << bodies.size() << " hierarchies of 8, " << frames << " frames\n";
+    std::cout << std::fixed << std::setprecision(2);
+    //every nth body moves each frame (none for 0), its parts follow
+    auto run = [&](const char* name, size_t every) {
+        size_t rebuilt = 0;
+        auto start = clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (size_t i = frame % std::max<size_t>(every, 1); every != 0 && i < bodies.size(); i += every)
+            {
+                graph.setPosition(bodies[i], glm::vec3((float)frame, 0.f, (float)i));
+                graph.setRotation(bodies[i], glm::vec3(0.f, (float)frame, 0.f));
+            }
+            rebuilt += graph.update();
+        }
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        std::cout << std::left << std::setw(28) << name << std::right << std::setw(9) << seconds * 1000.0 / frames << " ms/frame, "
+            << std::setw(8) << rebuilt / (double)frames << " rebuilt/frame, " << std::setw(8) << nodes * (double)frames / seconds / 1e6
+            << " M transforms/s\n";
+    };
+    run("graph, everything moves", 1);
+    run("graph, 1 in 10 moves", 10);
+    run("graph, nothing moves", 0);
+
+    //the old Mesh: two setters rebuild the local each, drawing rebuilds it again and the
+    //parent products are redone for every node every frame
+    std::vector<glm::mat4> locals(nodes), worlds(nodes);
+    float checksum = 0.f;
+    auto start = clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (size_t i = 0; i < nodes; i++)
+        {
+            if (parents[i] < 0)
+            {
+                positions[i] = glm::vec3((float)frame, 0.f, (float)i);
+                locals[i] = GlmTransform(positions[i], rotations[i], scales[i]);
+                rotations[i] = glm::vec3(0.f, (float)frame, 0.f);
+                locals[i] = GlmTransform(positions[i], rotations[i], scales[i]);
+            }
+            locals[i] = GlmTransform(positions[i], rotations[i], scales[i]);
+            worlds[i] = parents[i] < 0 ? locals[i] : worlds[parents[i]] * locals[i];
+        }
+        checksum += worlds[nodes - 1][3][0];
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << std::left << std::setw(28) << "rebuilt on every set/draw" << std::right << std::setw(9) << seconds * 1000.0 / frames
+        << " ms/frame, " << std::setw(8) << (double)nodes << " rebuilt/frame, " << std::setw(8) << nodes * (double)frames / seconds / 1e6
+        << " M transforms/s (checksum " << checksum << ")\n";
+}
+
+bool VerifyResources()
+{
+    SelfCheck check;
+
+    //uploads and texture deletes need a context
+    HiddenWindow window(64, 64, "Resource test");
+    if (!window)
+        return false;
+    {
+        ResourceManager manager;
+        std::shared_ptr<MeshGeometry> plane = manager.acquireMesh("Plane.obj");
+        std::shared_ptr<MeshGeometry> again = manager.acquireMesh("Plane.obj");
+        check("the same path is loaded once", plane == again && manager.getLoads() == 1 && manager.getPathHits() == 1);
+        //same vertices and materials behind a different file and .mtl name
+        std::shared_ptr<MeshGeometry> avion = manager.acquireMesh("Avion.obj");
+        check("the same contents are shared", avion == plane && manager.getLoads() == 2 && manager.getContentHits() == 1);
+        check("and the second path answers by path", manager.acquireMesh("Avion.obj") == plane && manager.getLoads() == 2);
+        std::shared_ptr<MeshGeometry> full = manager.acquireMesh("Plane.obj", nullptr, VertexLayout::Full);
+        check("another layout is another resource", full != plane && full->layout == VertexLayout::Full);
+
+        //instances: one upload, their own VAO, materials and transform
+        Mesh first(plane), second(avion);
+        first.setColor(0, glm::vec3(1.f, 0.f, 0.f));
+        first.setPosition(glm::vec3(10.f, 0.f, 0.f));
+        first.initVAO();
+        second.initVAO();
+        check("instances share the buffers", first.getVBO() == second.getVBO() && first.getEBO() == second.getEBO() && first.getVBO() != 0);
+        check("but not the VAO", first.getVAO() != second.getVAO());
+        check("nor the colours", first.getMaterialTable()[0].color != second.getMaterialTable()[0].color);
+        check("nor the transform", first.getModel() != second.getModel());
+        size_t cpu, gpu;
+        SumMeshMemory({ { "Plane.obj", &first }, { "Avion.obj", &second } }, cpu, gpu);
+        check("memory counts shared geometry once", gpu == plane->getGPUBytes() + first.getGPUBytes() + second.getGPUBytes() &&
+            cpu == plane->getResidentBytes() + first.getResidentBytes() + second.getResidentBytes());
+
+        //entries are weak: the last handle frees the resource, the next acquire loads it again
+        std::weak_ptr<MeshGeometry> watched = full;
+        full.reset();
+        check("the last handle frees the geometry", watched.expired());
+        size_t loads = manager.getLoads();
+        full = manager.acquireMesh("Plane.obj", nullptr, VertexLayout::Full);
+        check("and acquiring it again reloads it", full != nullptr && manager.getLoads() == loads + 1);
+
+        std::shared_ptr<Texture> texture = manager.acquireTexture("10459_White_Ash_Tree_v1_Diffuse.jpg");
+        loads = manager.getLoads();
+        std::shared_ptr<Texture> same = manager.acquireTexture("10459_White_Ash_Tree_v1_Diffuse.jpg");
+        check("a texture is uploaded once", texture == same && texture->get() != 0 && manager.getLoads() == loads);
+        std::weak_ptr<Texture> watchedTexture = texture;
+        texture.reset();
+        same.reset();
+        check("and deleted with its last handle", watchedTexture.expired());
+        manager.report();
+
+        //the path constructor goes through the shared manager
+        Mesh byPath("Plane.obj"), byPathAgain("Plane.obj");
+        check("Mesh(path) shares the geometry", &byPath.getGeometry() == &byPathAgain.getGeometry());
+    }
+
+    return check.finish();
+}
+
+bool VerifyMaterials()
+{
+    SelfCheck check;
+
+    //an .mtl in a sub folder naming its maps the ways exporters do, images copied from the game's
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "LamMG6_mtl_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "sub");
+    std::filesystem::create_directories(directory / "tex");
+    std::filesystem::copy_file("Resources/Road.jpg", directory / "tex" / "road.jpg");
+    std::filesystem::copy_file("Resources/Grass.jpg", directory / "sub" / "grass.jpg");
+    std::filesystem::copy_file("Resources/tower2.jpg", directory / "sub" / "bump.jpg");
+    std::string mtlFile = (directory / "sub" / "two.mtl").string();
+    {
+        std::ofstream mtl(mtlFile);
+        mtl << "# two materials\nnewmtl Road\n\tNs 96.5\nKa 0.1 0.1 0.1\nKd 0.8 0.7 0.6\nKs 0.5 0.5 0.5\nd 0.75\nillum 3\n"
+            << "map_Kd ..\\\\tex\\\\road.jpg\nmap_Ks C:\\\\Users\\\\someone\\\\Desktop\\\\LamMG6\\\\sub\\\\grass.jpg\nmap_Bump -bm 0.5 bump.jpg\n\n"
+            << "newmtl Missing\nKd 1 0 0\nmap_Kd nowhere.jpg\n";
+    }
+    std::vector<Material> materials = loadMTL(mtlFile.c_str());
+    check("two materials", materials.size() == 2);
+    if (materials.size() == 2)
+    {
+        const Material& road = materials[0];
+        check("Ns, d and illum", road.shininess == 96.5f && road.opacity == 0.75f && road.illum == 3);
+        check("map_Kd relative to the .mtl, Windows separators",
+            std::filesystem::equivalent(road.diffuseMap, directory / "tex" / "road.jpg"));
+        check("map_Ks from an absolute path elsewhere", std::filesystem::equivalent(road.specularMap, directory / "sub" / "grass.jpg"));
+        check("map_Bump after its options", std::filesystem::equivalent(road.bumpMap, directory / "sub" / "bump.jpg"));
+        check("a missing map stays empty", materials[1].diffuseMap.empty() && materials[1].diffuse == glm::vec3(1.f, 0.f, 0.f));
+    }
+    check("the airport's maps resolve", loadMTL("AA/Road.mtl")[0].diffuseMap == "Resources/Road.jpg" &&
+        loadMTL("AA/Fundatie.mtl")[0].diffuseMap == "Resources/Road.jpg");
+
+    //four triangles, the first before any usemtl, Road used twice
+    std::string OBJfile = (directory / "two.obj").string();
+    {
+        std::ofstream obj(OBJfile);
+        obj << "mtllib " << mtlFile << "\nv 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\nvt 0 0\nvn 0 0 1\n"
+            << "f 1/1/1 2/1/1 3/1/1\nusemtl Road\nf 2/1/1 4/1/1 3/1/1\nusemtl Missing\nf 1/1/1 3/1/1 4/1/1\n"
+            << "usemtl Road\nf 1/1/1 2/1/1 4/1/1\n";
+    }
+    OBJIndexedMesh indexed = loadOBJIndexed(OBJfile.c_str());
+    std::pair<std::vector<Vertex>, std::vector<Material>> legacy = loadOBJ(OBJfile.c_str());
+    const std::vector<MaterialRange>& ranges = indexed.ranges;
+    bool covered = !ranges.empty() && ranges.front().firstIndex == 0;
+    for (size_t i = 0; i + 1 < ranges.size(); i++)
+        covered = covered && ranges[i].firstIndex + ranges[i].count == ranges[i + 1].firstIndex && ranges[i].material < ranges[i + 1].material;
+    covered = covered && ranges.back().firstIndex + ranges.back().count == indexed.indices.size();
+    check("one range per material, covering the indices", ranges.size() == 3 && covered);
+    check("both Road uses in one range", ranges.size() == 3 && ranges[1].material == 0 && ranges[1].count == 6);
+    check("usemtl by name, not by order", ranges.size() == 3 && ranges[2].material == 1 && ranges[2].count == 3);
+    check("as many corners as the expanding loader", expandIndexed(indexed).size() == legacy.first.size());
+    bool uniform = true;
+    for (const MaterialRange& range : ranges)
+    {
+        for (GLuint i = range.firstIndex; i < range.firstIndex + range.count; i++)
+            uniform = uniform && indexed.vertices[indexed.indices[i]].colorID == range.material;
+    }
+    check("each range holds only its material", uniform);
+
+    //the cache keeps the ranges and the map paths
+    LoadMeshData(OBJfile);
+    OBJIndexedMesh cached;
+    check("ranges and maps through the mesh cache", LoadMeshCache(OBJfile, cached) && cached.ranges.size() == ranges.size() &&
+        cached.materials.size() == 2 && cached.materials[0].bumpMap == indexed.materials[0].bumpMap &&
+        cached.materials[0].shininess == 96.5f && cached.indices == indexed.indices);
+    //a touched .obj still hits and the header takes its new time; an edited .mtl misses
+    std::string before, after;
+    readOBJBytes(MeshCachePath(OBJfile).c_str(), before);
+    std::filesystem::last_write_time(OBJfile, std::filesystem::last_write_time(OBJfile) + std::chrono::hours(1));
+    bool touchedHit = LoadMeshCache(OBJfile, cached);
+    readOBJBytes(MeshCachePath(OBJfile).c_str(), after);
+    check("a touched .obj hits, the header is rewritten", touchedHit && before.size() == after.size() && before != after);
+    {
+        std::ofstream mtl(mtlFile, std::ios::app);
+        mtl << "# edited\n";
+    }
+    std::filesystem::last_write_time(mtlFile, std::filesystem::last_write_time(mtlFile) + std::chrono::hours(1));
+    check("an edited .mtl misses the cache", !LoadMeshCache(OBJfile, cached));
+    LoadMeshData(OBJfile);
+
+    //maps load once through the resource manager and bind per range
+    HiddenWindow window(64, 64, "Material test");
+    if (!window)
+        return false;
+    {
+        ResourceManager manager;
+        std::shared_ptr<MeshGeometry> road = manager.acquireMesh("AA/Road.obj");
+        std::shared_ptr<MeshGeometry> foundation = manager.acquireMesh("AA/Fundatie.obj");
+        manager.acquireMaterialMaps(*road);
+        manager.acquireMaterialMaps(*foundation);
+        check("one map texture for two meshes", !road->maps.empty() && !foundation->maps.empty() && road->maps[0].diffuse &&
+            road->maps[0].diffuse == foundation->maps[0].diffuse);
+
+        std::shared_ptr<MeshGeometry> two = manager.acquireMesh(OBJfile);
+        size_t loads = manager.getLoads();
+        manager.acquireMaterialMaps(*two);
+        check("only the sampled map_Kd is loaded", two->maps.size() == 2 && two->maps[0].diffuse && !two->maps[1].diffuse &&
+            manager.getLoads() - loads == 1);
+        Mesh mesh(two);
+        mesh.initVAO();
+        Shader shader;
+        shader.Set("Basic.shader");
+        unsigned int draws = glStats.draws;
+        mesh.render(&shader);
+        check("a draw per range", glStats.draws - draws == 3);
+        check("the range's own map before the mesh's texture", mesh.getTexture(1) == two->maps[0].diffuse->get() && mesh.getTexture(2) == 0);
+    }
+    std::filesystem::remove_all(directory);
+
+    return check.finish();
+}
+
+bool VerifyOBJFaces()
+{
+    SelfCheck check;
+
+    //a triangle, a quad and a pentagon over five corners
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "LamMG6_obj_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::string OBJfile = (directory / "faces.obj").string();
+    {
+        std::ofstream obj(OBJfile);
+        obj << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv -1 0.5 0\nvt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 0 1\n"
+            << "f 1/1/1 2/2/1 3/3/1\nf 1/1/1 2/2/1 3/3/1 4/4/1\nf 1/1/1 2/2/1 3/3/1 4/4/1 5/1/1\n";
+    }
+    std::pair<std::vector<Vertex>, std::vector<Material>> legacy = loadOBJ(OBJfile.c_str());
+    std::pair<std::vector<Vertex>, std::vector<Material>> fast = loadOBJFast(OBJfile.c_str());
+    OBJIndexedMesh indexed = loadOBJIndexed(OBJfile.c_str());
+    check("1 + 2 + 3 triangles from loadOBJ", legacy.first.size() == 18);
+    check("loadOBJFast gives the same corners", sameVertices(legacy.first, fast.first, false));
+    //the quad is corners 3..8: (1, 2, 3) then (1, 3, 4)
+    bool fan = fast.first.size() == 18;
+    const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+    const glm::vec3 corners[4] = { glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(1.f, 1.f, 0.f), glm::vec3(0.f, 1.f, 0.f) };
+    for (int i = 0; fan && i < 6; i++)
+        fan = fast.first[3 + i].position == corners[quad[i]];
+    check("a quad fans around its first corner", fan);
+    check("indexed: whole triangles, same corners", indexed.indices.size() == 18 && indexed.vertices.size() == 5 &&
+        sameVertices(expandIndexed(indexed), fast.first));
+
+    LoadMeshData(OBJfile);
+    OBJIndexedMesh cached;
+    check("the fanned indices through the mesh cache", LoadMeshCache(OBJfile, cached) && cached.indices == indexed.indices);
+    std::filesystem::remove_all(directory);
+
+    //every face of the tree is a quad
+    OBJIndexedMesh tree = loadOBJIndexed("10459_White_Ash_Tree_v1_L3.obj");
+    check("the tree's 5120 quads are 10240 triangles", tree.indices.size() == 10240 * 3 && !tree.ranges.empty() &&
+        tree.ranges.back().firstIndex + tree.ranges.back().count == tree.indices.size());
+
+    return check.finish();
+}
+
+//Mesh as the old AeroportInit kept it: a user-declared destructor and copy, so no move,
+//and every push_back and vector regrowth duplicated the vertices, indices and materials
+struct ByValueMesh
+{
+    OBJIndexedMesh data;
+
+    explicit ByValueMesh(OBJIndexedMesh data) : data(std::move(data)) {}
+    ByValueMesh(const ByValueMesh&) = default;
+    ByValueMesh& operator=(const ByValueMesh&) = default;
+    ~ByValueMesh() {}
+};
+
+void BenchmarkMeshCopies(bool byValue)
+{
+    Scene aeroport;
+    if (!aeroport.load("Aeroport.scene"))
+        return;
+    const std::vector<SceneObject>& objects = aeroport.getObjects();
+    //warm the .mgmesh caches so both ways read the same inputs
+    for (const SceneObject& object : objects)
+        LoadMeshData(object.mesh);
+
+    size_t dataBytes = 0;
+    size_t copiedBefore = meshBytesCopied;
+    size_t peakBefore = PeakResidentBytes(), peakAfter = 0;
+    if (byValue)
+    {
+        //a local per object alive to the end of the function, plus its copy in an unreserved vector
+        std::list<ByValueMesh> locals;
+        std::vector<ByValueMesh> meshes;
+        for (const SceneObject& object : objects)
+        {
+            locals.emplace_back(LoadMeshData(object.mesh));
+            meshes.push_back(locals.back());
+            dataBytes += locals.back().data.bytes();
+        }
+        peakAfter = PeakResidentBytes();
+    }
+    else
+    {
+        //Scene::init: the loader's data moved, the vector reserved
+        std::vector<OBJIndexedMesh> meshes;
+        meshes.reserve(objects.size());
+        for (const SceneObject& object : objects)
+        {
+            meshes.push_back(LoadMeshData(object.mesh));
+            dataBytes += meshes.back().bytes();
+        }
+        peakAfter = PeakResidentBytes();
+    }
+
+    std::ostringstream out;
+    out << (byValue ? "by value (old AeroportInit)" : "moved (Scene::init)") << ": " << objects.size() << " objects, "
+        << dataBytes / 1024 << " KB of mesh data, " << (meshBytesCopied - copiedBefore) / 1024 << " KB copied, peak RSS "
+        << peakBefore / 1024 << " KB before, " << peakAfter / 1024 << " KB after (+" << (peakAfter - peakBefore) / 1024 << " KB)\n";
+    std::cout << out.str();
+}
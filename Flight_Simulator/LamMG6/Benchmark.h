@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+
+	void BenchmarkOBJLoaders(const std::string& directory);
+	void BenchmarkMeshCache(const std::string& directory);
+	void ReportVertexMemory(const std::string& directory);
+	void BenchmarkMaterials(const std::string& OBJfile);
+	//serial vs AssetLoader load of the same files, true when the counts agree
+	bool VerifyParallelLoading(const std::vector<std::string>& files);
+	//known cases for the frustum and bounds math, SSE paths against the scalar ones
+	bool VerifyFrustumCulling();
+	//generated size x size relief flown over in a hidden window: LOD selection, chunk builds and GPU time
+	void BenchmarkTerrain(int size);
+	//synthetic .hgt tiles read back through the mapping, then paged by TerrainStreamer under a small budget
+	bool VerifyHgtStreaming();
+	//6x6 synthetic tiles of size samples flown across: page-in times, evictions, frames waiting for a tile
+	void BenchmarkHgtStreaming(int size);
+	//a scripted flight replayed at several frame rates must give the same steps, bit for bit
+	bool VerifyFlightReplay();
+	//count scripted aircraft flown for seconds at 120 Hz, one thread and then the pool; aircraft-steps per second
+	void SimulateFlightBatch(size_t count, double seconds);
+	//heights and normals against ray casts through every triangle, flat areas, and flights that taxi, land and crash
+	bool VerifyTerrainQuery();
+	//height queries per second on a generated size x size heightmap, scattered and along a path
+	void BenchmarkTerrainQuery(int size);
+	//rays, segments and boxes through the BVH against brute force over the same triangles
+	bool VerifyBvh();
+	//BVH builds and queries over the airport and relief in a hidden window, then builds over a size x size relief
+	void BenchmarkBvh(int size);
+	//the transform graph against the chain products, subtree-only rebuilds, and Mesh models as before
+	bool VerifyTransforms();
+	//count nodes in hierarchies of 8 with all, a tenth or none of them moving, and the old rebuild-every-call way
+	void BenchmarkTransforms(size_t count);
+	//shared meshes and textures by path and by content, instances of one geometry, and entries freed with their last handle
+	bool VerifyResources();
+	//.mtl properties and map paths, per material draw ranges through the loader and cache, maps shared and bound per range
+	bool VerifyMaterials();
+	//triangles, quads and pentagons fanned the same way by every OBJ loader and kept by the cache
+	bool VerifyOBJFaces();
+	//the airport's mesh data kept by value as the old AeroportInit did, or moved as Scene::init does;
+	//copies and peak RSS, one way per process since the peak only grows
+	void BenchmarkMeshCopies(bool byValue);
@@ -0,0 +1,447 @@
+#include "Bvh.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+//per added triangle, and the permutation the splits sort into leaf order
+struct Bvh::BuildData
+{
+    std::vector<AABB> boxes;
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t> order;
+};
+
+static AABB EmptyBox()
+{
+    AABB box;
+    box.min = glm::vec3(FLT_MAX);
+    box.max = glm::vec3(-FLT_MAX);
+    return box;
+}
+
+static void Grow(AABB& box, const AABB& other)
+{
+    box.min = glm::min(box.min, other.min);
+    box.max = glm::max(box.max, other.max);
+}
+
+//half the surface area, all the heuristic needs
+static float HalfArea(const AABB& box)
+{
+    glm::vec3 size = box.max - box.min;
+    if (size.x < 0.f)
+        return 0.f;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+//where the ray enters the box, if it does before maxDistance; a zero direction
+//component gives NaN on the slab's face, which the comparisons skip
+static bool EnterBox(const AABB& box, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance, float& entry)
+{
+    float near = 0.f, far = maxDistance;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float t0 = (box.min[axis] - origin[axis]) * inverse[axis];
+        float t1 = (box.max[axis] - origin[axis]) * inverse[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        near = t0 > near ? t0 : near;
+        far = t1 < far ? t1 : far;
+    }
+    entry = near;
+    return near <= far;
+}
+
+static bool BoxesOverlap(const AABB& a, const AABB& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y &&
+        a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+bool TriangleOverlapsBox(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const AABB& box)
+{
+    //around the box centre, the box is then just its half size
+    glm::vec3 centre = (box.min + box.max) * 0.5f, half = (box.max - box.min) * 0.5f;
+    glm::vec3 v0 = a - centre, v1 = b - centre, v2 = c - centre;
+    auto separated = [&](const glm::vec3& axis) {
+        float p0 = glm::dot(v0, axis), p1 = glm::dot(v1, axis), p2 = glm::dot(v2, axis);
+        float radius = half.x * std::abs(axis.x) + half.y * std::abs(axis.y) + half.z * std::abs(axis.z);
+        return std::max(p0, std::max(p1, p2)) < -radius || std::min(p0, std::min(p1, p2)) > radius;
+    };
+    //the box's faces, the triangle's plane, then each edge crossed with each box axis
+    glm::vec3 edges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+    glm::vec3 axes[3] = { glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, 1.f) };
+    for (const glm::vec3& axis : axes)
+    {
+        if (separated(axis))
+            return false;
+    }
+    if (separated(glm::cross(edges[0], edges[1])))
+        return false;
+    for (const glm::vec3& edge : edges)
+    {
+        for (const glm::vec3& axis : axes)
+        {
+            if (separated(glm::cross(edge, axis)))
+                return false;
+        }
+    }
+    return true;
+}
+
+Bvh::Bvh(BvhSettings settings)
+    : settings(settings)
+{
+    this->settings.bins = std::clamp(this->settings.bins, 2, 64);
+    this->settings.leafSize = std::max(this->settings.leafSize, 1);
+}
+
+void Bvh::addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, uint32_t owner)
+{
+    corners.insert(corners.end(), { a, b, c });
+    owners.push_back(owner);
+}
+
+void Bvh::addMesh(Mesh& mesh, uint32_t owner)
+{
+    glm::mat4 model = mesh.getModel();
+    const std::vector<glm::vec3>& positions = mesh.getPositions();
+    const std::vector<GLuint>& indices = mesh.getIndices();
+    auto world = [&](size_t i) { return glm::vec3(model * glm::vec4(positions[i], 1.f)); };
+    if (indices.empty())
+    {
+        for (size_t i = 0; i + 2 < positions.size(); i += 3)
+            addTriangle(world(i), world(i + 1), world(i + 2), owner);
+    }
+    else
+    {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            addTriangle(world(indices[i]), world(indices[i + 1]), world(indices[i + 2]), owner);
+    }
+}
+
+int Bvh::buildNode(BuildData& data, std::vector<Node>& out, uint32_t index, uint32_t begin, uint32_t end,
+    int level, std::vector<Subtree>* deferred) const
+{
+    uint32_t count = end - begin;
+    if (deferred != nullptr && count <= settings.parallelSize)
+    {
+        deferred->push_back({ index, begin, end, level });
+        return level;
+    }
+
+    AABB bounds = EmptyBox(), centroidBounds = EmptyBox();
+    for (uint32_t i = begin; i < end; i++)
+    {
+        uint32_t triangle = data.order[i];
+        Grow(bounds, data.boxes[triangle]);
+        centroidBounds.min = glm::min(centroidBounds.min, data.centroids[triangle]);
+        centroidBounds.max = glm::max(centroidBounds.max, data.centroids[triangle]);
+    }
+    out[index].bounds = bounds;
+    auto leaf = [&]() {
+        out[index].start = begin;
+        out[index].count = count;
+        return level + 1;
+    };
+    if (count <= (uint32_t)settings.leafSize)
+        return leaf();
+
+    //cost of each split between bins, in units of one triangle test: the children's
+    //areas times their triangles, the node's area standing for the traversal step
+    const int bins = settings.bins;
+    AABB binBounds[64], rightBounds[64];
+    uint32_t binCounts[64], rightCounts[64];
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (extent[axis] <= 0.f)
+            continue;
+        float scale = bins / extent[axis];
+        for (int bin = 0; bin < bins; bin++)
+        {
+            binBounds[bin] = EmptyBox();
+            binCounts[bin] = 0;
+        }
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t triangle = data.order[i];
+            int bin = std::min(bins - 1, (int)((data.centroids[triangle][axis] - centroidBounds.min[axis]) * scale));
+            Grow(binBounds[bin], data.boxes[triangle]);
+            binCounts[bin]++;
+        }
+        AABB right = EmptyBox();
+        uint32_t rightCount = 0;
+        for (int bin = bins - 1; bin > 0; bin--)
+        {
+            Grow(right, binBounds[bin]);
+            rightCount += binCounts[bin];
+            rightBounds[bin] = right;
+            rightCounts[bin] = rightCount;
+        }
+        AABB left = EmptyBox();
+        uint32_t leftCount = 0;
+        for (int split = 1; split < bins; split++)
+        {
+            Grow(left, binBounds[split - 1]);
+            leftCount += binCounts[split - 1];
+            if (leftCount == 0 || rightCounts[split] == 0)
+                continue;
+            float cost = HalfArea(left) * leftCount + HalfArea(rightBounds[split]) * rightCounts[split];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+    //all centroids in one place can't be split; small ranges stay whole when that's cheaper
+    float area = HalfArea(bounds);
+    if (bestAxis < 0 || (count <= 32 && bestCost + area >= area * count))
+        return leaf();
+
+    float scale = bins / extent[bestAxis];
+    float minimum = centroidBounds.min[bestAxis];
+    auto middle = std::partition(data.order.begin() + begin, data.order.begin() + end, [&](uint32_t triangle) {
+        return std::min(bins - 1, (int)((data.centroids[triangle][bestAxis] - minimum) * scale)) < bestSplit;
+    });
+    uint32_t split = (uint32_t)(middle - data.order.begin());
+
+    uint32_t left = (uint32_t)out.size();
+    out.push_back(Node());
+    out.push_back(Node());
+    out[index].start = left;
+    out[index].count = 0;
+    int leftDepth = buildNode(data, out, left, begin, split, level + 1, deferred);
+    int rightDepth = buildNode(data, out, left + 1, split, end, level + 1, deferred);
+    return std::max(leftDepth, rightDepth);
+}
+
+void Bvh::build(ThreadPool* pool)
+{
+    nodes.clear();
+    triangles.clear();
+    ids.clear();
+    depth = 0;
+    uint32_t count = (uint32_t)owners.size();
+    if (count == 0)
+        return;
+
+    BuildData data;
+    data.boxes.resize(count);
+    data.centroids.resize(count);
+    data.order.resize(count);
+    std::iota(data.order.begin(), data.order.end(), 0u);
+    auto prepare = [this, &data](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            const glm::vec3* corner = &corners[i * 3];
+            AABB& box = data.boxes[i];
+            box.min = glm::min(corner[0], glm::min(corner[1], corner[2]));
+            box.max = glm::max(corner[0], glm::max(corner[1], corner[2]));
+            data.centroids[i] = (box.min + box.max) * 0.5f;
+        }
+    };
+    if (pool != nullptr && count > settings.parallelSize)
+    {
+        std::vector<std::future<void>> jobs;
+        size_t slices = pool->size() * 4;
+        for (size_t slice = 0; slice < slices; slice++)
+            jobs.push_back(pool->submit([&prepare, count, slice, slices]() { prepare(count * slice / slices, count * (slice + 1) / slices); }));
+        for (std::future<void>& job : jobs)
+            job.get();
+    }
+    else
+        prepare(0, count);
+
+    nodes.reserve(2 * (size_t)count / settings.leafSize + 1);
+    nodes.push_back(Node());
+    std::vector<Subtree> deferred;
+    depth = buildNode(data, nodes, 0, 0, count, 0, pool != nullptr ? &deferred : nullptr);
+
+    //each job builds its subtree into its own array, spliced in afterwards: the job's
+    //root replaces the placeholder and the rest is appended with its links moved
+    std::vector<std::future<std::pair<std::vector<Node>, int>>> jobs;
+    for (const Subtree& subtree : deferred)
+    {
+        jobs.push_back(pool->submit([this, &data, subtree]() {
+            std::vector<Node> local(1);
+            int height = buildNode(data, local, 0, subtree.begin, subtree.end, subtree.level, nullptr);
+            return std::make_pair(std::move(local), height);
+        }));
+    }
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        std::pair<std::vector<Node>, int> built = jobs[i].get();
+        std::vector<Node>& local = built.first;
+        uint32_t offset = (uint32_t)nodes.size() - 1;
+        for (Node& node : local)
+        {
+            if (node.count == 0)
+                node.start += offset;
+        }
+        nodes[deferred[i].node] = local[0];
+        nodes.insert(nodes.end(), local.begin() + 1, local.end());
+        depth = std::max(depth, built.second);
+    }
+
+    ids = std::move(data.order);
+    triangles.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3* corner = &corners[(size_t)ids[i] * 3];
+        triangles[i] = { corner[0], corner[1] - corner[0], corner[2] - corner[0] };
+    }
+}
+
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhHit& hit) const
+{
+    if (nodes.empty())
+        return false;
+    glm::vec3 inverse(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+    struct Entry
+    {
+        uint32_t node;
+        float distance;
+    };
+    //each pop pushes at most two, so depth + 1 entries are enough
+    Entry fixed[64];
+    std::vector<Entry> grown;
+    Entry* stack = fixed;
+    if (depth + 1 > 64)
+    {
+        grown.resize(depth + 1);
+        stack = grown.data();
+    }
+
+    float entry;
+    if (!EnterBox(nodes[0].bounds, origin, inverse, maxDistance, entry))
+        return false;
+    int top = 0;
+    stack[top++] = { 0, entry };
+    float closest = maxDistance;
+    uint32_t found = UINT32_MAX;
+    while (top > 0)
+    {
+        Entry current = stack[--top];
+        if (current.distance > closest)
+            continue;
+        const Node& node = nodes[current.node];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.start; i < node.start + node.count; i++)
+            {
+                //Moller-Trumbore
+                const Triangle& triangle = triangles[i];
+                glm::vec3 p = glm::cross(direction, triangle.edge2);
+                float determinant = glm::dot(triangle.edge1, p);
+                if (std::abs(determinant) < 1e-12f)
+                    continue;
+                float inverseDeterminant = 1.f / determinant;
+                glm::vec3 s = origin - triangle.corner;
+                float u = glm::dot(s, p) * inverseDeterminant;
+                if (u < 0.f || u > 1.f)
+                    continue;
+                glm::vec3 q = glm::cross(s, triangle.edge1);
+                float v = glm::dot(direction, q) * inverseDeterminant;
+                if (v < 0.f || u + v > 1.f)
+                    continue;
+                float t = glm::dot(triangle.edge2, q) * inverseDeterminant;
+                if (t >= 0.f && t < closest)
+                {
+                    closest = t;
+                    found = i;
+                }
+            }
+            continue;
+        }
+        //nearer child on top
+        float leftEntry, rightEntry;
+        bool left = EnterBox(nodes[node.start].bounds, origin, inverse, closest, leftEntry);
+        bool right = EnterBox(nodes[node.start + 1].bounds, origin, inverse, closest, rightEntry);
+        if (left && right)
+        {
+            if (leftEntry <= rightEntry)
+            {
+                stack[top++] = { node.start + 1, rightEntry };
+                stack[top++] = { node.start, leftEntry };
+            }
+            else
+            {
+                stack[top++] = { node.start, leftEntry };
+                stack[top++] = { node.start + 1, rightEntry };
+            }
+        }
+        else if (left)
+            stack[top++] = { node.start, leftEntry };
+        else if (right)
+            stack[top++] = { node.start + 1, rightEntry };
+    }
+    if (found == UINT32_MAX)
+        return false;
+
+    const Triangle& triangle = triangles[found];
+    hit.distance = closest;
+    hit.triangle = ids[found];
+    hit.owner = owners[hit.triangle];
+    hit.position = origin + direction * closest;
+    hit.normal = glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+    if (glm::dot(hit.normal, direction) > 0.f)
+        hit.normal = -hit.normal;
+    return true;
+}
+
+bool Bvh::segment(const glm::vec3& from, const glm::vec3& to, BvhHit& hit) const
+{
+    float length = glm::length(to - from);
+    if (length <= 0.f)
+        return false;
+    return raycast(from, (to - from) / length, length, hit);
+}
+
+size_t Bvh::overlap(const AABB& box, std::vector<uint32_t>& found) const
+{
+    if (nodes.empty() || !BoxesOverlap(box, nodes[0].bounds))
+        return 0;
+    size_t before = found.size();
+    uint32_t fixed[64];
+    std::vector<uint32_t> grown;
+    uint32_t* stack = fixed;
+    if (depth + 1 > 64)
+    {
+        grown.resize(depth + 1);
+        stack = grown.data();
+    }
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.start; i < node.start + node.count; i++)
+            {
+                const Triangle& triangle = triangles[i];
+                if (TriangleOverlapsBox(triangle.corner, triangle.corner + triangle.edge1, triangle.corner + triangle.edge2, box))
+                    found.push_back(ids[i]);
+            }
+            continue;
+        }
+        for (uint32_t child = node.start; child < node.start + 2; child++)
+        {
+            if (BoxesOverlap(box, nodes[child].bounds))
+                stack[top++] = child;
+        }
+    }
+    return found.size() - before;
+}
+
+size_t Bvh::getMemoryBytes() const
+{
+    return corners.capacity() * sizeof(glm::vec3) + owners.capacity() * sizeof(uint32_t) + nodes.capacity() * sizeof(Node) +
+        triangles.capacity() * sizeof(Triangle) + ids.capacity() * sizeof(uint32_t);
+}
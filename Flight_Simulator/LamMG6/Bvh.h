@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "Frustum.h"
+#include "ThreadPool.h"
+
+class Mesh;
+
+//the closest triangle along a ray: its index in the order triangles were added, and
+//the owner it was added with
+struct BvhHit
+{
+	float distance = 0.f;
+	uint32_t triangle = 0;
+	uint32_t owner = 0;
+	glm::vec3 position = glm::vec3(0.f);
+	//turned to face the ray
+	glm::vec3 normal = glm::vec3(0.f, 1.f, 0.f);
+};
+
+struct BvhSettings
+{
+	//candidate split planes per axis
+	int bins = 16;
+	//ranges this small always become leaves
+	int leafSize = 4;
+	//below this many triangles a subtree is built by one pool job
+	size_t parallelSize = 16384;
+};
+
+//separating axis test of a triangle against a box
+bool TriangleOverlapsBox(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const AABB& box);
+
+//Bounding volume hierarchy over world space triangles, for picking, camera and
+//taxiing collisions. Nodes split where the surface area heuristic, evaluated at a
+//fixed number of bins per axis, is cheapest; the top levels are split on the calling
+//thread and the subtrees below parallelSize are built as pool jobs. Triangles are
+//stored in leaf order as a corner and two edges, ready for Moller-Trumbore.
+class Bvh
+{
+private:
+	struct Node
+	{
+		AABB bounds;
+		//leaf: first triangle, inner: left child, the right one follows it
+		uint32_t start = 0;
+		//triangles in a leaf, 0 for inner nodes
+		uint32_t count = 0;
+	};
+	struct Triangle
+	{
+		glm::vec3 corner, edge1, edge2;
+	};
+
+	BvhSettings settings;
+	//as added, three corners each
+	std::vector<glm::vec3> corners;
+	std::vector<uint32_t> owners;
+	std::vector<Node> nodes;
+	//leaf order, and which added triangle each one is
+	std::vector<Triangle> triangles;
+	std::vector<uint32_t> ids;
+	int depth = 0;
+
+	struct BuildData;
+	//a node whose range is left to a pool job
+	struct Subtree
+	{
+		uint32_t node, begin, end;
+		int level;
+	};
+	//fills out[index] over the triangles in order[begin, end), returns the deepest level
+	//below it; ranges small enough for a job go to deferred when there is one
+	int buildNode(BuildData& data, std::vector<Node>& out, uint32_t index, uint32_t begin, uint32_t end,
+		int level, std::vector<Subtree>* deferred) const;
+
+public:
+	Bvh(BvhSettings settings = BvhSettings());
+
+	void addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, uint32_t owner);
+	//the mesh's triangles through its model matrix
+	void addMesh(Mesh& mesh, uint32_t owner);
+	//(re)builds over everything added so far; serial without a pool
+	void build(ThreadPool* pool = nullptr);
+
+	//closest hit within maxDistance along a unit direction
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhHit& hit) const;
+	//first hit going from one point to the other
+	bool segment(const glm::vec3& from, const glm::vec3& to, BvhHit& hit) const;
+	//appends the triangles touching the box, returns how many
+	size_t overlap(const AABB& box, std::vector<uint32_t>& found) const;
+
+	size_t getTriangleCount() const { return owners.size(); }
+	uint32_t getOwner(uint32_t triangle) const { return owners[triangle]; }
+	size_t getNodeCount() const { return nodes.size(); }
+	int getDepth() const { return depth; }
+	size_t getMemoryBytes() const;
+};
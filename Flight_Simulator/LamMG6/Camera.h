@@ -4,6 +4,7 @@
 #include <gtc/type_ptr.hpp>
 #include "Shader.h"
 #include "Mesh.h"
+#include "FlightModel.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -19,20 +20,20 @@ enum ECameraMovementType
     DOWN
 };
 
-bool leftpressed = false;
-bool rightpressed = false;
 bool pressable3 = false;
 bool pressable4 = false;
 bool Darker;
 bool Lighter;
-bool UpPressed = false;
-bool DownPressed = false;
+//B switches; the render queue stays the default until the batch is timed on a real GPU
+bool UseStaticBatch = false;
+bool pressable5 = true;
+//P prints the per mesh memory report
+bool MemoryDumpRequested = false;
+bool pressable6 = true;
 bool cursor = true;
 bool fullscreen = false;
 bool pressable = true;
 bool pressable2 = true;
-float turnspeed = 0.0f;
-float tiltspeed = 0.0f;
 
 class Camera
 {
@@ -79,9 +80,9 @@ public:
     {
         glm::mat4 projection = this->GetProjectionMatrix();
         glm::mat4 view = this->GetViewMatrix();
-        shader->SetMat4("projection", projection);
-        shader->SetMat4("view", view);
-        shader->SetVec3("viewPos", position);
+        shader->SetMat4(shader->ProjectionUniform, projection);
+        shader->SetMat4(shader->ViewUniform, view);
+        shader->SetVec3(shader->ViewPosUniform, position);
     }
 
     void Set(const int width, const int height, const glm::vec3& position)
@@ -131,6 +132,21 @@ public:
         return position;
     }
 
+    float GetFoVy() const
+    {
+        return FoVy;
+    }
+
+    int GetWidth() const
+    {
+        return width;
+    }
+
+    int GetHeight() const
+    {
+        return height;
+    }
+
     void SetPosition(glm::vec3 position)
     {
         this->position = position;
@@ -204,7 +220,6 @@ public:
     float pitch;
     float offset = 0.0f;
     float frontTilt = 13.0f;
-    float speed = 0.0f;
 
 private:
     void ProcessMouseMovement(float xOffset, float yOffset, bool constrainPitch = true)
@@ -246,99 +261,27 @@ protected:
     float lastX = 0.f, lastY = 0.f;
 };
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void processInput(GLFWwindow* window, Camera *pCamera, double deltaTime, Mesh* Player)
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly;
+// the aircraft keys are returned for the flight model, camera moves are scaled by the frame time
+FlightControls processInput(GLFWwindow* window, Camera *pCamera, double deltaTime, Mesh* Player)
 {
+    FlightControls controls;
+    float frames = (float)deltaTime * FLIGHT_TUNING_RATE;
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-    {
-        UpPressed = true;
-    }
-    else
-    {
-        UpPressed = false;
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-    {
-        DownPressed = true;
-    }
-    else
-    {
-        DownPressed = false;
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-    {
-        leftpressed = true;
-            if (turnspeed < 0.2f)
-                turnspeed += 0.0005;
-            Player->setRotation(Player->getRotation() + glm::vec3(0.0f, turnspeed *5.f, 0.0f));
-            if (Player->getPosition().y > 0.f)
-            {
-                if (tiltspeed < 0.2f)
-                    tiltspeed += 0.0005;
-            }
-    }
-    else
-    {
-        if (turnspeed > 0.0f)
-            turnspeed -= 0.0005;
-        if (Player->getPosition().y > 0.f)
-        {
-            Player->setRotation(Player->getRotation() + glm::vec3(0.0f, turnspeed * 5.f, 0.0f));
-            if (tiltspeed > 0.0f)
-                tiltspeed -= 0.0005;
-        }
-        else
-        {
-            leftpressed = false;
-            tiltspeed = 0.0f;
-            if (turnspeed > 0.0f)
-                turnspeed = 0.0f;
-        }
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-    {
-        rightpressed = true;
-        if (turnspeed > -0.2f)
-            turnspeed -= 0.0005;
-        Player->setRotation(Player->getRotation() + glm::vec3(0.0f, turnspeed * 5.f, 0.0f));
-        if (Player->getPosition().y > 0.f)
-        {
-            if (tiltspeed > -0.2f)
-                tiltspeed -= 0.0005;
-        }
-    }
-    else
-    {
-        if (turnspeed < 0.0f)
-            turnspeed += 0.0005;
-        if (Player->getPosition().y > 0.f)
-        {
-            Player->setRotation(Player->getRotation() + glm::vec3(0.0f, turnspeed * 5.f, 0.0f));
-            if (tiltspeed < 0.0f)
-                tiltspeed += 0.0005;
-        }
-        else
-        {
-            rightpressed = false;
-            tiltspeed = 0.0f;
-            if (turnspeed < 0.0f)
-                turnspeed = 0.0f;
-        }
-    }
+    controls.throttleUp = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    controls.throttleDown = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    controls.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    controls.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
 
     if (glfwGetKey(window, GLFW_KEY_LEFT))
     {
-            pCamera->offset -= 0.3f;
+            pCamera->offset -= 0.3f * frames;
     }
     if (glfwGetKey(window, GLFW_KEY_RIGHT))
     {
-            pCamera->offset += 0.3f;
+            pCamera->offset += 0.3f * frames;
     }
 
     if (glfwGetKey(window, GLFW_KEY_Y))
@@ -354,7 +297,7 @@ void processInput(GLFWwindow* window, Camera *pCamera, double deltaTime, Mesh* P
     {
         if (pCamera->pitch < -5.0f)
         {
-            pCamera->pitch += 0.07f;
+            pCamera->pitch += 0.07f * frames;
             pCamera->UpdateCameraVectors();
         }
     }
@@ -362,7 +305,7 @@ void processInput(GLFWwindow* window, Camera *pCamera, double deltaTime, Mesh* P
     {
         if (pCamera->pitch > -26.0f)
         {
-            pCamera->pitch -= 0.07f;
+            pCamera->pitch -= 0.07f * frames;
             pCamera->UpdateCameraVectors();
         }
     }
@@ -414,6 +357,33 @@ void processInput(GLFWwindow* window, Camera *pCamera, double deltaTime, Mesh* P
     {
         pressable4 = true;
     }
+
+    if (glfwGetKey(window, GLFW_KEY_B))
+    {
+        if (pressable5 == true)
+        {
+            UseStaticBatch = !UseStaticBatch;
+        }
+        pressable5 = false;
+    }
+    else
+    {
+        pressable5 = true;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_P))
+    {
+        if (pressable6 == true)
+        {
+            MemoryDumpRequested = true;
+        }
+        pressable6 = false;
+    }
+    else
+    {
+        pressable6 = true;
+    }
+    return controls;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
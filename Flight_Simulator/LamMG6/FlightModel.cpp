@@ -0,0 +1,272 @@
+#include "FlightModel.h"
+#include <algorithm>
+#include <cmath>
+
+//the step on loose fields, so one state struct and the batch's arrays share it;
+//groundAt(x, z) gives the GroundSample under a point
+template <typename Ground>
+static inline void StepAircraft(float& x, float& y, float& z, float& pitch, float& heading, float& bank,
+    float& speed, float& turnSpeed, float& tiltSpeed, bool& grounded, bool& crashed, const FlightControls& controls, float dt,
+    const Ground& groundAt)
+{
+    if (crashed)
+        return;
+    //frames' worth of the tuning rate in this step
+    float frames = dt * FLIGHT_TUNING_RATE;
+    float deltaAltitude = (speed - 0.5f) * 2.f;
+
+    float ground = groundAt(x, z).height;
+    if (y < ground)
+        y = ground;
+    float startY = y;
+    bool wasGrounded = y <= ground;
+    if (y > ground)
+    {
+        //leaving the runway straightens the nose wheel
+        if (grounded)
+            turnSpeed = 0.f;
+        grounded = false;
+    }
+    else
+        grounded = true;
+
+    if (controls.throttleUp)
+    {
+        if (speed < 1.f)
+            speed += 0.0008f * frames;
+    }
+    else if (controls.throttleDown)
+    {
+        if (speed > 0.f)
+            speed -= 0.001f * frames;
+    }
+    else if (speed > 0.f)
+        speed -= 0.0003f * frames;
+
+    //above half speed the aircraft climbs, below it sinks
+    if (speed > 0.5f)
+        y += (speed - 0.5f) * 5.f * frames;
+    else if (speed < 0.5f && y > ground)
+        y += (speed - 0.5f) * 50.f * frames;
+
+    float radians = glm::radians(heading);
+    float Xrot = 0.f, Zrot = 0.f, Xstrife = 0.f, Zstrife = 0.f;
+    if (y > ground)
+    {
+        Xstrife = tiltSpeed * 200.f * std::sin(radians);
+        Zstrife = tiltSpeed * 200.f * std::cos(radians);
+        float climb = speed > 0.5f ? 25.f : 45.f;
+        Xrot = deltaAltitude * climb * std::cos(radians);
+        Zrot = deltaAltitude * climb * -std::sin(radians);
+    }
+    float angle = std::abs(Xrot) + std::abs(Zrot);
+    if (heading > 0.f)
+        angle *= 2;
+    else
+        angle /= 4.f;
+    float momentum = std::abs(std::cos(glm::radians(angle)));
+    float distance = speed * momentum * 15.f * frames;
+    x += std::sin(radians) * distance;
+    z += std::cos(radians) * distance;
+    pitch = -(Xrot + Xstrife);
+    bank = -(Zrot + Zstrife);
+
+    //on the ground the wheels follow the relief until the aircraft climbs away
+    GroundSample below = groundAt(x, z);
+    if (y < below.height || (wasGrounded && speed <= 0.5f))
+    {
+        //coming down onto gentle ground is a landing; terrain that rose above where the
+        //aircraft was, or a slope too steep for the wheels, is a crash
+        if (!wasGrounded && (below.height > startY || below.normal.y < FLIGHT_LANDING_SLOPE))
+        {
+            crashed = true;
+            speed = turnSpeed = tiltSpeed = 0.f;
+        }
+        y = below.height;
+    }
+
+    //rudder: each side eases off on its own, so in the air the yaw is applied by both
+    bool airborne = y > below.height;
+    if (controls.left)
+    {
+        if (turnSpeed < 0.2f)
+            turnSpeed += 0.0005f * frames;
+        heading += turnSpeed * 5.f * frames;
+        if (airborne && tiltSpeed < 0.2f)
+            tiltSpeed += 0.0005f * frames;
+    }
+    else
+    {
+        if (turnSpeed > 0.f)
+            turnSpeed -= 0.0005f * frames;
+        if (airborne)
+        {
+            heading += turnSpeed * 5.f * frames;
+            if (tiltSpeed > 0.f)
+                tiltSpeed -= 0.0005f * frames;
+        }
+        else
+        {
+            tiltSpeed = 0.f;
+            turnSpeed = std::min(turnSpeed, 0.f);
+        }
+    }
+    if (controls.right)
+    {
+        if (turnSpeed > -0.2f)
+            turnSpeed -= 0.0005f * frames;
+        heading += turnSpeed * 5.f * frames;
+        if (airborne && tiltSpeed > -0.2f)
+            tiltSpeed -= 0.0005f * frames;
+    }
+    else
+    {
+        if (turnSpeed < 0.f)
+            turnSpeed += 0.0005f * frames;
+        if (airborne)
+        {
+            heading += turnSpeed * 5.f * frames;
+            if (tiltSpeed < 0.f)
+                tiltSpeed += 0.0005f * frames;
+        }
+        else
+        {
+            tiltSpeed = 0.f;
+            turnSpeed = std::max(turnSpeed, 0.f);
+        }
+    }
+}
+
+//the y = 0 plane
+static GroundSample FlatGround(float, float)
+{
+    return GroundSample();
+}
+
+void StepFlight(FlightState& state, const FlightControls& controls, float dt)
+{
+    StepAircraft(state.position.x, state.position.y, state.position.z, state.rotation.x, state.rotation.y, state.rotation.z,
+        state.speed, state.turnSpeed, state.tiltSpeed, state.grounded, state.crashed, controls, dt, FlatGround);
+}
+
+void StepFlight(FlightState& state, const FlightControls& controls, float dt, const std::function<GroundSample(float, float)>& groundAt)
+{
+    if (!groundAt)
+    {
+        StepFlight(state, controls, dt);
+        return;
+    }
+    StepAircraft(state.position.x, state.position.y, state.position.z, state.rotation.x, state.rotation.y, state.rotation.z,
+        state.speed, state.turnSpeed, state.tiltSpeed, state.grounded, state.crashed, controls, dt, groundAt);
+}
+
+FlightControls FlightPlan::controlsAt(double time) const
+{
+    FlightControls controls;
+    controls.throttleUp = time < throttleUpUntil;
+    controls.throttleDown = time >= throttleDownFrom;
+    bool turning = time >= turnFrom && time < turnUntil;
+    controls.left = turning && turnLeft;
+    controls.right = turning && !turnLeft;
+    return controls;
+}
+
+void FlightBatch::resize(size_t count)
+{
+    for (std::vector<float>* field : { &x, &y, &z, &pitch, &heading, &bank, &speed, &turnSpeed, &tiltSpeed })
+        field->resize(count, 0.f);
+    grounded.resize(count, 1);
+    crashed.resize(count, 0);
+    plans.resize(count);
+}
+
+FlightState FlightBatch::get(size_t i) const
+{
+    FlightState state;
+    state.position = glm::vec3(x[i], y[i], z[i]);
+    state.rotation = glm::vec3(pitch[i], heading[i], bank[i]);
+    state.speed = speed[i];
+    state.turnSpeed = turnSpeed[i];
+    state.tiltSpeed = tiltSpeed[i];
+    state.grounded = grounded[i] != 0;
+    state.crashed = crashed[i] != 0;
+    return state;
+}
+
+void FlightBatch::set(size_t i, const FlightState& state)
+{
+    x[i] = state.position.x;
+    y[i] = state.position.y;
+    z[i] = state.position.z;
+    pitch[i] = state.rotation.x;
+    heading[i] = state.rotation.y;
+    bank[i] = state.rotation.z;
+    speed[i] = state.speed;
+    turnSpeed[i] = state.turnSpeed;
+    tiltSpeed[i] = state.tiltSpeed;
+    grounded[i] = state.grounded ? 1 : 0;
+    crashed[i] = state.crashed ? 1 : 0;
+}
+
+template <typename Ground>
+static void StepFlightRange(FlightBatch& batch, size_t begin, size_t end, double time, float dt, const Ground& groundAt)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        bool grounded = batch.grounded[i] != 0, crashed = batch.crashed[i] != 0;
+        StepAircraft(batch.x[i], batch.y[i], batch.z[i], batch.pitch[i], batch.heading[i], batch.bank[i],
+            batch.speed[i], batch.turnSpeed[i], batch.tiltSpeed[i], grounded, crashed, batch.plans[i].controlsAt(time), dt, groundAt);
+        batch.grounded[i] = grounded ? 1 : 0;
+        batch.crashed[i] = crashed ? 1 : 0;
+    }
+}
+
+void StepFlightBatch(FlightBatch& batch, size_t begin, size_t end, double time, float dt, const TerrainQuery* terrain)
+{
+    if (terrain == nullptr)
+        StepFlightRange(batch, begin, end, time, dt, FlatGround);
+    else
+        StepFlightRange(batch, begin, end, time, dt, [terrain](float x, float z) { return terrain->sample(x, z); });
+}
+
+FlightState InterpolateFlight(const FlightState& from, const FlightState& to, float alpha)
+{
+    FlightState state = to;
+    state.position = from.position + (to.position - from.position) * alpha;
+    state.rotation = from.rotation + (to.rotation - from.rotation) * alpha;
+    state.speed = from.speed + (to.speed - from.speed) * alpha;
+    return state;
+}
+
+FlightModel::FlightModel(double rate)
+    : step(1.0 / rate)
+{
+}
+
+void FlightModel::reset(const FlightState& state)
+{
+    previous = current = state;
+    accumulator = 0.0;
+    steps = 0;
+}
+
+int FlightModel::advance(double frameSeconds, const std::function<FlightControls(double)>& controlsAt,
+    const std::function<GroundSample(float, float)>& groundAt)
+{
+    accumulator += std::min(frameSeconds, 0.25);
+    int taken = 0;
+    while (accumulator >= step)
+    {
+        previous = current;
+        StepFlight(current, controlsAt(getTime()), (float)step, groundAt);
+        accumulator -= step;
+        steps++;
+        taken++;
+    }
+    return taken;
+}
+
+FlightState FlightModel::interpolated() const
+{
+    return InterpolateFlight(previous, current, (float)(accumulator / step));
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glm.hpp>
+#include "TerrainQuery.h"
+
+//the per-step constants were tuned as per-frame increments at this frame rate
+const float FLIGHT_TUNING_RATE = 60.f;
+//steepest ground a touchdown survives, as the normal's y: about 20 degrees
+const float FLIGHT_LANDING_SLOPE = 0.94f;
+
+//what the keyboard asks for during one step
+struct FlightControls
+{
+	bool throttleUp = false;
+	bool throttleDown = false;
+	bool left = false;
+	bool right = false;
+};
+
+struct FlightState
+{
+	glm::vec3 position = glm::vec3(0.f);
+	//degrees: x and z are the pitch/bank from climbing and turning, y the heading
+	glm::vec3 rotation = glm::vec3(0.f, 180.f, 0.f);
+	//0..1, 0.5 holds altitude
+	float speed = 0.f;
+	float turnSpeed = 0.f;
+	float tiltSpeed = 0.f;
+	bool grounded = true;
+	//flew into the ground; the aircraft stays where it hit until reset
+	bool crashed = false;
+};
+
+//advances state by dt seconds; pure, so replays and batches give the same result.
+//The ground is the y = 0 plane unless groundAt samples it, e.g. from a TerrainQuery.
+void StepFlight(FlightState& state, const FlightControls& controls, float dt);
+void StepFlight(FlightState& state, const FlightControls& controls, float dt, const std::function<GroundSample(float, float)>& groundAt);
+//between two steps, alpha 0 is from and 1 is to
+FlightState InterpolateFlight(const FlightState& from, const FlightState& to, float alpha);
+
+//scripted stick for headless runs: full throttle, one turn, throttle back
+struct FlightPlan
+{
+	float throttleUpUntil = 20.f;
+	float turnFrom = 0.f;
+	float turnUntil = 0.f;
+	bool turnLeft = true;
+	float throttleDownFrom = 1e30f;
+
+	FlightControls controlsAt(double time) const;
+};
+
+//Many aircraft as a structure of arrays, one vector per field, for StepFlightBatch
+struct FlightBatch
+{
+	std::vector<float> x, y, z;
+	std::vector<float> pitch, heading, bank;
+	std::vector<float> speed, turnSpeed, tiltSpeed;
+	std::vector<uint8_t> grounded;
+	std::vector<uint8_t> crashed;
+	std::vector<FlightPlan> plans;
+
+	size_t size() const { return x.size(); }
+	//new aircraft start at rest on the origin, heading 0
+	void resize(size_t count);
+	FlightState get(size_t i) const;
+	void set(size_t i, const FlightState& state);
+};
+
+//one step of aircraft [begin, end) at simulated time; ranges don't share anything, so
+//threads can each take one; over terrain when one is given, the y = 0 plane otherwise
+void StepFlightBatch(FlightBatch& batch, size_t begin, size_t end, double time, float dt, const TerrainQuery* terrain = nullptr);
+
+//Integrates StepFlight at a fixed rate whatever the frame rate: frame time goes into
+//an accumulator, whole steps come out, and the renderer draws the state interpolated
+//between the last two steps by what is left over.
+class FlightModel
+{
+private:
+	FlightState previous;
+	FlightState current;
+	double step;
+	double accumulator = 0.0;
+	uint64_t steps = 0;
+
+public:
+	FlightModel(double rate = 120.0);
+	void reset(const FlightState& state);
+	//controlsAt is asked once per step with the simulated time of that step;
+	//frames longer than a quarter second are cut short rather than catching up; groundAt
+	//as for StepFlight
+	int advance(double frameSeconds, const std::function<FlightControls(double)>& controlsAt,
+		const std::function<GroundSample(float, float)>& groundAt = nullptr);
+	FlightState interpolated() const;
+	const FlightState& getState() const { return current; }
+	double getStep() const { return step; }
+	double getTime() const { return steps * step; }
+	uint64_t getSteps() const { return steps; }
+};
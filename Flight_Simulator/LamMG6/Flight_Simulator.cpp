@@ -12,16 +12,33 @@
 #include "OBJLoader.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "Benchmark.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+#include "AssetLoader.h"
+#include "TextureStreamer.h"
+#include "GLStats.h"
+#include "GLState.h"
+#include "Scene.h"
+#include "StaticBatch.h"
+#include "InstancedMesh.h"
+#include "Terrain.h"
+#include "TerrainStreamer.h"
+#include "FlightModel.h"
+#include "Bvh.h"
+#include "ProcessMemory.h"
+#include "ResourceManager.h"
 #include <GL/freeglut.h>
 //#include <stb_image.h>
 #include <filesystem>
+#include <iomanip>
 
 #pragma comment (lib, "glfw3dll.lib")
 #pragma comment (lib, "glew32.lib")
 #pragma comment (lib, "OpenGL32.lib")
 
 float skylight;
-void changeHour(Shader& shader1, Shader& shader2)
+void changeHour(std::initializer_list<Shader*> shaders)
 {
     static glm::vec3 value(0.6f);
     skylight = value.x;
@@ -30,10 +47,11 @@ void changeHour(Shader& shader1, Shader& shader2)
         if (value.x > 0.2f)
         {
             value -= glm::vec3(0.05f);
-            shader1.Use();
-            shader1.SetVec3("lightColor", value);
-            shader2.Use();
-            shader2.SetVec3("lightColor", value);
+            for (Shader* shader : shaders)
+            {
+                shader->Use();
+                shader->SetVec3("lightColor", value);
+            }
         }
         Darker = false;
     }
@@ -43,157 +61,13 @@ void changeHour(Shader& shader1, Shader& shader2)
         if (value.x < 0.9f)
         {
             value += glm::vec3(0.05f);
-            shader1.Use();
-            shader1.SetVec3("lightColor", value);
-            shader2.Use();
-            shader2.SetVec3("lightColor", value);
-        }
-        Lighter = false;
-    }
-}
-
-std::vector<Mesh> Aeroport;
-unsigned int GrassTex;
-unsigned int RoadTex;
-unsigned int RoofTex;
-unsigned int GrindaTex;
-unsigned int TileTex;
-unsigned int LeafTex;
-unsigned int TurnTex;
-
-void AeroportInit()
-{
-    Mesh AcoperisHangar("AA/AcoperisHangar.obj"); //0
-    Aeroport.push_back(AcoperisHangar);
-
-    Mesh DeepGarnet("AA/DeepGarnet.obj"); //1
-    DeepGarnet.setColor(0, glm::vec3(0.8f, 0.15f, 0.3f));
-    Aeroport.push_back(DeepGarnet);
-
-    Mesh FrunzeCopaci("AA/FrunzeCopaci.obj"); //2
-    Aeroport.push_back(FrunzeCopaci);
-
-    Mesh Iarba("AA/Iarba.obj"); //3
-    Aeroport.push_back(Iarba);
-
-    Mesh InteriorHangar("AA/InteriorHangar.obj"); //4
-    Aeroport.push_back(InteriorHangar);
-
-    Mesh MetalAvion("AA/MetalAvion.obj"); //5
-    MetalAvion.setColor(0, glm::vec3(0.5f, 0.5f, 0.5f));
-    Aeroport.push_back(MetalAvion);
-
-    Mesh MetalHangare("AA/MetalHangare.obj"); //6
-    Aeroport.push_back(MetalHangare);
-
-    Mesh NegruAvion("AA/NegruAvion.obj"); //7
-    NegruAvion.setColor(0, glm::vec3(0.1f, 0.1f, 0.1f));
-    Aeroport.push_back(NegruAvion);
-
-    Mesh PlaneMetal("AA/PlaneMetal.obj"); //8
-    PlaneMetal.setColor(0, glm::vec3(0.85f, 0.85f, 0.85f));
-    Aeroport.push_back(PlaneMetal);
-
-    Mesh Road("AA/Road.obj"); //9
-    Aeroport.push_back(Road);
-
-    Mesh TurnBaza("AA/TurnBaza1.obj"); //10
-    TurnBaza.setColor(0, glm::vec3(0.85f, 0.85f, 0.85f));
-    Aeroport.push_back(TurnBaza);
-
-    Mesh TurnBazaTexture("AA/TurnBazaTexture.obj"); //11
-    Aeroport.push_back(TurnBazaTexture);
-
-    Mesh TurnVarfAlb("AA/TurnVarfAlb.obj"); //12
-    TurnVarfAlb.setColor(0, glm::vec3(0.85f, 0.85f, 0.85f));
-    Aeroport.push_back(TurnVarfAlb);
-
-    Mesh TurnVarfNegru("AA/TurnVarfNegru.obj"); //13
-    TurnVarfNegru.setColor(0, glm::vec3(0.0f, 0.0f, 0.0f));
-    Aeroport.push_back(TurnVarfNegru);
-
-    Mesh Fundatie("AA/Fundatie.obj"); //14
-    Aeroport.push_back(Fundatie);
-
-    for (int i = 0; i < Aeroport.size(); i++)
-    {
-        if (i != 3 && i != 9 && i!= 14)
-            Aeroport[i].setPosition(glm::vec3(10.f, -7.f, 10.f));
-        else
-            Aeroport[i].setPosition(glm::vec3(10.f, 0.f, 10.f));
-        Aeroport[i].setScale(glm::vec3(10.f));
-        Aeroport[i].initVAO();
-    }
-
-    GrassTex = CreateTexture("Resources/Grass.jpg");
-    RoadTex = CreateTexture("Resources/Road.jpg");
-    RoofTex = CreateTexture("Resources/Shelter_simple_greenpanel.jpg");
-    LeafTex = CreateTexture("10459_White_Ash_Tree_v1_Diffuse.jpg");
-    TurnTex = CreateTexture("Resources/tower2.jpg");
-    TileTex = CreateTexture("Resources/Shelter_simple_whitepanel.jpg");
-    GrindaTex = CreateTexture("Resources/Shelter_simple_frame.bmp");
-}
-
-void AeroportRender(Shader& shaderT, Shader& shaderM)
-{
-    shaderT.Use();
-    for (int i = 0; i < Aeroport.size(); i++)
-    {
-        if (i == 3)
-        {
-            glBindTexture(GL_TEXTURE_2D, GrassTex);
-            Aeroport[i].render(&shaderT);
-        }
-        else
-            if (i == 9)
+            for (Shader* shader : shaders)
             {
-                glBindTexture(GL_TEXTURE_2D, RoadTex);
-                Aeroport[i].render(&shaderT);
+                shader->Use();
+                shader->SetVec3("lightColor", value);
             }
-            else
-                if (i == 0)
-                {
-                    glBindTexture(GL_TEXTURE_2D, RoofTex);
-                    Aeroport[i].render(&shaderT);
-                }
-                else
-                    if (i == 2)
-                    {
-                        glBindTexture(GL_TEXTURE_2D, LeafTex);
-                        Aeroport[i].render(&shaderT);
-                    }
-                    else
-                        if (i == 11)
-                        {
-                            glBindTexture(GL_TEXTURE_2D, TurnTex);
-                            Aeroport[i].render(&shaderT);
-                        }
-                        else
-                            if (i == 4)
-                            {
-                                glBindTexture(GL_TEXTURE_2D, TileTex);
-                                Aeroport[i].render(&shaderT);
-                            }
-                            else
-                                if (i == 6)
-                                {
-                                    glBindTexture(GL_TEXTURE_2D, GrindaTex);
-                                    Aeroport[i].render(&shaderT);
-                                }
-                                else
-                                    if(i == 14)
-                                {
-                                        glBindTexture(GL_TEXTURE_2D, RoadTex);
-                                        Aeroport[i].render(&shaderT);
-                                }
-    }
-    shaderM.Use();
-    for (int i = 0; i < Aeroport.size(); i++)
-    {
-        if (i != 3 && i != 9 && i!= 0 && i!=2 && i!=11 && i!=4 && i!=6 && i!=14)
-        {
-            Aeroport[i].render(&shaderM);
         }
+        Lighter = false;
     }
 }
 
@@ -215,11 +89,145 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     pCamera->MouseControl((float)xpos, (float)ypos);
 }
 
+//a left click asks the main loop what is under the cursor
+bool PickRequested = false;
+double PickX = 0.0, PickY = 0.0;
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    {
+        glfwGetCursorPos(window, &PickX, &PickY);
+        PickRequested = true;
+    }
+}
+
 const unsigned int width = 1920;
 const unsigned int height = 1080;
 
-int main(void)
+int main(int argc, char** argv)
 {
+    //offline modes, no window needed
+    if (argc > 1 && std::string(argv[1]) == "--bench-obj")
+    {
+        BenchmarkOBJLoaders(argc > 2 ? argv[2] : ".");
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--cook-meshes")
+    {
+        CookMeshCaches(argc > 2 ? argv[2] : ".");
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--cook-textures")
+    {
+        CookTextureCaches(argc > 2 ? argv[2] : ".");
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-mesh-cache")
+    {
+        BenchmarkMeshCache(argc > 2 ? argv[2] : ".");
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--mem-report")
+    {
+        ReportVertexMemory(argc > 2 ? argv[2] : ".");
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-materials")
+    {
+        BenchmarkMaterials(argc > 2 ? argv[2] : "AA/DeepGarnet.obj");
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--verify-loading")
+    {
+        Scene aeroport;
+        aeroport.load("Aeroport.scene");
+        std::vector<std::string> files;
+        for (const SceneObject& object : aeroport.getObjects())
+            files.push_back(object.mesh);
+        files.push_back("Plane.obj");
+        files.push_back("Transilvania.obj");
+        return VerifyParallelLoading(files) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--test-frustum")
+        return VerifyFrustumCulling() ? 0 : 1;
+    //opens its own hidden window
+    if (argc > 1 && std::string(argv[1]) == "--terrain-bench")
+    {
+        BenchmarkTerrain(argc > 2 ? std::stoi(argv[2]) : 16385);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--make-hgt")
+    {
+        //directory, south west tile, rows, columns, samples per side
+        if (argc < 7)
+        {
+            std::cout << "usage: --make-hgt <directory> <latitude> <longitude> <rows> <columns> [size]\n";
+            return 1;
+        }
+        return WriteSyntheticHgt(argv[2], std::stoi(argv[3]), std::stoi(argv[4]), std::stoi(argv[5]), std::stoi(argv[6]),
+            argc > 7 ? std::stoi(argv[7]) : 1201, 1) ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--test-hgt")
+        return VerifyHgtStreaming() ? 0 : 1;
+    if (argc > 1 && std::string(argv[1]) == "--test-flight")
+        return VerifyFlightReplay() ? 0 : 1;
+    if (argc > 1 && std::string(argv[1]) == "--batch-flight")
+    {
+        SimulateFlightBatch(argc > 2 ? std::stoul(argv[2]) : 10000, argc > 3 ? std::stod(argv[3]) : 120.0);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--test-terrain-query")
+        return VerifyTerrainQuery() ? 0 : 1;
+    if (argc > 1 && std::string(argv[1]) == "--bench-terrain-query")
+    {
+        BenchmarkTerrainQuery(argc > 2 ? std::stoi(argv[2]) : 4097);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--test-bvh")
+        return VerifyBvh() ? 0 : 1;
+    //opens its own hidden window
+    if (argc > 1 && std::string(argv[1]) == "--bench-bvh")
+    {
+        BenchmarkBvh(argc > 2 ? std::stoi(argv[2]) : 1025);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--test-transforms")
+        return VerifyTransforms() ? 0 : 1;
+    if (argc > 1 && std::string(argv[1]) == "--bench-transforms")
+    {
+        BenchmarkTransforms(argc > 2 ? std::stoul(argv[2]) : 10000);
+        return 0;
+    }
+    //opens its own hidden window
+    if (argc > 1 && std::string(argv[1]) == "--test-resources")
+        return VerifyResources() ? 0 : 1;
+    //opens its own hidden window
+    if (argc > 1 && std::string(argv[1]) == "--test-materials")
+        return VerifyMaterials() ? 0 : 1;
+    if (argc > 1 && std::string(argv[1]) == "--bench-mesh-copies")
+    {
+        BenchmarkMeshCopies(argc > 2 && std::string(argv[2]) == "by-value");
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--test-obj")
+        return VerifyOBJFaces() ? 0 : 1;
+    if (argc > 1 && std::string(argv[1]) == "--bench-hgt")
+    {
+        BenchmarkHgtStreaming(argc > 2 ? std::stoi(argv[2]) : 1201);
+        return 0;
+    }
+
+    //not offline modes: the normal scene with trees, which are off by default until they have frame times on a real GPU
+    size_t treeCount = 0;
+    if (argc > 1 && std::string(argv[1]) == "--trees")
+        treeCount = argc > 2 ? std::stoul(argv[2]) : 20000;
+    if (argc > 1 && std::string(argv[1]) == "--tree-bench")
+        treeCount = argc > 2 ? std::stoul(argv[2]) : 50000;
+    //SRTM tiles instead of the Transilvania relief, optionally centred on a latitude and longitude
+    std::string hgtDirectory;
+    if (argc > 1 && std::string(argv[1]) == "--hgt")
+        hgtDirectory = argc > 2 ? argv[2] : "SRTM";
+
     GLFWwindow* window;
 
     /* Initialize the library */
@@ -233,9 +241,10 @@ int main(void)
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetScrollCallback(window, scroll_callback);
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
+    glState.setBlend(false);
+    glState.setDepthTest(true);
 
     pCamera = new Camera(width, height, glm::vec3(0.f, 0.f, 0.f));
     Shader shader;
@@ -243,156 +252,325 @@ int main(void)
     Shader AirportShader;
     shader.Set("Basic.shader");
     terrainShader.Set("terrain.shader");
-    int floorTexture = CreateTexture(std::filesystem::path("GOOGLE_SAT_WM.jpg").string().c_str());
+    Shader batchShader;
+    batchShader.Set("Batch.shader");
+    Shader treeShader;
+    treeShader.Set("Instanced.shader");
+
+    AssetLoader loader;
+    resources.queueMesh("Plane.obj", loader);
+    resources.queueMesh("Transilvania.obj", loader);
+    if (treeCount > 0)
+        resources.queueMesh("10459_White_Ash_Tree_v1_L3.obj", loader);
+    Scene aeroport;
+    aeroport.load("Aeroport.scene");
+    aeroport.queue(loader);
+
+    //the satellite map is large: draw with a placeholder until it has streamed in
+    TextureStreamer streamer;
+    unsigned int floorTexture = streamer.request("GOOGLE_SAT_WM.jpg");
     terrainShader.SetInt("texture1", 0);
 
-    Mesh Avion("Plane.obj");
+    Mesh Avion(resources.acquireMesh("Plane.obj", &loader));
     Avion.setPosition(glm::vec3(0.f));
-    Avion.setColor(0, glm::vec3(0.8f, 0.15f, 0.3f));
+    //by Plane.mtl's order: brushed steel, glass, deep garnet
+    Avion.setColor(0, glm::vec3(0.5f, 0.5f, 0.5f));
     Avion.setColor(1, glm::vec3(0.1f, 0.1f, 0.1f));
-    Avion.setColor(2, glm::vec3(0.5f, 0.5f, 0.5f));
+    Avion.setColor(2, glm::vec3(0.8f, 0.15f, 0.3f));
     Avion.setRotation(glm::vec3(0.f, 180.0f, 0.f));
     Avion.setPosition(glm::vec3(0.0f, 0.0f, 0.0f));
     Avion.initVAO();
 
-    Mesh Harta("Transilvania.obj");
+    Mesh Harta(resources.acquireMesh("Transilvania.obj", &loader));
     Harta.setScale(glm::vec3(0.1f, 0.1f, 0.1f));
     Harta.setPosition(glm::vec3(0.0f, -200.0f, -180.0f));
+    //the heightmap, the tree scatter and the BVH read its positions after upload
+    Harta.setResidency(MeshResidency::Positions);
     Harta.initVAO();
+    //the same relief as a heightmap, drawn through the LOD terrain when the grid is recognised
+    Heightmap relief = HeightmapFromMesh(Harta);
+    Terrain Teren(relief);
+    Teren.setModel(Harta.getModel());
+    Teren.initGPU();
+    std::unique_ptr<TerrainStreamer> srtm;
+    if (!hgtDirectory.empty())
+    {
+        srtm = std::make_unique<TerrainStreamer>(hgtDirectory);
+        if (argc > 4)
+        {
+            GeoOrigin origin;
+            origin.latitude = std::stod(argv[3]);
+            origin.longitude = std::stod(argv[4]);
+            srtm->setOrigin(origin);
+        }
+        //metres, placed like the OBJ relief
+        srtm->setModel(Harta.getModel());
+    }
 
-    AeroportInit();
+    //the bark and leaves image comes from the tree's .mtl (map_Kd)
+    std::shared_ptr<MeshGeometry> treeGeometry = std::make_shared<MeshGeometry>(OBJIndexedMesh());
+    if (treeCount > 0)
+    {
+        treeGeometry = resources.acquireMesh("10459_White_Ash_Tree_v1_L3.obj", &loader);
+        resources.acquireMaterialMaps(*treeGeometry, &loader);
+    }
+    InstancedMesh Copaci(treeGeometry);
+    Copaci.setScale(glm::vec3(1.f));
+    //the tree is modelled Z-up
+    glm::mat4 treeBase = glm::rotate(glm::mat4(1.f), glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f));
+    Copaci.setInstances(ScatterOnSurface(Harta, treeCount, 1234, treeBase, 0.08f, 0.15f, 0.8f));
+    Copaci.initVAO();
+    treeShader.Use();
+    treeShader.SetInt("texture1", 0);
+    std::cout << Copaci.getInstanceCount() << " trees scattered over the terrain\n";
+
+    size_t peakBeforeInit = PeakResidentBytes();
+    aeroport.init(loader);
+    loader.report();
+    std::cout << "Airport init: peak RSS " << peakBeforeInit / (1024 * 1024) << " MB before, " << PeakResidentBytes() / (1024 * 1024)
+        << " MB after; " << meshBytesCopied << " bytes of mesh data copied during start up\n";
+
+    RenderQueue aeroportQueue;
+    aeroport.submit(aeroportQueue, { { "basic", &shader }, { "terrain", &terrainShader } });
+    //nothing in the airport moves, one sort is enough
+    aeroportQueue.sort();
+    //same airport as one multi-draw, B switches between the two for comparison
+    StaticBatch aeroportBatch;
+    aeroportBatch.build(aeroport, &batchShader);
+    //what P reports
+    std::vector<std::pair<std::string, const Mesh*>> meshMemory = { { "Plane.obj", &Avion }, { "Transilvania.obj", &Harta },
+        { "10459_White_Ash_Tree_v1_L3.obj", &Copaci } };
+    for (size_t i = 0; i < aeroport.getObjects().size(); i++)
+        meshMemory.push_back({ aeroport.getObjects()[i].mesh, &aeroport.getMeshes()[i] });
+    {
+        size_t cpu = 0, gpu = 0;
+        SumMeshMemory(meshMemory, cpu, gpu);
+        std::cout << "Meshes: " << cpu / 1024 << " KB resident on the CPU, " << gpu / 1024 << " KB uploaded (P lists them)\n";
+        std::cout << "Resources: " << resources.getLoads() << " files loaded, " << resources.getPathHits() << " acquires shared by path, "
+            << resources.getContentHits() << " by content\n";
+    }
 
-    float deltaTime = 0.f;
-    float lastFrame = 0.f;
-    float deltaAltitude = 0.f;
-    bool desprindere = true;
+    double deltaTime = 0.0;
+    double lastFrame = glfwGetTime();
+    //the aircraft moves at 120 steps a second whatever the frame rate
+    FlightModel flight;
+    FlightState start;
+    start.position = Avion.getPosition();
+    start.rotation = Avion.getRotation();
+    flight.reset(start);
+    //what the aircraft rolls on and can fly into: the relief (or the SRTM tiles) with the
+    //airport's grass and roads levelled at y = 0 over it
+    TerrainQuery ground = srtm ? TerrainQuery() : TerrainQuery(relief, Harta.getModel());
+    //the airport's objects then the relief, by BVH owner; the aircraft may touch the ground ones
+    std::vector<std::string> worldNames;
+    std::vector<bool> groundSurface;
+    for (size_t i = 0; i < aeroport.getObjects().size(); i++)
+    {
+        const std::string& mesh = aeroport.getObjects()[i].mesh;
+        worldNames.push_back(mesh);
+        groundSurface.push_back(mesh == "AA/Iarba.obj" || mesh == "AA/Road.obj" || mesh == "AA/Fundatie.obj");
+        if (groundSurface.back())
+            ground.addFlatArea(aeroport.getMeshes()[i].getWorldBounds(), 0.f);
+    }
+    worldNames.push_back("Transilvania.obj");
+    groundSurface.push_back(true);
+    //every static triangle, for picking and the camera's and taxiing collisions
+    Bvh world;
+    {
+        double buildStart = glfwGetTime();
+        for (size_t i = 0; i < aeroport.getMeshes().size(); i++)
+            world.addMesh(aeroport.getMeshes()[i], (uint32_t)i);
+        world.addMesh(Harta, (uint32_t)aeroport.getMeshes().size());
+        ThreadPool pool;
+        world.build(&pool);
+        std::cout << "BVH: " << world.getTriangleCount() << " triangles, " << world.getNodeCount() << " nodes, depth " << world.getDepth()
+            << ", built in " << (glfwGetTime() - buildStart) * 1000.0 << " ms\n";
+    }
+    std::vector<uint32_t> touching;
+    auto groundAt = [&ground, &srtm](float x, float z) {
+        GroundSample below;
+        if (!ground.sample(x, z, below) && srtm)
+            srtm->sample(x, z, below);
+        return below;
+    };
 
-    float position;
     shader.Use();
     shader.SetVec3("lightColor", glm::vec3(0.6f, 0.6f, 0.6f));
     terrainShader.Use();
     terrainShader.SetVec3("lightColor", glm::vec3(0.6f, 0.6f, 0.6f));
+    batchShader.Use();
+    batchShader.SetVec3("lightColor", glm::vec3(0.6f, 0.6f, 0.6f));
+    treeShader.Use();
+    treeShader.SetVec3("lightColor", glm::vec3(0.6f, 0.6f, 0.6f));
     //gluPerspective(90, (float)width/(float)height, 1, 100);
 
+    double statsStart = glfwGetTime();
+    double statsAeroport = 0.0;
+    size_t statsTransforms = sceneTransforms.getRecomputeCount();
+    unsigned int statsFrames = 0, statsCalls = 0, statsDraws = 0, statsLookups = 0, statsIssued = 0, statsFiltered = 0, statsVisible = 0, statsCulled = 0;
+
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(window))
     {
         double FrameStart = glfwGetTime();
-        float currentAltitude = Avion.getPosition().y;
-        deltaAltitude = (pCamera->speed - 0.5f) * 2.f;
-        float currentTilt = Avion.getRotation().y;
-        changeHour(shader, terrainShader);
+        glStats.reset();
+        streamer.update();
+        changeHour({ &shader, &terrainShader, &batchShader, &treeShader });
 
         float clearR = 0.07f + skylight / 2.f - 0.1f;
         float clearG = 0.13f + skylight / 2.f - 0.1f;
         float clearB = 0.17 + skylight / 2.f - 0.1f;
         glClearColor(clearR, clearG, clearB, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        if (Avion.getPosition().y < 0.0f)
-        {
-            Avion.setPosition(glm::vec3(Avion.getPosition().x, 0.0f, Avion.getPosition().z));
-        }
-
-        if (Avion.getPosition().y > 0.0f)
-        {
-            if (desprindere)
-            {
-                turnspeed = 0.0f;
-            }
-            desprindere = false;
-        }
-        else
-        {
-            desprindere = true;
-        }
+        glStats.calls += 2;
 
-        if (UpPressed == true)
+        deltaTime = FrameStart - lastFrame;
+        lastFrame = FrameStart;
+        FlightControls controls = processInput(window, pCamera, deltaTime, &Avion);
+        flight.advance(deltaTime, [&controls](double) { return controls; }, groundAt);
+        if (flight.getState().crashed)
         {
-            if (pCamera->speed < 1.f)
-            {
-                pCamera->speed += 0.0008f;
-            }
+            glm::vec3 wreck = flight.getState().position;
+            std::cout << "Crashed at " << wreck.x << ", " << wreck.y << ", " << wreck.z << ", back to the runway\n";
+            flight.reset(start);
         }
-        else
-            if (DownPressed == true)
-            {
-                if (pCamera->speed > 0.f)
-                {
-                    pCamera->speed -= 0.001;
-                }
-            }
-            else
-            {
-                if (pCamera->speed > 0.f)
-                {
-                    pCamera->speed -= 0.0003f;
-                }
-            }
-
-        if (pCamera->speed > 0.5f)
+        FlightState shown = flight.interpolated();
+        Avion.setPosition(shown.position);
+        Avion.setRotation(shown.rotation);
+        //one pass over whatever moved this frame, the draws below only read the cached matrices
+        sceneTransforms.update();
+        //rolling into a hangar, a tower or a parked aircraft ends the run like a crash
+        if (flight.getState().grounded)
         {
-            float ascending = (pCamera->speed - 0.5f);
-            Avion.setPosition(glm::vec3(Avion.getPosition() + glm::vec3(0.0f, (pCamera->speed - 0.5f) * 5.f, 0.0f)));
-        }
-        else
-            if (pCamera->speed < 0.5f)
+            touching.clear();
+            world.overlap(Avion.getWorldBounds(), touching);
+            for (uint32_t triangle : touching)
             {
-                if (Avion.getPosition().y > 0.0f)
+                uint32_t owner = world.getOwner(triangle);
+                if (!groundSurface[owner])
                 {
-                    float descending = pCamera->speed - 0.5f;
-                    Avion.setPosition(glm::vec3(Avion.getPosition() + glm::vec3(0.0f, descending * 50.f, 0.0f)));
+                    std::cout << "Taxied into " << worldNames[owner] << ", back to the runway\n";
+                    flight.reset(start);
+                    break;
                 }
             }
-
-        float Xrot = 0.0f;
-        float Zrot = 0.0f;
-        float Xstrife = 0.f;
-        float Zstrife = 0.f;
-        if (Avion.getPosition().y > 0.f)
-        {
-            Xstrife = tiltspeed * 200.f * glm::sin(glm::radians(Avion.getRotation().y));
-            Zstrife = tiltspeed * 200.f * glm::cos(glm::radians(Avion.getRotation().y));
-            if (pCamera->speed > 0.5f)
-            {
-                Xrot = deltaAltitude * 25.f * glm::cos(glm::radians(Avion.getRotation().y));
-                Zrot = deltaAltitude * 25.f * -glm::sin(glm::radians(Avion.getRotation().y));
-            }
-            else
-            {
-                Xrot = deltaAltitude * 45.f * glm::cos(glm::radians(Avion.getRotation().y));
-                Zrot = deltaAltitude * 45.f * -glm::sin(glm::radians(Avion.getRotation().y));
-            }
         }
-
-        float angle = glm::abs(Xrot) + glm::abs(Zrot);
-        if (Avion.getRotation().y > 0.f)
-            angle *= 2;
-        else
-            angle /= 4.f;
-        float momentum = glm::abs(glm::cos(glm::radians(angle)));
-        Avion.setPosition(glm::vec3(Avion.getPosition() + glm::vec3(pCamera->speed * momentum * 15.f * glm::sin(glm::radians(Avion.getRotation().y)), 0.0f, pCamera->speed * momentum * 15.f * glm::cos(glm::radians(Avion.getRotation().y)))));
-        Avion.setRotation(glm::vec3(0.f, Avion.getRotation().y, 0.f) - glm::vec3(Xrot + Xstrife, 0.0f, Zrot + Zstrife));
-        
-        processInput(window, pCamera, deltaTime, &Avion);
         pCamera->SetPosition(glm::vec3(Avion.getPosition() + glm::vec3(-sin(glm::radians(Avion.getRotation().y + pCamera->offset)) * 50.f, 15.0f, -cos(glm::radians(Avion.getRotation().y + pCamera->offset)) * 50.f)));
         pCamera->SetPosition(pCamera->GetPosition() + glm::vec3(0.0f, glm::radians((pCamera->frontTilt - 13.f)/1.5f) * 50.f, 0.0f));
+        //the chase camera stays on the aircraft's side of whatever is in between
+        glm::vec3 lookFrom = Avion.getPosition() + glm::vec3(0.f, 5.f, 0.f);
+        BvhHit blocked;
+        if (world.segment(lookFrom, pCamera->GetPosition(), blocked))
+            pCamera->SetPosition(lookFrom + glm::normalize(pCamera->GetPosition() - lookFrom) * std::max(blocked.distance - 1.f, 0.f));
         pCamera->pitch =  -pCamera->frontTilt;
         pCamera->yaw = -((float)Avion.getRotation().y + (float)pCamera->offset - 90.f);
 
         /* Render here */
-        terrainShader.Use();
         pCamera->UpdateCameraVectors();
-        pCamera->use(&terrainShader);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        Harta.render(&terrainShader);
-        shader.Use();
-        pCamera->use(&shader);
-        Avion.render(&shader);
-        AeroportRender(terrainShader, shader);
+        glm::mat4 viewProjection = pCamera->GetProjectionMatrix() * pCamera->GetViewMatrix();
+        Frustum frustum(viewProjection);
+        //every shader gets this frame's camera up front: the render queue and the
+        //fallbacks below may use one whose own draw was culled
+        for (Shader* frameShader : { &terrainShader, &shader, &batchShader, &treeShader })
+        {
+            frameShader->Use();
+            pCamera->use(frameShader);
+        }
+        if (MemoryDumpRequested)
+        {
+            MemoryDumpRequested = false;
+            PrintMeshMemory(meshMemory);
+            resources.report();
+        }
+        if (PickRequested)
+        {
+            PickRequested = false;
+            //the cursor's line from the near plane to the far one
+            glm::mat4 unproject = glm::inverse(viewProjection);
+            float ndcX = (float)(2.0 * PickX / pCamera->GetWidth() - 1.0), ndcY = (float)(1.0 - 2.0 * PickY / pCamera->GetHeight());
+            glm::vec4 nearPoint = unproject * glm::vec4(ndcX, ndcY, -1.f, 1.f), farPoint = unproject * glm::vec4(ndcX, ndcY, 1.f, 1.f);
+            glm::vec3 from = glm::vec3(nearPoint) / nearPoint.w, to = glm::vec3(farPoint) / farPoint.w;
+            BvhHit picked;
+            if (world.raycast(from, glm::normalize(to - from), glm::length(to - from), picked))
+                std::cout << "Picked " << worldNames[picked.owner] << " at " << picked.distance << " (" << picked.position.x << ", "
+                    << picked.position.y << ", " << picked.position.z << ")\n";
+            else
+                std::cout << "Nothing under the cursor\n";
+        }
+        if (srtm)
+        {
+            srtm->update(Avion.getPosition());
+            terrainShader.Use();
+            glState.bindTexture2D(floorTexture);
+            srtm->draw(&terrainShader, pCamera->GetPosition(), frustum, (float)pCamera->GetHeight(), glm::radians(pCamera->GetFoVy()));
+        }
+        else if (Teren.getLevels() > 0)
+        {
+            Teren.update(pCamera->GetPosition(), frustum, (float)pCamera->GetHeight(), glm::radians(pCamera->GetFoVy()));
+            terrainShader.Use();
+            glState.bindTexture2D(floorTexture);
+            Teren.draw(&terrainShader);
+        }
+        else if (Harta.isVisible(frustum))
+        {
+            terrainShader.Use();
+            glState.bindTexture2D(floorTexture);
+            Harta.render(&terrainShader);
+        }
+        if (Avion.isVisible(frustum))
+        {
+            shader.Use();
+            Avion.render(&shader);
+        }
+        double aeroportStart = glfwGetTime();
+        if (UseStaticBatch)
+        {
+            batchShader.Use();
+            aeroportBatch.draw(&frustum);
+        }
+        else
+            aeroportQueue.draw(&frustum);
+        statsAeroport += glfwGetTime() - aeroportStart;
+        Copaci.cull(viewProjection);
+        treeShader.Use();
+        Copaci.render(&treeShader);
 
         /* Swap front and back buffers */
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        statsFrames++;
+        statsCalls += glStats.calls;
+        statsLookups += glStats.uniformLookups;
+        statsDraws += glStats.draws;
+        statsIssued += glStats.stateIssued;
+        statsFiltered += glStats.stateFiltered;
+        statsVisible += glStats.visible;
+        statsCulled += glStats.culled;
+        if (FrameStart - statsStart > 5.0)
+        {
+            std::ostringstream out;
+            out << "GL calls/frame: " << statsCalls / statsFrames << ", draw calls/frame: " << statsDraws / statsFrames << ", uniform lookups by name/frame: " << statsLookups / statsFrames
+                << ", state changes issued/filtered per frame: " << statsIssued / statsFrames << '/' << statsFiltered / statsFrames << '\n';
+            out << "  frame " << std::setprecision(3) << (FrameStart - statsStart) * 1000.0 / statsFrames << " ms, "
+                << Copaci.getInstanceCount() << " trees in one instanced draw\n";
+            out << "  transforms: " << (sceneTransforms.getRecomputeCount() - statsTransforms) / statsFrames << " of "
+                << sceneTransforms.getNodeCount() << " rebuilt per frame\n";
+            statsTransforms = sceneTransforms.getRecomputeCount();
+            out << "  frustum culling: " << statsVisible / statsFrames << " visible, " << statsCulled / statsFrames
+                << " culled per frame (objects, batch commands and trees)\n";
+            out << "  terrain: " << Teren.getDrawnChunks() << " chunks, " << Teren.getDrawnTriangles() << " triangles (at most "
+                << Teren.getMaxTriangles() << "), " << Teren.getResidentChunks() << " resident\n";
+            if (srtm)
+                out << "  SRTM: " << srtm->getLoadedTiles() << " tiles, " << srtm->getResidentBytes() / (1024 * 1024) << " MB, "
+                    << srtm->getDrawnTriangles() << " triangles, " << srtm->getLoads() << " page-ins, " << srtm->getEvictions() << " evictions\n";
+            statsStart = FrameStart;
+            out << "  airport (" << (UseStaticBatch ? "static batch" : "render queue") << "): "
+                << statsAeroport * 1000.0 / statsFrames << " ms/frame CPU\n";
+            std::cout << out.str();
+            statsAeroport = 0.0;
+            statsFrames = statsCalls = statsDraws = statsLookups = statsIssued = statsFiltered = statsVisible = statsCulled = 0;
+        }
     }
 
     shader.Delete();
@@ -0,0 +1,188 @@
+#include "Frustum.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <xmmintrin.h>
+
+AABB ComputeAABB(const std::vector<Vertex>& vertices)
+{
+    AABB box;
+    if (vertices.empty())
+        return box;
+    box.min = box.max = vertices[0].position;
+    for (const Vertex& vertex : vertices)
+    {
+        box.min = glm::min(box.min, vertex.position);
+        box.max = glm::max(box.max, vertex.position);
+    }
+    return box;
+}
+
+BoundingSphere ComputeBoundingSphere(const std::vector<Vertex>& vertices, const AABB& box)
+{
+    BoundingSphere sphere;
+    sphere.center = (box.min + box.max) * 0.5f;
+    float radius2 = 0.f;
+    for (const Vertex& vertex : vertices)
+    {
+        glm::vec3 offset = vertex.position - sphere.center;
+        radius2 = std::max(radius2, glm::dot(offset, offset));
+    }
+    sphere.radius = std::sqrt(radius2);
+    return sphere;
+}
+
+AABB TransformAABB(const AABB& box, const glm::mat4& model)
+{
+    AABB result;
+    for (int row = 0; row < 3; row++)
+    {
+        result.min[row] = result.max[row] = model[3][row];
+        for (int column = 0; column < 3; column++)
+        {
+            float a = model[column][row] * box.min[column];
+            float b = model[column][row] * box.max[column];
+            result.min[row] += std::min(a, b);
+            result.max[row] += std::max(a, b);
+        }
+    }
+    return result;
+}
+
+BoundingSphere TransformSphere(const BoundingSphere& sphere, const glm::mat4& model)
+{
+    BoundingSphere result;
+    result.center = glm::vec3(model * glm::vec4(sphere.center, 1.f));
+    float scale2 = 0.f;
+    for (int column = 0; column < 3; column++)
+    {
+        glm::vec3 axis = glm::vec3(model[column]);
+        scale2 = std::max(scale2, glm::dot(axis, axis));
+    }
+    result.radius = sphere.radius * std::sqrt(scale2);
+    return result;
+}
+
+Frustum::Frustum()
+{
+    //accepts everything until built from a matrix
+    for (int i = 0; i < 8; i++)
+    {
+        nx[i] = ny[i] = nz[i] = 0.f;
+        d[i] = FLT_MAX;
+    }
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+    : Frustum()
+{
+    //Gribb/Hartmann: row 3 plus or minus rows 0..2
+    const glm::mat4& m = viewProjection;
+    for (int i = 0; i < 6; i++)
+    {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.f : -1.f;
+        float a = m[0][3] + sign * m[0][row];
+        float b = m[1][3] + sign * m[1][row];
+        float c = m[2][3] + sign * m[2][row];
+        float w = m[3][3] + sign * m[3][row];
+        float length = std::sqrt(a * a + b * b + c * c);
+        nx[i] = a / length;
+        ny[i] = b / length;
+        nz[i] = c / length;
+        d[i] = w / length;
+    }
+}
+
+bool Frustum::intersectsScalar(const BoundingSphere& sphere) const
+{
+    for (int i = 0; i < 8; i++)
+    {
+        if (nx[i] * sphere.center.x + ny[i] * sphere.center.y + nz[i] * sphere.center.z + d[i] < -sphere.radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersectsScalar(const AABB& box) const
+{
+    //corner farthest along each plane normal
+    for (int i = 0; i < 8; i++)
+    {
+        float x = nx[i] >= 0.f ? box.max.x : box.min.x;
+        float y = ny[i] >= 0.f ? box.max.y : box.min.y;
+        float z = nz[i] >= 0.f ? box.max.z : box.min.z;
+        if (nx[i] * x + ny[i] * y + nz[i] * z + d[i] < 0.f)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const
+{
+    __m128 x = _mm_set1_ps(sphere.center.x);
+    __m128 y = _mm_set1_ps(sphere.center.y);
+    __m128 z = _mm_set1_ps(sphere.center.z);
+    __m128 radius = _mm_set1_ps(-sphere.radius);
+    for (int i = 0; i < 8; i += 4)
+    {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(nx + i), x), _mm_mul_ps(_mm_load_ps(ny + i), y)),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(nz + i), z), _mm_load_ps(d + i)));
+        if (_mm_movemask_ps(_mm_cmplt_ps(distance, radius)) != 0)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const AABB& box) const
+{
+    //n . pvertex = sum of max(n * min, n * max) per axis, no per-plane branches
+    __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+    __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+    __m128 minZ = _mm_set1_ps(box.min.z), maxZ = _mm_set1_ps(box.max.z);
+    __m128 zero = _mm_setzero_ps();
+    for (int i = 0; i < 8; i += 4)
+    {
+        __m128 a = _mm_load_ps(nx + i), b = _mm_load_ps(ny + i), c = _mm_load_ps(nz + i);
+        __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_max_ps(_mm_mul_ps(a, minX), _mm_mul_ps(a, maxX)), _mm_max_ps(_mm_mul_ps(b, minY), _mm_mul_ps(b, maxY))),
+            _mm_add_ps(_mm_max_ps(_mm_mul_ps(c, minZ), _mm_mul_ps(c, maxZ)), _mm_load_ps(d + i)));
+        if (_mm_movemask_ps(_mm_cmplt_ps(distance, zero)) != 0)
+            return false;
+    }
+    return true;
+}
+
+size_t Frustum::cullSpheres(const float* x, const float* y, const float* z, const float* radius, size_t count, uint8_t* visible) const
+{
+    //4 spheres per step against one plane at a time
+    size_t nrVisible = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i);
+        __m128 limit = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nx[p]), cx), _mm_mul_ps(_mm_set1_ps(ny[p]), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(nz[p]), cz), _mm_set1_ps(d[p])));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, limit));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+            nrVisible += visible[i + lane];
+        }
+    }
+    for (; i < count; i++)
+    {
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(x[i], y[i], z[i]);
+        sphere.radius = radius[i];
+        visible[i] = intersects(sphere) ? 1 : 0;
+        nrVisible += visible[i];
+    }
+    return nrVisible;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "Vertex.h"
+
+struct AABB
+{
+	glm::vec3 min = glm::vec3(0.f);
+	glm::vec3 max = glm::vec3(0.f);
+};
+
+struct BoundingSphere
+{
+	glm::vec3 center = glm::vec3(0.f);
+	float radius = 0.f;
+};
+
+AABB ComputeAABB(const std::vector<Vertex>& vertices);
+//centered on the box, radius to the farthest vertex: tighter than the box's half diagonal
+BoundingSphere ComputeBoundingSphere(const std::vector<Vertex>& vertices, const AABB& box);
+//box around the transformed box (Arvo), still axis aligned
+AABB TransformAABB(const AABB& box, const glm::mat4& model);
+//radius grows with the largest axis scale of model
+BoundingSphere TransformSphere(const BoundingSphere& sphere, const glm::mat4& model);
+
+//The 6 planes of projection * view, normals pointing inwards. Stored as 8 planes in
+//structure-of-arrays form (two always-passing pads) so SSE tests 4 planes at once.
+class Frustum
+{
+private:
+	alignas(16) float nx[8];
+	alignas(16) float ny[8];
+	alignas(16) float nz[8];
+	alignas(16) float d[8];
+
+public:
+	Frustum();
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	bool intersects(const BoundingSphere& sphere) const;
+	bool intersects(const AABB& box) const;
+	//plain loops over the same planes, the reference the SSE paths are checked against
+	bool intersectsScalar(const BoundingSphere& sphere) const;
+	bool intersectsScalar(const AABB& box) const;
+	//visible[i] = 1 when sphere i touches the frustum; returns the number visible
+	size_t cullSpheres(const float* x, const float* y, const float* z, const float* radius, size_t count, uint8_t* visible) const;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <utility>
+#include <GL/glew.h>
+#include "GLState.h"
+
+//Owns one GL buffer name: deleted with the owner through glState, moved with it, never copied.
+class GLBuffer
+{
+private:
+	GLuint name = 0;
+
+public:
+	GLBuffer() = default;
+	~GLBuffer() { reset(); }
+	GLBuffer(GLBuffer&& other) noexcept : name(std::exchange(other.name, 0)) {}
+	GLBuffer& operator=(GLBuffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			name = std::exchange(other.name, 0);
+		}
+		return *this;
+	}
+	GLBuffer(const GLBuffer&) = delete;
+	GLBuffer& operator=(const GLBuffer&) = delete;
+
+	//a fresh name, the old one (if any) is deleted
+	GLuint create()
+	{
+		reset();
+		glGenBuffers(1, &name);
+		return name;
+	}
+	void reset()
+	{
+		if (name != 0)
+			glState.deleteBuffer(name);
+		name = 0;
+	}
+	GLuint get() const { return name; }
+};
+
+//Owns one vertex array name, deleted through glState so its binding shadow stays right.
+class GLVertexArray
+{
+private:
+	GLuint name = 0;
+
+public:
+	GLVertexArray() = default;
+	~GLVertexArray() { reset(); }
+	GLVertexArray(GLVertexArray&& other) noexcept : name(std::exchange(other.name, 0)) {}
+	GLVertexArray& operator=(GLVertexArray&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			name = std::exchange(other.name, 0);
+		}
+		return *this;
+	}
+	GLVertexArray(const GLVertexArray&) = delete;
+	GLVertexArray& operator=(const GLVertexArray&) = delete;
+
+	GLuint create()
+	{
+		reset();
+		glCreateVertexArrays(1, &name);
+		return name;
+	}
+	void reset()
+	{
+		if (name != 0)
+			glState.deleteVertexArray(name);
+		name = 0;
+	}
+	GLuint get() const { return name; }
+};
@@ -0,0 +1,139 @@
+#include "GLState.h"
+#include "GLStats.h"
+
+GLState glState;
+
+GLState::GLState()
+{
+    invalidate();
+}
+
+void GLState::invalidate()
+{
+    program = vertexArray = activeUnit = UNKNOWN;
+    for (GLuint& texture : textures)
+        texture = UNKNOWN;
+    for (GLuint& buffer : uniformBuffers)
+        buffer = UNKNOWN;
+    depthTest = blend = -1;
+}
+
+bool GLState::changed(GLuint& current, GLuint value)
+{
+    if (current == value)
+    {
+        glStats.stateFiltered++;
+        return false;
+    }
+    current = value;
+    glStats.stateIssued++;
+    glStats.calls++;
+    return true;
+}
+
+void GLState::setCapability(int& current, GLenum capability, bool enabled)
+{
+    if (current == (int)enabled)
+    {
+        glStats.stateFiltered++;
+        return;
+    }
+    current = enabled;
+    glStats.stateIssued++;
+    glStats.calls++;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLState::useProgram(GLuint program)
+{
+    if (changed(this->program, program))
+        glUseProgram(program);
+}
+
+void GLState::bindVertexArray(GLuint vertexArray)
+{
+    if (changed(this->vertexArray, vertexArray))
+        glBindVertexArray(vertexArray);
+}
+
+void GLState::bindTexture2D(GLuint texture, GLuint unit)
+{
+    if (unit >= MAX_TEXTURE_UNITS)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        activeUnit = unit;
+        glStats.stateIssued += 2;
+        glStats.calls += 2;
+        return;
+    }
+    //active even when the bind itself is dropped: callers upload to the texture next
+    if (changed(activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+    if (changed(textures[unit], texture))
+        glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLState::bindUniformBuffer(GLuint index, GLuint buffer)
+{
+    if (index >= MAX_UNIFORM_BUFFERS)
+    {
+        glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+        glStats.stateIssued++;
+        glStats.calls++;
+        return;
+    }
+    if (changed(uniformBuffers[index], buffer))
+        glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+}
+
+void GLState::setDepthTest(bool enabled)
+{
+    setCapability(depthTest, GL_DEPTH_TEST, enabled);
+}
+
+void GLState::setBlend(bool enabled)
+{
+    setCapability(blend, GL_BLEND, enabled);
+}
+
+void GLState::deleteProgram(GLuint program)
+{
+    glDeleteProgram(program);
+    //the name can come back from glCreateProgram
+    if (this->program == program)
+        this->program = UNKNOWN;
+}
+
+void GLState::deleteVertexArray(GLuint vertexArray)
+{
+    glDeleteVertexArrays(1, &vertexArray);
+    //deleting the bound VAO reverts the binding to 0
+    if (this->vertexArray == vertexArray)
+        this->vertexArray = 0;
+}
+
+void GLState::deleteBuffer(GLuint buffer)
+{
+    glDeleteBuffers(1, &buffer);
+    //uniform block bindings of it revert to 0, the name can come back from glGenBuffers
+    for (GLuint& bound : uniformBuffers)
+    {
+        if (bound == buffer)
+            bound = 0;
+    }
+}
+
+void GLState::deleteTexture(GLuint texture)
+{
+    glDeleteTextures(1, &texture);
+    //units it was bound to revert to 0 as well
+    for (GLuint& bound : textures)
+    {
+        if (bound == texture)
+            bound = 0;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <GL/glew.h>
+
+//Shadows the GL bindings and switches the render path touches; a change to the
+//value GL already has is dropped. Everything that binds programs, VAOs, 2D
+//textures or material blocks goes through here, or the shadow goes stale.
+class GLState
+{
+private:
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+	static const int MAX_TEXTURE_UNITS = 16;
+	static const int MAX_UNIFORM_BUFFERS = 16;
+
+	GLuint program = UNKNOWN;
+	GLuint vertexArray = UNKNOWN;
+	GLuint activeUnit = UNKNOWN;
+	GLuint textures[MAX_TEXTURE_UNITS];
+	GLuint uniformBuffers[MAX_UNIFORM_BUFFERS];
+	int depthTest = -1;
+	int blend = -1;
+
+	bool changed(GLuint& current, GLuint value);
+	void setCapability(int& current, GLenum capability, bool enabled);
+
+public:
+	GLState();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vertexArray);
+	//leaves unit the active unit, so glTexImage2D and friends after it reach texture
+	void bindTexture2D(GLuint texture, GLuint unit = 0);
+	void bindUniformBuffer(GLuint index, GLuint buffer);
+	void setDepthTest(bool enabled);
+	void setBlend(bool enabled);
+
+	void deleteProgram(GLuint program);
+	void deleteVertexArray(GLuint vertexArray);
+	void deleteBuffer(GLuint buffer);
+	void deleteTexture(GLuint texture);
+	//after GL state was changed behind the cache's back
+	void invalidate();
+};
+
+extern GLState glState;
@@ -0,0 +1,20 @@
+#pragma once
+
+//GL calls issued on the render path, reset once per frame by the render loop
+struct GLStats
+{
+	unsigned int calls = 0;
+	unsigned int draws = 0;
+	//Set* by name: a hash map hit now, a glGetUniformLocation round trip before
+	unsigned int uniformLookups = 0;
+	//binds and enables through GLState: sent to GL vs dropped as redundant
+	unsigned int stateIssued = 0;
+	unsigned int stateFiltered = 0;
+	//objects, batch commands and instances tested against the view frustum
+	unsigned int visible = 0;
+	unsigned int culled = 0;
+
+	void reset() { *this = GLStats(); }
+};
+
+inline GLStats glStats;
@@ -0,0 +1,139 @@
+#include "Heightmap.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+
+Heightmap HeightmapFromMesh(const Mesh& mesh)
+{
+    Heightmap heightmap;
+    const std::vector<glm::vec3>& positions = mesh.getPositions();
+    //vertices repeat once per uv/normal seam, only the positions count
+    std::set<std::pair<float, float>> corners;
+    glm::vec3 min(1e30f), max(-1e30f);
+    for (const glm::vec3& position : positions)
+    {
+        corners.insert({ position.x, position.z });
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+    int size = (int)std::lround(std::sqrt((double)corners.size()));
+    if (size < 2 || (size_t)size * size != corners.size())
+    {
+        std::cout << "Heightmap: " << corners.size() << " distinct positions don't form a square grid\n";
+        return heightmap;
+    }
+
+    heightmap.width = heightmap.height = size;
+    heightmap.origin = glm::vec3(min.x, 0.f, min.z);
+    heightmap.spacingX = (max.x - min.x) / (size - 1);
+    heightmap.spacingZ = (max.z - min.z) / (size - 1);
+    heightmap.heightScale = std::max(std::abs(min.y), std::abs(max.y)) / 32767.f;
+    if (heightmap.heightScale <= 0.f)
+        heightmap.heightScale = 1.f;
+    heightmap.samples.assign((size_t)size * size, 0);
+    for (const glm::vec3& position : positions)
+    {
+        //exported grids are slightly jittered, round to the nearest cell
+        int x = std::clamp((int)std::lround((position.x - min.x) / heightmap.spacingX), 0, size - 1);
+        int z = std::clamp((int)std::lround((position.z - min.z) / heightmap.spacingZ), 0, size - 1);
+        heightmap.samples[(size_t)z * size + x] = (int16_t)std::lround(position.y / heightmap.heightScale);
+    }
+    return heightmap;
+}
+
+Heightmap GenerateHeightmap(int size, unsigned int seed, float spacing, float amplitude)
+{
+    //diamond-square needs 2^n + 1 samples, the rest is cropped
+    int grid = 2;
+    while (grid + 1 < size)
+        grid *= 2;
+    int stride = grid + 1;
+
+    Heightmap heightmap;
+    heightmap.width = heightmap.height = size;
+    heightmap.spacingX = heightmap.spacingZ = spacing;
+    heightmap.heightScale = 1.f;
+    std::vector<int16_t> full((size_t)stride * stride, 0);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> offset(-1.f, 1.f);
+    auto get = [&](int x, int z) { return (int)full[(size_t)z * stride + x]; };
+    auto set = [&](int x, int z, float value) {
+        full[(size_t)z * stride + x] = (int16_t)std::clamp((int)std::lround(value), -32767, 32767);
+    };
+
+    float roughness = amplitude;
+    for (int step = grid; step > 1; step /= 2, roughness *= 0.55f)
+    {
+        int half = step / 2;
+        for (int z = half; z < stride; z += step)
+        {
+            for (int x = half; x < stride; x += step)
+            {
+                float average = (get(x - half, z - half) + get(x + half, z - half) + get(x - half, z + half) + get(x + half, z + half)) * 0.25f;
+                set(x, z, average + offset(random) * roughness);
+            }
+        }
+        for (int z = 0; z < stride; z += half)
+        {
+            for (int x = (z / half % 2 == 0) ? half : 0; x < stride; x += step)
+            {
+                int sum = 0, count = 0;
+                if (x >= half) { sum += get(x - half, z); count++; }
+                if (x + half < stride) { sum += get(x + half, z); count++; }
+                if (z >= half) { sum += get(x, z - half); count++; }
+                if (z + half < stride) { sum += get(x, z + half); count++; }
+                set(x, z, (float)sum / count + offset(random) * roughness);
+            }
+        }
+    }
+
+    if (size == stride)
+    {
+        heightmap.samples = std::move(full);
+        return heightmap;
+    }
+    heightmap.samples.resize((size_t)size * size);
+    for (int z = 0; z < size; z++)
+        std::copy_n(full.begin() + (size_t)z * stride, size, heightmap.samples.begin() + (size_t)z * size);
+    return heightmap;
+}
+
+bool SampleHeightmap(const Heightmap& heightmap, float x, float z, float& height, glm::vec3& normal)
+{
+    if (heightmap.width < 2 || heightmap.height < 2)
+    {
+        height = heightmap.origin.y;
+        normal = glm::vec3(0.f, 1.f, 0.f);
+        return false;
+    }
+    float gridX = (x - heightmap.origin.x) / heightmap.spacingX;
+    float gridZ = (z - heightmap.origin.z) / heightmap.spacingZ;
+    float lastX = (float)(heightmap.width - 1), lastZ = (float)(heightmap.height - 1);
+    bool inside = gridX >= 0.f && gridZ >= 0.f && gridX <= lastX && gridZ <= lastZ;
+    gridX = std::clamp(gridX, 0.f, lastX);
+    gridZ = std::clamp(gridZ, 0.f, lastZ);
+    //the far border belongs to the last cell
+    int cellX = std::min((int)gridX, heightmap.width - 2);
+    int cellZ = std::min((int)gridZ, heightmap.height - 2);
+    float fx = gridX - cellX, fz = gridZ - cellZ;
+
+    const int16_t* cell = &heightmap.samples[(size_t)cellZ * heightmap.width + cellX];
+    float h00 = cell[0], h10 = cell[1], h01 = cell[heightmap.width], h11 = cell[heightmap.width + 1];
+    //samples per cell along x and z on the triangle the point is in
+    float dx, dz;
+    if (fx >= fz)
+    {
+        dx = h10 - h00;
+        dz = h11 - h10;
+    }
+    else
+    {
+        dx = h11 - h01;
+        dz = h01 - h00;
+    }
+    height = heightmap.origin.y + (h00 + fx * dx + fz * dz) * heightmap.heightScale;
+    normal = glm::normalize(glm::vec3(-dx * heightmap.heightScale / heightmap.spacingX, 1.f, -dz * heightmap.heightScale / heightmap.spacingZ));
+    return inside;
+}
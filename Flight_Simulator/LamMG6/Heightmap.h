@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+class Mesh;
+
+//Regular grid of int16 height samples, row z by column x. Sample (x, z) sits at
+//origin + (x * spacingX, samples * heightScale, z * spacingZ) in terrain space.
+struct Heightmap
+{
+	int width = 0;
+	int height = 0;
+	std::vector<int16_t> samples;
+	glm::vec3 origin = glm::vec3(0.f);
+	float spacingX = 1.f;
+	float spacingZ = 1.f;
+	float heightScale = 1.f;
+
+	bool empty() const { return samples.empty(); }
+	//clamped to the border
+	float at(int x, int z) const
+	{
+		x = x < 0 ? 0 : (x >= width ? width - 1 : x);
+		z = z < 0 ? 0 : (z >= height ? height - 1 : z);
+		return origin.y + samples[(size_t)z * width + x] * heightScale;
+	}
+	glm::vec3 position(int x, int z) const
+	{
+		return glm::vec3(origin.x + x * spacingX, at(x, z), origin.z + z * spacingZ);
+	}
+};
+
+//the vertices of a regular n x n grid mesh (Transilvania.obj) put back into a grid,
+//in the mesh's model space; empty when the vertices don't form a square grid
+Heightmap HeightmapFromMesh(const Mesh& mesh);
+//diamond-square relief of size x size samples in metres, spacing apart
+Heightmap GenerateHeightmap(int size, unsigned int seed, float spacing = 30.f, float amplitude = 1500.f);
+//height and unit normal at terrain space (x, z), on the triangles Terrain draws at full
+//detail (each cell split along its (x, z)-(x + 1, z + 1) diagonal); points off the map
+//take the nearest border and return false
+bool SampleHeightmap(const Heightmap& heightmap, float x, float z, float& height, glm::vec3& normal);
@@ -0,0 +1,116 @@
+#include "Hgt.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+std::string HgtName(int latitude, int longitude)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%c%02d%c%03d.hgt", latitude < 0 ? 'S' : 'N', std::abs(latitude),
+        longitude < 0 ? 'W' : 'E', std::abs(longitude));
+    return name;
+}
+
+bool ParseHgtName(const std::string& name, int& latitude, int& longitude)
+{
+    std::string stem = std::filesystem::path(name).stem().string();
+    if (stem.size() != 7 || (stem[0] != 'N' && stem[0] != 'S' && stem[0] != 'n' && stem[0] != 's') ||
+        (stem[3] != 'E' && stem[3] != 'W' && stem[3] != 'e' && stem[3] != 'w'))
+        return false;
+    for (int i : { 1, 2, 4, 5, 6 })
+    {
+        if (stem[i] < '0' || stem[i] > '9')
+            return false;
+    }
+    latitude = std::stoi(stem.substr(1, 2));
+    longitude = std::stoi(stem.substr(4, 3));
+    if (stem[0] == 'S' || stem[0] == 's')
+        latitude = -latitude;
+    if (stem[3] == 'W' || stem[3] == 'w')
+        longitude = -longitude;
+    return true;
+}
+
+bool HgtTile::open(const std::string& path)
+{
+    if (!ParseHgtName(path, latitude, longitude))
+    {
+        std::cout << path << " is not named like an SRTM tile\n";
+        return false;
+    }
+    if (!file.open(path))
+    {
+        std::cout << "Failed to map " << path << '\n';
+        return false;
+    }
+    size = (int)std::lround(std::sqrt(file.getSize() / 2.0));
+    if (size < 2 || (size_t)size * size * 2 != file.getSize())
+    {
+        std::cout << path << " is not a square grid of int16 samples\n";
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+Heightmap HgtToHeightmap(const HgtTile& tile, const GeoOrigin& origin)
+{
+    Heightmap heightmap;
+    int size = tile.getSize();
+    heightmap.width = heightmap.height = size;
+    //north west corner, rows run south
+    heightmap.origin = origin.toLocal(tile.getLatitude() + 1, tile.getLongitude());
+    heightmap.spacingX = (float)(origin.metresPerDegreeLongitude() / (size - 1));
+    heightmap.spacingZ = (float)(origin.metresPerDegreeLatitude() / (size - 1));
+    heightmap.heightScale = 1.f;
+    heightmap.samples.resize((size_t)size * size);
+    int16_t last = 0;
+    for (int row = 0; row < size; row++)
+    {
+        for (int column = 0; column < size; column++)
+        {
+            int16_t sample = tile.sample(column, row);
+            if (sample == HGT_VOID)
+                sample = last;
+            heightmap.samples[(size_t)row * size + column] = last = sample;
+        }
+    }
+    return heightmap;
+}
+
+bool WriteSyntheticHgt(const std::string& directory, int latitude, int longitude, int rows, int cols, int size, unsigned int seed)
+{
+    std::filesystem::create_directories(directory);
+    int cells = size - 1;
+    Heightmap relief = GenerateHeightmap(cells * std::max(rows, cols) + 1, seed);
+    std::vector<unsigned char> bytes((size_t)size * size * 2);
+    for (int r = 0; r < rows; r++)
+    {
+        for (int c = 0; c < cols; c++)
+        {
+            //row 0 of the relief is the north edge of the top tiles
+            int top = (rows - 1 - r) * cells, left = c * cells;
+            for (int row = 0; row < size; row++)
+            {
+                for (int column = 0; column < size; column++)
+                {
+                    int16_t sample = relief.samples[(size_t)(top + row) * relief.width + left + column];
+                    bytes[((size_t)row * size + column) * 2] = (unsigned char)((uint16_t)sample >> 8);
+                    bytes[((size_t)row * size + column) * 2 + 1] = (unsigned char)(sample & 0xFF);
+                }
+            }
+            std::string path = (std::filesystem::path(directory) / HgtName(latitude + r, longitude + c)).string();
+            std::ofstream out(path, std::ios::binary);
+            out.write((const char*)bytes.data(), bytes.size());
+            if (!out)
+            {
+                std::cout << "Failed to write " << path << '\n';
+                return false;
+            }
+        }
+    }
+    return true;
+}
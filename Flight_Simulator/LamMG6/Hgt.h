@@ -0,0 +1,63 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <glm.hpp>
+#include "Heightmap.h"
+#include "MappedFile.h"
+
+//SRTM samples the radar missed
+const int16_t HGT_VOID = -32768;
+
+//tiles are named after their south west corner: N45E024.hgt covers 45..46 N, 24..25 E
+std::string HgtName(int latitude, int longitude);
+bool ParseHgtName(const std::string& name, int& latitude, int& longitude);
+
+//A memory mapped .hgt tile: size x size big-endian int16 samples in metres, row 0
+//on the north edge. 1201 samples for 3 arc seconds, 3601 for 1 arc second.
+class HgtTile
+{
+private:
+	MappedFile file;
+	int latitude = 0;
+	int longitude = 0;
+	int size = 0;
+
+public:
+	bool open(const std::string& path);
+	bool isOpen() const { return file.isOpen(); }
+	int getLatitude() const { return latitude; }
+	int getLongitude() const { return longitude; }
+	int getSize() const { return size; }
+	int16_t sample(int column, int row) const
+	{
+		const unsigned char* bytes = file.getData() + ((size_t)row * size + column) * 2;
+		return (int16_t)((bytes[0] << 8) | bytes[1]);
+	}
+};
+
+//One equirectangular plane around origin: x east, z south, in metres. Every tile uses
+//the same metres per degree, so neighbouring tiles share their border samples exactly.
+struct GeoOrigin
+{
+	double latitude = 0.0;
+	double longitude = 0.0;
+
+	double metresPerDegreeLatitude() const { return 111320.0; }
+	double metresPerDegreeLongitude() const { return 111320.0 * std::cos(latitude * 3.14159265358979 / 180.0); }
+	glm::vec3 toLocal(double lat, double lon, float height = 0.f) const
+	{
+		return glm::vec3((float)((lon - longitude) * metresPerDegreeLongitude()), height, (float)((latitude - lat) * metresPerDegreeLatitude()));
+	}
+	void toGeo(const glm::vec3& local, double& lat, double& lon) const
+	{
+		lat = latitude - local.z / metresPerDegreeLatitude();
+		lon = longitude + local.x / metresPerDegreeLongitude();
+	}
+};
+
+//the tile's samples placed on origin's plane; voids take the sample before them
+Heightmap HgtToHeightmap(const HgtTile& tile, const GeoOrigin& origin);
+//rows x cols neighbouring tiles of size samples cut from one generated relief, the
+//south west one at (latitude, longitude); false when a file can't be written
+bool WriteSyntheticHgt(const std::string& directory, int latitude, int longitude, int rows, int cols, int size, unsigned int seed);
@@ -0,0 +1,39 @@
+#shader vertex
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in vec3 aNormal;
+//per instance, InstancedMesh
+layout(location = 9) in mat4 aInstanceModel;
+layout(location = 13) in vec4 aInstanceColor;
+
+out vec2 TexCoords;
+out vec4 Tint;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = vec2(aTexCoord.x, aTexCoord.y * -1.f);
+    Tint = aInstanceColor;
+    gl_Position = projection * view * model * aInstanceModel * vec4(aPos, 1.0);
+}
+
+#shader fragment
+#version 330 core
+in vec2 TexCoords;
+in vec4 Tint;
+out vec4 FragColor;
+
+uniform sampler2D texture1;
+uniform vec3 lightColor;
+
+void main()
+{
+	vec4 texColor = texture(texture1, TexCoords);
+	if (texColor.a < 0.1)
+		discard;
+	FragColor = texColor * Tint * vec4(lightColor, 1.0f);
+}
@@ -0,0 +1,192 @@
+#include "InstancedMesh.h"
+#include "GLState.h"
+#include "GLStats.h"
+#include <algorithm>
+#include <random>
+
+InstancedMesh::InstancedMesh(OBJIndexedMesh data, VertexLayout layout)
+    : Mesh(std::move(data), layout)
+{
+}
+
+InstancedMesh::InstancedMesh(std::shared_ptr<MeshGeometry> geometry)
+    : Mesh(std::move(geometry))
+{
+}
+
+void InstancedMesh::initVAO()
+{
+    Mesh::initVAO();
+
+    glState.bindVertexArray(this->VAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO.create());
+    for (int column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(9 + column, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (GLvoid*)(offsetof(MeshInstance, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(9 + column, 1);
+        glEnableVertexAttribArray(9 + column);
+    }
+    glVertexAttribPointer(13, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (GLvoid*)offsetof(MeshInstance, color));
+    glVertexAttribDivisor(13, 1);
+    glEnableVertexAttribArray(13);
+    glState.bindVertexArray(0);
+    uploadInstances();
+}
+
+void InstancedMesh::uploadInstances()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO.get());
+    glBufferData(GL_ARRAY_BUFFER, this->instances.size() * sizeof(MeshInstance), this->instances.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    this->drawCount = (GLsizei)this->instances.size();
+    this->visible.assign(this->instances.size(), 1);
+}
+
+void InstancedMesh::setInstances(std::vector<MeshInstance> instances)
+{
+    this->instances = std::move(instances);
+    size_t count = this->instances.size();
+    sphereX.resize(count);
+    sphereY.resize(count);
+    sphereZ.resize(count);
+    sphereRadius.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        BoundingSphere sphere = TransformSphere(this->geometry->localSphere, this->instances[i].model);
+        sphereX[i] = sphere.center.x;
+        sphereY[i] = sphere.center.y;
+        sphereZ[i] = sphere.center.z;
+        sphereRadius[i] = sphere.radius;
+    }
+    if (this->instanceVBO.get() != 0)
+        uploadInstances();
+}
+
+void InstancedMesh::cull(const glm::mat4& viewProjection)
+{
+    if (this->instances.empty() || this->instanceVBO.get() == 0)
+        return;
+    //planes taken through the set's model matrix land in the same space as the spheres
+    Frustum frustum(viewProjection * getModel());
+    this->visible.swap(this->wasVisible);
+    this->visible.resize(this->instances.size());
+    size_t nrVisible = frustum.cullSpheres(sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data(), this->instances.size(), this->visible.data());
+    glStats.visible += (unsigned int)nrVisible;
+    glStats.culled += (unsigned int)(this->instances.size() - nrVisible);
+    if (this->visible == this->wasVisible)
+        return;
+
+    this->visibleInstances.clear();
+    for (size_t i = 0; i < this->instances.size(); i++)
+    {
+        if (this->visible[i])
+            this->visibleInstances.push_back(this->instances[i]);
+    }
+    this->drawCount = (GLsizei)nrVisible;
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO.get());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, this->visibleInstances.size() * sizeof(MeshInstance), this->visibleInstances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glStats.calls += 3;
+}
+
+void InstancedMesh::render(Shader* shader)
+{
+    if (this->drawCount == 0)
+        return;
+    shader->Use();
+    shader->SetMat4(shader->ModelUniform, getModel());
+    glState.bindUniformBuffer(MATERIAL_BINDING, this->materialUBO.get());
+    glState.bindVertexArray(this->VAO.get());
+    for (const MaterialRange& range : this->geometry->ranges)
+    {
+        bindMaterial(shader, range);
+        glStats.calls++;
+        glStats.draws++;
+        if (this->geometry->indexCount == 0)
+            glDrawArraysInstanced(GL_TRIANGLES, (GLint)range.firstIndex, (GLsizei)range.count, this->drawCount);
+        else
+            glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)range.count, GL_UNSIGNED_INT, (GLvoid*)(range.firstIndex * sizeof(GLuint)),
+                this->drawCount);
+    }
+}
+
+size_t InstancedMesh::getResidentBytes() const
+{
+    size_t spheres = sphereX.capacity() + sphereY.capacity() + sphereZ.capacity() + sphereRadius.capacity();
+    return Mesh::getResidentBytes() + (instances.capacity() + visibleInstances.capacity()) * sizeof(MeshInstance)
+        + spheres * sizeof(float) + visible.capacity() + wasVisible.capacity();
+}
+
+size_t InstancedMesh::getGPUBytes() const
+{
+    if (this->instanceVBO.get() == 0)
+        return Mesh::getGPUBytes();
+    return Mesh::getGPUBytes() + instances.size() * sizeof(MeshInstance);
+}
+
+std::vector<MeshInstance> ScatterOnSurface(Mesh& surface, size_t count, unsigned int seed, const glm::mat4& base,
+    float minScale, float maxScale, float minUp)
+{
+    std::vector<MeshInstance> instances;
+    const std::vector<glm::vec3>& positions = surface.getPositions();
+    //the mesh's own index buffer, a sequential one is only built for unindexed meshes
+    std::vector<GLuint> sequential;
+    if (surface.getIndices().empty())
+    {
+        sequential.reserve(positions.size());
+        for (GLuint i = 0; i < positions.size(); i++)
+            sequential.push_back(i);
+    }
+    const std::vector<GLuint>& indices = sequential.empty() ? surface.getIndices() : sequential;
+    glm::mat4 model = surface.getModel();
+
+    //running area of the usable triangles, sampled with a binary search
+    std::vector<size_t> faces;
+    std::vector<float> areas;
+    float total = 0.f;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        glm::vec3 a = glm::vec3(model * glm::vec4(positions[indices[i]], 1.f));
+        glm::vec3 b = glm::vec3(model * glm::vec4(positions[indices[i + 1]], 1.f));
+        glm::vec3 c = glm::vec3(model * glm::vec4(positions[indices[i + 2]], 1.f));
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float area = glm::length(normal) * 0.5f;
+        if (area <= 0.f || std::abs(normal.y) / (2.f * area) < minUp)
+            continue;
+        total += area;
+        faces.push_back(i);
+        areas.push_back(total);
+    }
+    if (faces.empty())
+        return instances;
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    instances.reserve(count);
+    for (size_t n = 0; n < count; n++)
+    {
+        size_t face = std::lower_bound(areas.begin(), areas.end(), unit(random) * total) - areas.begin();
+        face = faces[std::min(face, faces.size() - 1)];
+        glm::vec3 a = glm::vec3(model * glm::vec4(positions[indices[face]], 1.f));
+        glm::vec3 b = glm::vec3(model * glm::vec4(positions[indices[face + 1]], 1.f));
+        glm::vec3 c = glm::vec3(model * glm::vec4(positions[indices[face + 2]], 1.f));
+        //uniform point in the triangle
+        float u = unit(random), v = unit(random);
+        if (u + v > 1.f)
+        {
+            u = 1.f - u;
+            v = 1.f - v;
+        }
+        glm::vec3 point = a + u * (b - a) + v * (c - a);
+
+        float scale = minScale + (maxScale - minScale) * unit(random);
+        MeshInstance instance;
+        instance.model = glm::translate(glm::mat4(1.f), point);
+        instance.model = glm::rotate(instance.model, unit(random) * 6.2831853f, glm::vec3(0.f, 1.f, 0.f));
+        instance.model = glm::scale(instance.model, glm::vec3(scale)) * base;
+        float shade = 0.8f + 0.3f * unit(random);
+        instance.color = glm::vec4(shade, shade, shade, 1.f);
+        instances.push_back(instance);
+    }
+    return instances;
+}
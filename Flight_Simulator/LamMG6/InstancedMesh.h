@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include "Mesh.h"
+
+//per instance attributes: model columns at 9-12, tint at 13
+struct MeshInstance
+{
+	glm::mat4 model;
+	glm::vec4 color;
+};
+
+//One copy of the geometry drawn many times with glDrawElementsInstanced;
+//the Mesh model matrix places the whole set, each instance adds its own.
+class InstancedMesh : public Mesh
+{
+private:
+	std::vector<MeshInstance> instances;
+	GLBuffer instanceVBO;
+	//bounding sphere of each instance in the set's space, structure of arrays for Frustum::cullSpheres
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	std::vector<uint8_t> visible, wasVisible;
+	std::vector<MeshInstance> visibleInstances;
+	GLsizei drawCount = 0;
+
+	void uploadInstances();
+
+public:
+	InstancedMesh(OBJIndexedMesh data, VertexLayout layout = VertexLayout::Compact);
+	InstancedMesh(std::shared_ptr<MeshGeometry> geometry);
+	void initVAO() override;
+	void render(Shader* shader) override;
+	//packs the instances inside the view frustum to the front of the buffer;
+	//the buffer is rewritten only when the visible set changed
+	void cull(const glm::mat4& viewProjection);
+	void setInstances(std::vector<MeshInstance> instances);
+	size_t getInstanceCount() const { return instances.size(); }
+	size_t getVisibleCount() const { return drawCount; }
+	size_t getResidentBytes() const override;
+	size_t getGPUBytes() const override;
+};
+
+//count points spread uniformly by area over surface's triangles in world space,
+//skipping faces whose normal.y is below minUp; base is applied before the random
+//yaw and scale (e.g. to turn a Z-up model upright)
+std::vector<MeshInstance> ScatterOnSurface(Mesh& surface, size_t count, unsigned int seed, const glm::mat4& base,
+	float minScale, float maxScale, float minUp);
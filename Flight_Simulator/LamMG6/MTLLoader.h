@@ -13,6 +13,37 @@
 #include <GL/glew.h>
 #include "Material.h"
 
+//a map_* file name as the .mtl wrote it (Windows separators, an absolute path from the
+//exporter's machine) as a path that opens from the working directory: tried next to the
+//.mtl and then as is, dropping leading folders until one exists; empty when none does
+static std::string resolveMaterialMap(const std::string& mtlFile, std::string name)
+{
+	std::replace(name.begin(), name.end(), '\\', '/');
+	std::vector<std::string> parts;
+	std::stringstream ss(name);
+	std::string part;
+	while (std::getline(ss, part, '/'))
+	{
+		if (!part.empty())
+			parts.push_back(part);
+	}
+	std::filesystem::path folder = std::filesystem::path(mtlFile).parent_path();
+	std::error_code error;
+	for (size_t first = 0; first < parts.size(); first++)
+	{
+		std::filesystem::path suffix;
+		for (size_t i = first; i < parts.size(); i++)
+			suffix /= parts[i];
+		for (const std::filesystem::path& candidate : { folder / suffix, suffix })
+		{
+			if (std::filesystem::is_regular_file(candidate, error))
+				return candidate.lexically_normal().generic_string();
+		}
+	}
+	std::cout << mtlFile << ": map " << name << " not found\n";
+	return std::string();
+}
+
 static std::vector<Material> loadMTL(const char* file_name)
 {
 	int pos = -1;
@@ -33,12 +64,18 @@ static std::vector<Material> loadMTL(const char* file_name)
 		//get prefix
 		ss.clear();
 		ss.str(line);
+		//a blank line must not repeat the previous one
+		prefix.clear();
 		ss >> prefix;
+		//nothing to attach a property to before the first newmtl
+		if (pos < 0 && prefix != "newmtl")
+			continue;
 
 		if (prefix == "newmtl") //vertex position
 		{
 			materials.push_back(Material());
 			pos++;
+			ss >> materials[pos].name;
 		}
 		else
 			if (prefix == "Ka") //texture coords
@@ -61,6 +98,30 @@ static std::vector<Material> loadMTL(const char* file_name)
 						ss >> specular.x >> specular.y >> specular.z;
 						materials[pos].specular = specular;
 					}
+					else
+						if (prefix == "Ns")
+							ss >> materials[pos].shininess;
+						else
+							if (prefix == "d")
+								ss >> materials[pos].opacity;
+							else
+								if (prefix == "illum")
+									ss >> materials[pos].illum;
+								else
+									if (prefix == "map_Kd" || prefix == "map_Ks" || prefix == "map_Bump" || prefix == "map_bump" || prefix == "bump")
+									{
+										//options such as -bm 0.5 come first, the file name last
+										std::string name, word;
+										while (ss >> word)
+											name = word;
+										std::string path = name.empty() ? name : resolveMaterialMap(file_name, name);
+										if (prefix == "map_Kd")
+											materials[pos].diffuseMap = path;
+										else if (prefix == "map_Ks")
+											materials[pos].specularMap = path;
+										else
+											materials[pos].bumpMap = path;
+									}
 	}
 	//debug
 	std::cout << "MTL file " << file_name << " loaded successfully with " << pos + 1 << " materials!\n";
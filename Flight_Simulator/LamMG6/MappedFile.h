@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+//Read only memory mapping of a whole file; pages come in from disk as they are touched.
+class MappedFile
+{
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int descriptor = -1;
+#endif
+
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+	const unsigned char* getData() const { return data; }
+	size_t getSize() const { return size; }
+};
@@ -1,12 +1,52 @@
 #pragma once
 
+#include <string>
+#include <GL/glew.h>
 #include <glm.hpp>
 
+//size of the Materials uniform block in Basic.shader
+const int MAX_MATERIALS = 16;
+//uniform buffer binding point of the Materials block
+const unsigned int MATERIAL_BINDING = 0;
+//texture unit a material's map_Kd is bound to while its range draws
+const GLuint DIFFUSE_MAP_UNIT = 0;
+
 struct Material
 {
-	glm::vec3 ambient;
-	glm::vec3 diffuse;
-	glm::vec3 specular;
-	GLint diffuseTex;
-	GLint speculatTex;
-};
\ No newline at end of file
+	//newmtl, what usemtl refers to
+	std::string name;
+	glm::vec3 ambient = glm::vec3(0.f);
+	glm::vec3 diffuse = glm::vec3(0.f);
+	glm::vec3 specular = glm::vec3(0.f);
+	//Ns, d and illum
+	float shininess = 0.f;
+	float opacity = 1.f;
+	int illum = 2;
+	//map_Kd, map_Ks and map_Bump as paths that open from the working directory,
+	//empty when the .mtl has none or the file wasn't found; no shader samples the
+	//specular and bump maps yet, so only diffuseMap is loaded
+	std::string diffuseMap;
+	std::string specularMap;
+	std::string bumpMap;
+};
+
+//one std140 entry of the Materials block, vec3s padded to vec4
+struct MaterialEntry
+{
+	glm::vec4 color;
+	glm::vec4 ambient;
+	//w is the opacity
+	glm::vec4 diffuse;
+	//w is the shininess
+	glm::vec4 specular;
+};
+
+//indices [firstIndex, firstIndex + count) all use one material; a mesh's ranges
+//cover its index buffer in order
+struct MaterialRange
+{
+	GLuint firstIndex;
+	GLuint count;
+	//-1 for faces before the first usemtl
+	GLint material;
+};
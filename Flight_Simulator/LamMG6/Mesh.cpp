@@ -1,123 +1,201 @@
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "GLStats.h"
+#include "GLState.h"
+#include "ResourceManager.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 
-void Mesh::initVertexData(Vertex* vertexArray, const unsigned& nrOfVertices, GLuint* indexArray, const unsigned& nrOfIndices)
+void Mesh::initMaterialTable()
 {
-	for (size_t i = 0; i < nrOfVertices; i++)
+	const std::vector<Material>& materials = geometry->materials;
+	size_t count = std::min(materials.size(), (size_t)MAX_MATERIALS);
+	materialTable.resize(count);
+	for (size_t i = 0; i < count; i++)
 	{
-		this->vertices.push_back(vertexArray[i]);
+		//magenta until setColor, like the per-vertex color loadOBJ writes
+		materialTable[i].color = glm::vec4(1.0f, 0.0f, 1.0f, 1.0f);
+		materialTable[i].ambient = glm::vec4(materials[i].ambient, 1.0f);
+		materialTable[i].diffuse = glm::vec4(materials[i].diffuse, materials[i].opacity);
+		materialTable[i].specular = glm::vec4(materials[i].specular, materials[i].shininess);
 	}
+}
 
-	for (size_t i = 0; i < nrOfIndices; i++)
-	{
-		this->indices.push_back(indexArray[i]);
-	}
+MeshGeometry::MeshGeometry(OBJIndexedMesh data, VertexLayout layout)
+{
+	this->layout = layout;
+	this->vertices = std::move(data.vertices);
+	this->indices = std::move(data.indices);
+	this->materials = std::move(data.materials);
+	this->ranges = std::move(data.ranges);
+	this->positions.reserve(this->vertices.size());
+	for (const Vertex& vertex : this->vertices)
+		this->positions.push_back(vertex.position);
+	this->vertexCount = (GLsizei)this->vertices.size();
+	this->indexCount = (GLsizei)this->indices.size();
+	if (this->ranges.empty() && this->vertexCount != 0)
+		this->ranges.push_back({ 0, (GLuint)(this->indexCount != 0 ? this->indexCount : this->vertexCount), 0 });
+	this->localBounds = ComputeAABB(this->vertices);
+	this->localSphere = ComputeBoundingSphere(this->vertices, this->localBounds);
 }
 
-void Mesh::initMaterials()
+void MeshGeometry::upload()
 {
-	for (int i = 0; i < materials.size(); i++)
+	if (isUploaded())
+		return;
+
+	//GEN VBO AND BIND AND SEND DATA
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBO.create());
+	if (this->layout == VertexLayout::Compact)
 	{
-		for (int j = 0; j < vertices.size(); j++)
-		{
-			if (vertices[j].colorID == i)
-			{
-				vertices[j].ambient = materials[i].ambient;
-				vertices[j].diffuse = materials[i].diffuse;
-				vertices[j].specular = materials[i].specular;
-			}
-		}
+		std::vector<CompactVertex> compact;
+		compact.reserve(this->vertices.size());
+		for (const Vertex& vertex : this->vertices)
+			compact.push_back(toCompactVertex(vertex));
+		glBufferData(GL_ARRAY_BUFFER, compact.size() * sizeof(CompactVertex), compact.data(), GL_STATIC_DRAW);
 	}
+	else
+		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//GEN EBO AND SEND DATA, bound to each instance's VAO later
+	if (this->indices.size() > 0)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->EBO.create());
+		glBufferData(GL_COPY_WRITE_BUFFER, this->indices.size() * sizeof(GLuint), this->indices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	//swapped with empties so the capacity goes too
+	if (this->residency != MeshResidency::Full)
+		std::vector<Vertex>().swap(this->vertices);
+	if (this->residency == MeshResidency::Discard)
+	{
+		std::vector<glm::vec3>().swap(this->positions);
+		std::vector<GLuint>().swap(this->indices);
+	}
+}
+
+void MeshGeometry::requestResidency(MeshResidency residency)
+{
+	if (residency <= this->residency)
+		return;
+	if (isUploaded())
+		std::cout << "Mesh geometry already uploaded, its CPU copies can't be kept any more\n";
+	else
+		this->residency = residency;
+}
+
+size_t MeshGeometry::getResidentBytes() const
+{
+	size_t bytes = vertices.capacity() * sizeof(Vertex) + positions.capacity() * sizeof(glm::vec3) + indices.capacity() * sizeof(GLuint);
+	return bytes + materials.capacity() * sizeof(Material);
+}
+
+size_t MeshGeometry::getGPUBytes() const
+{
+	if (!isUploaded())
+		return 0;
+	size_t vertexSize = this->layout == VertexLayout::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+	return vertexCount * vertexSize + indexCount * sizeof(GLuint);
 }
 
 void Mesh::initVAO()
 {
+	this->geometry->upload();
+
 	//Create VAO
-	glCreateVertexArrays(1, &this->VAO);
-	glBindVertexArray(this->VAO);
+	glState.bindVertexArray(this->VAO.create());
+	glBindBuffer(GL_ARRAY_BUFFER, this->geometry->VBO.get());
+	if (this->geometry->EBO.get() != 0)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->geometry->EBO.get());
 
-	//GEN VBO AND BIND AND SEND DATA
-	glGenBuffers(1, &this->VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-	glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	//GEN MATERIAL UBO, always full size so the whole block is backed
+	glBindBuffer(GL_UNIFORM_BUFFER, this->materialUBO.create());
+	glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialEntry), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, this->materialTable.size() * sizeof(MaterialEntry), this->materialTable.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-	//GEN EBO AND BIND AND SEND DATA
-	if (this->indices.size() > 0)
+	//SET VERTEXATTRIBPOINTERS AND ENABLE (INPUT ASSEMBLY)
+	if (this->geometry->layout == VertexLayout::Compact)
 	{
-		glGenBuffers(1, &this->EBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), this->indices.data(), GL_STATIC_DRAW);
+		//Position
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompactVertex), (GLvoid*)offsetof(CompactVertex, CompactVertex::position));
+		glEnableVertexAttribArray(0);
+		//Texcoord
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (GLvoid*)offsetof(CompactVertex, CompactVertex::texcoord));
+		glEnableVertexAttribArray(2);
+		//Normal
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (GLvoid*)offsetof(CompactVertex, CompactVertex::normal));
+		glEnableVertexAttribArray(3);
+	}
+	else
+	{
+		//Position
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::position));
+		glEnableVertexAttribArray(0);
+		//Color
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::color));
+		glEnableVertexAttribArray(1);
+		//Texcoord
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::texcoord));
+		glEnableVertexAttribArray(2);
+		//Normal
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::normal));
+		glEnableVertexAttribArray(3);
+		//Ambient
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::ambient));
+		glEnableVertexAttribArray(4);
+		//Diffuse
+		glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::diffuse));
+		glEnableVertexAttribArray(5);
+		//Specular
+		glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::specular));
+		glEnableVertexAttribArray(6);
 	}
-
-	//SET VERTEXATTRIBPOINTERS AND ENABLE (INPUT ASSEMBLY)
-	//Position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::position));
-	glEnableVertexAttribArray(0);
-	//Color
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::color));
-	glEnableVertexAttribArray(1);
-	//Texcoord
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::texcoord));
-	glEnableVertexAttribArray(2);
-	//Normal
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::normal));
-	glEnableVertexAttribArray(3);
-	//Ambient
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::ambient));
-	glEnableVertexAttribArray(4);
-	//Diffuse
-	glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::diffuse));
-	glEnableVertexAttribArray(5);
-	//Specular
-	glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Vertex::specular));
-	glEnableVertexAttribArray(6);
 
 	//BIND VAO 0
-	glBindVertexArray(0);
+	glState.bindVertexArray(0);
+}
 
+void Mesh::setResidency(MeshResidency residency)
+{
+	this->geometry->requestResidency(residency);
 }
 
-void Mesh::updateModelMatrix()
+Mesh::Mesh(std::string OBJfile, VertexLayout layout)
+	: Mesh(resources.acquireMesh(OBJfile, nullptr, layout))
 {
-	this->ModelMatrix = glm::mat4(1.f);
-	this->ModelMatrix = glm::translate(this->ModelMatrix, this->position);
-	this->ModelMatrix = glm::rotate(this->ModelMatrix, glm::radians(this->rotation.x), glm::vec3(1.f, 0.f, 0.f));
-	this->ModelMatrix = glm::rotate(this->ModelMatrix, glm::radians(this->rotation.z), glm::vec3(0.f, 0.f, 1.f));
-	this->ModelMatrix = glm::rotate(this->ModelMatrix, glm::radians(this->rotation.y), glm::vec3(0.f, 1.f, 0.f));
-	this->ModelMatrix = glm::scale(this->ModelMatrix, this->scale);
 }
 
-Mesh::Mesh(std::string OBJfile)
+Mesh::Mesh(OBJIndexedMesh data, VertexLayout layout)
+	: Mesh(std::make_shared<MeshGeometry>(std::move(data), layout))
 {
-	this->position = glm::vec3(0.f);
-	this->rotation = glm::vec3(0.f);
-	this->scale = glm::vec3(5.0f);
-	std::pair <std::vector<Vertex>, std::vector<Material>> files = loadOBJ(OBJfile.c_str());
-	this->vertices = files.first;
-	this->materials = files.second;
+}
+
+Mesh::Mesh(std::shared_ptr<MeshGeometry> geometry)
+{
+	this->geometry = std::move(geometry);
+	this->transform = TransformNode(sceneTransforms);
+	sceneTransforms.setScale(this->transform.get(), glm::vec3(5.0f));
+	initMaterialTable();
 	//initVAO();
-	initMaterials();
-	updateModelMatrix();
 }
 
 void Mesh::setColor(int index, glm::vec3 rgb)
 {
-	int found = 0;
-	for (int i = 0; i < vertices.size(); i++)
+	if (index < 0 || index >= (int)materialTable.size())
+		return;
+	materialTable[index].color = glm::vec4(rgb, 1.0f);
+
+	//after initVAO only the one entry goes to the GPU
+	if (this->materialUBO.get() != 0)
 	{
-		if (this->vertices[i].colorID == index)
-		{
-			this->vertices[i].color = rgb;
-			found++;
-		}
+		glBindBuffer(GL_UNIFORM_BUFFER, this->materialUBO.get());
+		glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(MaterialEntry), sizeof(glm::vec4), &materialTable[index].color);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	}
-	std::cout << "found: " << found << '\n';
-}
-
-Mesh::~Mesh()
-{
-	glDeleteVertexArrays(1, &this->VAO);
-	glDeleteBuffers(1, &this->VBO);
-	glDeleteBuffers(2, &this->EBO);
 }
 
 void Mesh::update()
@@ -128,59 +206,207 @@ void Mesh::update()
 void Mesh::render(Shader* shader)
 {
 	shader->Use();
-	updateModelMatrix();
-	shader->SetMat4("model", ModelMatrix);
-	glBindVertexArray(this->VAO);
-	if (this->indices.empty())
-		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-	else
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	shader->SetMat4(shader->ModelUniform, getModel());
+	glState.bindUniformBuffer(MATERIAL_BINDING, this->materialUBO.get());
+	glState.bindVertexArray(this->VAO.get());
+	//one draw per material, its index comes from a uniform rather than the vertices
+	for (const MaterialRange& range : this->geometry->ranges)
+	{
+		bindMaterial(shader, range);
+		glStats.calls++;
+		glStats.draws++;
+		if (this->geometry->indexCount == 0)
+			glDrawArrays(GL_TRIANGLES, (GLint)range.firstIndex, (GLsizei)range.count);
+		else
+			glDrawElements(GL_TRIANGLES, (GLsizei)range.count, GL_UNSIGNED_INT, (GLvoid*)(range.firstIndex * sizeof(GLuint)));
+	}
+}
+
+void Mesh::bindMaterial(Shader* shader, const MaterialRange& range) const
+{
+	if (shader->MaterialUniform.location >= 0)
+		shader->SetInt(shader->MaterialUniform, range.material);
+	const MaterialMaps* own = getMaps(range);
+	if (own != nullptr && own->diffuse)
+		glState.bindTexture2D(own->diffuse->get(), DIFFUSE_MAP_UNIT);
+	else if (this->texture)
+		glState.bindTexture2D(this->texture->get(), DIFFUSE_MAP_UNIT);
+}
 
-	//Cleanup
-	glBindVertexArray(0);
-	glUseProgram(0);
+void Mesh::setTexture(std::shared_ptr<Texture> texture)
+{
+	this->texture = std::move(texture);
+}
+
+const MaterialMaps* Mesh::getMaps(const MaterialRange& range) const
+{
+	const std::vector<MaterialMaps>& maps = this->geometry->maps;
+	return range.material >= 0 && range.material < (GLint)maps.size() ? &maps[range.material] : nullptr;
+}
+
+unsigned int Mesh::getTexture(size_t range) const
+{
+	if (range < this->geometry->ranges.size())
+	{
+		const MaterialMaps* own = getMaps(this->geometry->ranges[range]);
+		if (own != nullptr && own->diffuse)
+			return own->diffuse->get();
+	}
+	return this->texture ? this->texture->get() : 0;
 }
 
 void Mesh::setPosition(glm::vec3 position)
 {
-	this->position = position;
-	updateModelMatrix();
+	sceneTransforms.setPosition(this->transform.get(), position);
 }
 
 void Mesh::setRotation(glm::vec3 rotation)
 {
-	this->rotation = rotation;
-	updateModelMatrix();
+	sceneTransforms.setRotation(this->transform.get(), rotation);
 }
 
 void Mesh::setScale(glm::vec3 scale)
 {
-	this->scale = scale;
-	updateModelMatrix();
+	sceneTransforms.setScale(this->transform.get(), scale);
 }
 
 void Mesh::setModel(glm::mat4 Model)
 {
-	ModelMatrix = Model;
-	updateModelMatrix();
+	sceneTransforms.setLocal(this->transform.get(), Model);
 }
 
-glm::mat4 Mesh::getModel()
+void Mesh::setParent(const Mesh* parent)
 {
-	return ModelMatrix;
+	setParent(parent != nullptr ? parent->getTransform() : NO_TRANSFORM);
+}
+
+void Mesh::setParent(TransformHandle parent)
+{
+	if (!sceneTransforms.setParent(this->transform.get(), parent))
+		std::cout << "Mesh can't be attached below itself\n";
+}
+
+glm::mat4 Mesh::getModel() const
+{
+	return sceneTransforms.getWorld(this->transform.get());
 }
 
 glm::vec3 Mesh::getRotation()
 {
-	return rotation;
+	return sceneTransforms.getRotation(this->transform.get());
+}
+
+GLuint Mesh::getVAO()
+{
+	return this->VAO.get();
 }
 
 glm::vec3 Mesh::getPosition()
 {
-	return position;
+	return sceneTransforms.getPosition(this->transform.get());
 }
 
 std::vector<Material> Mesh::getMaterials()
 {
-	return materials;
-}
\ No newline at end of file
+	return geometry->materials;
+}
+
+const std::vector<Vertex>& Mesh::getVertices() const
+{
+	return geometry->vertices;
+}
+
+const std::vector<glm::vec3>& Mesh::getPositions() const
+{
+	return geometry->positions;
+}
+
+const std::vector<GLuint>& Mesh::getIndices() const
+{
+	return geometry->indices;
+}
+
+const std::vector<MaterialEntry>& Mesh::getMaterialTable() const
+{
+	return materialTable;
+}
+const AABB& Mesh::getLocalBounds() const
+{
+	return geometry->localBounds;
+}
+
+AABB Mesh::getWorldBounds() const
+{
+	return TransformAABB(geometry->localBounds, getModel());
+}
+
+BoundingSphere Mesh::getWorldSphere() const
+{
+	return TransformSphere(geometry->localSphere, getModel());
+}
+
+bool Mesh::isVisible(const Frustum& frustum) const
+{
+	if (frustum.intersects(getWorldBounds()))
+	{
+		glStats.visible++;
+		return true;
+	}
+	glStats.culled++;
+	return false;
+}
+
+size_t Mesh::getResidentBytes() const
+{
+	return materialTable.capacity() * sizeof(MaterialEntry);
+}
+
+size_t Mesh::getGPUBytes() const
+{
+	return this->materialUBO.get() != 0 ? MAX_MATERIALS * sizeof(MaterialEntry) : 0;
+}
+
+void SumMeshMemory(const std::vector<std::pair<std::string, const Mesh*>>& meshes, size_t& cpu, size_t& gpu)
+{
+	cpu = gpu = 0;
+	std::vector<const MeshGeometry*> counted;
+	for (const auto& entry : meshes)
+	{
+		const Mesh& mesh = *entry.second;
+		cpu += mesh.getResidentBytes();
+		gpu += mesh.getGPUBytes();
+		if (std::find(counted.begin(), counted.end(), &mesh.getGeometry()) != counted.end())
+			continue;
+		counted.push_back(&mesh.getGeometry());
+		cpu += mesh.getGeometry().getResidentBytes();
+		gpu += mesh.getGeometry().getGPUBytes();
+	}
+}
+
+void PrintMeshMemory(const std::vector<std::pair<std::string, const Mesh*>>& meshes)
+{
+	const char* names[] = { "discard", "positions", "full" };
+	std::vector<const MeshGeometry*> counted;
+	std::ostringstream out;
+	out << std::left << std::setw(32) << "mesh" << std::setw(11) << "residency" << std::right << std::setw(12) << "CPU KB"
+		<< std::setw(12) << "GPU KB" << '\n';
+	for (const auto& entry : meshes)
+	{
+		const Mesh& mesh = *entry.second;
+		size_t cpu = mesh.getResidentBytes(), gpu = mesh.getGPUBytes();
+		bool shared = std::find(counted.begin(), counted.end(), &mesh.getGeometry()) != counted.end();
+		if (!shared)
+		{
+			counted.push_back(&mesh.getGeometry());
+			cpu += mesh.getGeometry().getResidentBytes();
+			gpu += mesh.getGeometry().getGPUBytes();
+		}
+		out << std::left << std::setw(32) << entry.first << std::setw(11) << names[(int)mesh.getResidency()]
+			<< std::right << std::setw(12) << cpu / 1024 << std::setw(12) << gpu / 1024 << (shared ? "  geometry shared" : "") << '\n';
+	}
+	size_t totalCPU, totalGPU;
+	SumMeshMemory(meshes, totalCPU, totalGPU);
+	out << std::left << std::setw(43) << "total" << std::right << std::setw(12) << totalCPU / 1024 << std::setw(12)
+		<< totalGPU / 1024 << '\n';
+	std::cout << out.str();
+}
@@ -7,42 +7,148 @@
 #include <glfw3.h>
 #include "Shader.h"
 #include <vector>
+#include <memory>
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
 #include "OBJLoader.h"
+#include "Frustum.h"
+#include "GLHandle.h"
+#include "Transform.h"
 
-class Mesh
+class Texture;
+
+//what a Mesh keeps in memory once initVAO has uploaded it
+enum class MeshResidency
+{
+	//nothing, the GPU buffers are the only copy
+	Discard,
+	//positions and indices, for collisions, picking and scattering
+	Positions,
+	//every attribute, for meshes that are edited after upload
+	Full
+};
+
+//a material's textures, null where the .mtl names none
+struct MaterialMaps
+{
+	std::shared_ptr<Texture> diffuse;
+};
+
+//The part of a Mesh any number of instances share: the vertex and index buffers,
+//what the residency keeps of them on the CPU, the bounds, the .mtl materials with
+//their draw ranges and maps. Each Mesh adds its own VAO, material table and transform.
+class MeshGeometry
 {
-private:
+public:
 	std::vector <Vertex> vertices;
+	//model space positions of the vertices, the compact copy Positions keeps
+	std::vector <glm::vec3> positions;
 	std::vector <GLuint> indices;
 	std::vector <Material> materials;
+	//never empty once there is something to draw, one range covers a mesh without materials
+	std::vector <MaterialRange> ranges;
+	//by material index, empty until ResourceManager::acquireMaterialMaps
+	std::vector <MaterialMaps> maps;
+	VertexLayout layout;
+	MeshResidency residency = MeshResidency::Discard;
+	//what the draws use, still known once the CPU copies are gone
+	GLsizei vertexCount = 0;
+	GLsizei indexCount = 0;
+	GLBuffer VBO;
+	GLBuffer EBO;
+	//model space, computed once from the vertices
+	AABB localBounds;
+	BoundingSphere localSphere;
+
+	MeshGeometry(OBJIndexedMesh data, VertexLayout layout = VertexLayout::Compact);
+	bool isUploaded() const { return VBO.get() != 0; }
+	//the first call uploads and then frees what the residency doesn't keep
+	void upload();
+	//keeps the most any instance asked for; too late to keep more once uploaded
+	void requestResidency(MeshResidency residency);
+	size_t getResidentBytes() const;
+	size_t getGPUBytes() const;
+};
+
+class Mesh
+{
+protected:
+	std::shared_ptr<MeshGeometry> geometry;
+	std::vector <MaterialEntry> materialTable;
 
-	GLuint VAO;
-	GLuint VBO;
-	GLuint EBO;
-	glm::mat4 ModelMatrix;
-	glm::vec3 position;
-	glm::vec3 rotation;
-	glm::vec3 scale;
+	//owned GL names, deleted with the mesh: a Mesh moves but never copies
+	GLVertexArray VAO;
+	GLBuffer materialUBO;
+	//drawn where a material has no diffuse map of its own
+	std::shared_ptr<Texture> texture;
+	//position, rotation and scale live in sceneTransforms, the model matrix is
+	//rebuilt there only after one of them (or a parent) changed
+	TransformNode transform;
 
-	void initVertexData(Vertex* vertexArray, const unsigned& nrOfVertices, GLuint* indexArray, const unsigned& nrOfIndices);
-	void updateModelMatrix();
-	void initMaterials();
+	void initMaterialTable();
+	//null when the range's material has no maps loaded
+	const MaterialMaps* getMaps(const MaterialRange& range) const;
+	//the material index uniform and the range's maps
+	void bindMaterial(Shader* shader, const MaterialRange& range) const;
 
 public:
-	Mesh(std::string OBJfile);
-	~Mesh();
+	//shared with every other Mesh of the same file or contents, see ResourceManager
+	Mesh(std::string OBJfile, VertexLayout layout = VertexLayout::Compact);
+	Mesh(OBJIndexedMesh data, VertexLayout layout = VertexLayout::Compact);
+	//another instance of geometry, e.g. from ResourceManager::acquireMesh
+	Mesh(std::shared_ptr<MeshGeometry> geometry);
+	virtual ~Mesh() = default;
+	Mesh(Mesh&&) noexcept = default;
+	Mesh& operator=(Mesh&&) noexcept = default;
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
 	void update();
-	void initVAO();
-	void render(Shader* shader);
+	//before initVAO; instances sharing the geometry keep the most any of them asks for
+	void setResidency(MeshResidency residency);
+	MeshResidency getResidency() const { return geometry->residency; }
+	virtual void initVAO();
+	virtual void render(Shader* shader);
 	void setPosition(glm::vec3 position);
 	void setRotation(glm::vec3 rotation);
 	void setModel(glm::mat4 Model);
 	void setScale(glm::vec3 scale);
 	void setColor(int index, glm::vec3 rgb);
-	glm::mat4 getModel();
+	void setTexture(std::shared_ptr<Texture> texture);
+	//GL name of the diffuse texture a range draws with, 0 when it has none
+	unsigned int getTexture(size_t range = 0) const;
+	//the mesh then moves with parent; its own position, rotation and scale become local to it
+	void setParent(const Mesh* parent);
+	void setParent(TransformHandle parent);
+	TransformHandle getTransform() const { return transform.get(); }
+	glm::mat4 getModel() const;
 	glm::vec3 getRotation();
 	glm::vec3 getPosition();
+	GLuint getVAO();
+	const MeshGeometry& getGeometry() const { return *geometry; }
+	GLuint getVBO() const { return geometry->VBO.get(); }
+	GLuint getEBO() const { return geometry->EBO.get(); }
+	VertexLayout getLayout() const { return geometry->layout; }
+	GLsizei getVertexCount() const { return geometry->vertexCount; }
+	GLsizei getIndexCount() const { return geometry->indexCount; }
+	//empty after initVAO unless the residency is Full
+	const std::vector<Vertex>& getVertices() const;
+	//empty after initVAO when the residency is Discard
+	const std::vector<glm::vec3>& getPositions() const;
+	const std::vector<GLuint>& getIndices() const;
+	const std::vector<MaterialEntry>& getMaterialTable() const;
+	const std::vector<MaterialRange>& getRanges() const { return geometry->ranges; }
+	const AABB& getLocalBounds() const;
+	AABB getWorldBounds() const;
+	BoundingSphere getWorldSphere() const;
+	//world bounds against the frustum, counted in glStats
+	bool isVisible(const Frustum& frustum) const;
 	std::vector <Material> getMaterials();
-};
\ No newline at end of file
+	//heap bytes this instance holds on the CPU beyond its geometry, and its own buffers
+	virtual size_t getResidentBytes() const;
+	virtual size_t getGPUBytes() const;
+};
+
+//geometry shared by several meshes is counted at the first of them
+void SumMeshMemory(const std::vector<std::pair<std::string, const Mesh*>>& meshes, size_t& cpu, size_t& gpu);
+//one line per mesh with its residency, CPU and GPU bytes, then the totals
+void PrintMeshMemory(const std::vector<std::pair<std::string, const Mesh*>>& meshes);
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "MeshCache.h"
+#include "ResourceManager.h"
+#include <cstdint>
+#include <filesystem>
+
+//bump whenever Vertex, Material, the layout below or what the loader produces changes
+static const uint32_t MESH_CACHE_VERSION = 5;
+static const char MESH_CACHE_MAGIC[4] = { 'M', 'G', 'M', 'S' };
+
+struct MeshCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t materialSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+    //the .mtl its materials and map paths came from, 0 when there was none
+    int64_t materialTime;
+    uint64_t materialHash;
+    uint32_t pathLength;
+    uint32_t nrOfVertices;
+    uint32_t nrOfIndices;
+    uint32_t nrOfMaterials;
+    uint32_t nrOfRanges;
+};
+
+//the fixed size part of a Material, its name and map paths follow as length and bytes
+struct MaterialRecord
+{
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    float shininess;
+    float opacity;
+    int32_t illum;
+};
+
+static void writeString(std::ofstream& fout, const std::string& text)
+{
+    uint32_t length = (uint32_t)text.size();
+    fout.write((const char*)&length, sizeof(length));
+    fout.write(text.data(), length);
+}
+
+static bool readString(std::ifstream& fin, std::string& text)
+{
+    uint32_t length = 0;
+    if (!fin.read((char*)&length, sizeof(length)))
+        return false;
+    text.resize(length);
+    return (bool)fin.read(text.data(), length);
+}
+
+static bool sourceKey(const std::string& OBJfile, int64_t& time)
+{
+    std::error_code error;
+    auto stamp = std::filesystem::last_write_time(OBJfile, error);
+    if (error)
+        return false;
+    time = (int64_t)stamp.time_since_epoch().count();
+    return true;
+}
+
+//a touched but unchanged source (e.g. fresh checkout) still matches; time is then
+//moved to the file's so the header can be rewritten and the next load skips the hash
+static bool sameSource(const std::string& file, int64_t& time, uint64_t hash, bool& touched)
+{
+    int64_t now;
+    if (!sourceKey(file, now))
+        return false;
+    if (now == time)
+        return true;
+    std::string bytes;
+    if (!readOBJBytes(file.c_str(), bytes) || HashBytes(bytes.data(), bytes.size()) != hash)
+        return false;
+    time = now;
+    touched = true;
+    return true;
+}
+
+std::string MeshCachePath(const std::string& OBJfile)
+{
+    return std::filesystem::path(OBJfile).replace_extension(".mgmesh").string();
+}
+
+bool LoadMeshCache(const std::string& OBJfile, OBJIndexedMesh& mesh)
+{
+    std::ifstream fin(MeshCachePath(OBJfile), std::ios::binary | std::ios::ate);
+    if (!fin.is_open())
+        return false;
+    uint64_t fileSize = (uint64_t)fin.tellg();
+    fin.seekg(0, std::ios::beg);
+
+    MeshCacheHeader header;
+    if (!fin.read((char*)&header, sizeof(header)))
+        return false;
+    if (memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION ||
+        header.vertexSize != sizeof(Vertex) || header.materialSize != sizeof(MaterialRecord))
+        return false;
+
+    std::string path(header.pathLength, '\0');
+    std::string library, materialFile;
+    fin.read(path.data(), header.pathLength);
+    if (!fin || path != OBJfile || !readString(fin, library) || !readString(fin, materialFile))
+        return false;
+
+    //the .mtl is baked in as well: the same one must still be found, unchanged
+    bool touched = false;
+    if (!sameSource(OBJfile, header.sourceTime, header.sourceHash, touched) || findOBJMaterialFile(library) != materialFile ||
+        (!materialFile.empty() && !sameSource(materialFile, header.materialTime, header.materialHash, touched)))
+        return false;
+
+    //counts from a damaged file must not size the allocations below
+    uint64_t dataBytes = (uint64_t)header.nrOfVertices * sizeof(Vertex) + (uint64_t)header.nrOfIndices * sizeof(GLuint) +
+        (uint64_t)header.nrOfRanges * sizeof(MaterialRange) + (uint64_t)header.nrOfMaterials * sizeof(MaterialRecord);
+    if ((uint64_t)fin.tellg() + dataBytes > fileSize)
+        return false;
+
+    mesh.vertices.resize(header.nrOfVertices);
+    mesh.indices.resize(header.nrOfIndices);
+    mesh.materials.resize(header.nrOfMaterials);
+    mesh.ranges.resize(header.nrOfRanges);
+    fin.read((char*)mesh.vertices.data(), (std::streamsize)header.nrOfVertices * sizeof(Vertex));
+    fin.read((char*)mesh.indices.data(), (std::streamsize)header.nrOfIndices * sizeof(GLuint));
+    fin.read((char*)mesh.ranges.data(), (std::streamsize)header.nrOfRanges * sizeof(MaterialRange));
+    for (Material& material : mesh.materials)
+    {
+        MaterialRecord record;
+        if (!fin.read((char*)&record, sizeof(record)) || !readString(fin, material.name) || !readString(fin, material.diffuseMap) ||
+            !readString(fin, material.specularMap) || !readString(fin, material.bumpMap))
+            return false;
+        material.ambient = record.ambient;
+        material.diffuse = record.diffuse;
+        material.specular = record.specular;
+        material.shininess = record.shininess;
+        material.opacity = record.opacity;
+        material.illum = record.illum;
+    }
+    if (!fin)
+        return false;
+    mesh.materialLibrary = library;
+
+    //nothing may point past the buffers it is drawn from
+    for (GLuint index : mesh.indices)
+    {
+        if (index >= header.nrOfVertices)
+            return false;
+    }
+    for (const MaterialRange& range : mesh.ranges)
+    {
+        if ((uint64_t)range.firstIndex + range.count > header.nrOfIndices)
+            return false;
+    }
+
+    if (touched)
+    {
+        fin.close();
+        std::fstream fout(MeshCachePath(OBJfile), std::ios::binary | std::ios::in | std::ios::out);
+        fout.write((const char*)&header, sizeof(header));
+    }
+
+    //debug
+    std::cout << "Mesh cache " << MeshCachePath(OBJfile) << " loaded with " << mesh.vertices.size() << " vertices!\n";
+    return true;
+}
+
+bool SaveMeshCache(const std::string& OBJfile, const OBJIndexedMesh& mesh)
+{
+    //padding included, so no stack garbage ends up in the file
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    std::string bytes;
+    if (!readOBJBytes(OBJfile.c_str(), bytes) || !sourceKey(OBJfile, header.sourceTime))
+        return false;
+    header.sourceHash = HashBytes(bytes.data(), bytes.size());
+    std::string materialFile = findOBJMaterialFile(mesh.materialLibrary);
+    if (!materialFile.empty())
+    {
+        if (!readOBJBytes(materialFile.c_str(), bytes) || !sourceKey(materialFile, header.materialTime))
+            return false;
+        header.materialHash = HashBytes(bytes.data(), bytes.size());
+    }
+
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.materialSize = sizeof(MaterialRecord);
+    header.pathLength = (uint32_t)OBJfile.size();
+    header.nrOfVertices = (uint32_t)mesh.vertices.size();
+    header.nrOfIndices = (uint32_t)mesh.indices.size();
+    header.nrOfMaterials = (uint32_t)mesh.materials.size();
+    header.nrOfRanges = (uint32_t)mesh.ranges.size();
+
+    std::ofstream fout(MeshCachePath(OBJfile), std::ios::binary | std::ios::trunc);
+    if (!fout.is_open())
+        return false;
+    fout.write((const char*)&header, sizeof(header));
+    fout.write(OBJfile.data(), OBJfile.size());
+    writeString(fout, mesh.materialLibrary);
+    writeString(fout, materialFile);
+    fout.write((const char*)mesh.vertices.data(), (std::streamsize)mesh.vertices.size() * sizeof(Vertex));
+    fout.write((const char*)mesh.indices.data(), (std::streamsize)mesh.indices.size() * sizeof(GLuint));
+    fout.write((const char*)mesh.ranges.data(), (std::streamsize)mesh.ranges.size() * sizeof(MaterialRange));
+    for (const Material& material : mesh.materials)
+    {
+        MaterialRecord record = { material.ambient, material.diffuse, material.specular, material.shininess, material.opacity,
+            material.illum };
+        fout.write((const char*)&record, sizeof(record));
+        writeString(fout, material.name);
+        writeString(fout, material.diffuseMap);
+        writeString(fout, material.specularMap);
+        writeString(fout, material.bumpMap);
+    }
+    return (bool)fout;
+}
+
+OBJIndexedMesh LoadMeshData(const std::string& OBJfile)
+{
+    OBJIndexedMesh mesh;
+    if (!LoadMeshCache(OBJfile, mesh))
+    {
+        mesh = loadOBJIndexed(OBJfile.c_str());
+        SaveMeshCache(OBJfile, mesh);
+    }
+    return mesh;
+}
+
+void CookMeshCaches(const std::string& directory)
+{
+    for (const std::string& file : findOBJFiles(directory))
+    {
+        OBJIndexedMesh mesh = loadOBJIndexed(file.c_str());
+        if (SaveMeshCache(file, mesh))
+            std::cout << "Wrote " << MeshCachePath(file) << '\n';
+        else
+            std::cout << "Failed to write " << MeshCachePath(file) << '\n';
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include "OBJLoader.h"
+
+//.mgmesh files sit next to their .obj and hold the arrays Mesh::initVAO uploads
+std::string MeshCachePath(const std::string& OBJfile);
+bool LoadMeshCache(const std::string& OBJfile, OBJIndexedMesh& mesh);
+bool SaveMeshCache(const std::string& OBJfile, const OBJIndexedMesh& mesh);
+//cache hit or parse + write back; no GL calls, safe on loader threads
+OBJIndexedMesh LoadMeshData(const std::string& OBJfile);
+
+//offline converter: writes a fresh .mgmesh for every .obj under directory
+void CookMeshCaches(const std::string& directory);
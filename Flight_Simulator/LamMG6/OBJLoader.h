@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <fstream>
@@ -6,12 +7,41 @@
 #include "MTLLoader.h"
 #include <sstream>
 #include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <filesystem>
+#include <unordered_map>
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
 #include <GL/glew.h>
 #include "Vertex.h"
 
+//mtllib is looked up next to the executable first, then in AA/; empty when neither has it
+static std::string findOBJMaterialFile(const std::string& materialName)
+{
+	if (materialName.empty())
+		return std::string();
+	if (std::filesystem::is_regular_file(materialName))
+		return materialName;
+	if (std::filesystem::is_regular_file("AA/" + materialName))
+		return "AA/" + materialName;
+	return std::string();
+}
+
+static std::vector<Material> loadOBJMaterials(const std::string& materialName)
+{
+	std::string materialFile = findOBJMaterialFile(materialName);
+	if (materialFile.empty())
+	{
+		if (!materialName.empty())
+			std::cout << "AA/" << materialName << " not found!\n";
+		return std::vector<Material>();
+	}
+	return loadMTL(materialFile.c_str());
+}
+
 static std::pair <std::vector<Vertex>, std::vector<Material>> loadOBJ(const char* file_name)
 {
 	//vertex vectors
@@ -24,6 +54,8 @@ static std::pair <std::vector<Vertex>, std::vector<Material>> loadOBJ(const char
 	std::vector<GLint> vertex_texcoord_indices;
 	std::vector<GLint> vertex_normal_indices;
 	std::vector<GLint> color_indices;
+	//corners of the face being read
+	std::vector<GLint> face_position, face_texcoord, face_normal;
 
 	//Vertex array
 	std::vector<Vertex> vertices;
@@ -75,19 +107,19 @@ static std::pair <std::vector<Vertex>, std::vector<Material>> loadOBJ(const char
 		else
 	    if (prefix == "f")
 	    {
+			face_position.clear();
+			face_texcoord.clear();
+			face_normal.clear();
 			int counter = 0;
 			while (ss >> temp_glint)
 			{
 				//indices into correct arrays
 				if (counter == 0)
-				{
-					vertex_position_indices.push_back(temp_glint);
-					color_indices.push_back(matNumber);
-				}
+					face_position.push_back(temp_glint);
 				else if (counter == 1)
-					vertex_texcoord_indices.push_back(temp_glint);
+					face_texcoord.push_back(temp_glint);
 				else if (counter == 2)
-					vertex_normal_indices.push_back(temp_glint);
+					face_normal.push_back(temp_glint);
 
 				//characters
 				if (ss.peek() == '/')
@@ -107,6 +139,19 @@ static std::pair <std::vector<Vertex>, std::vector<Material>> loadOBJ(const char
 					counter = 0;
 				}
 			}
+			//quads and other polygons as a fan around the first corner
+			for (size_t k = 1; k + 1 < face_position.size(); k++)
+			{
+				for (size_t corner : { (size_t)0, k, k + 1 })
+				{
+					vertex_position_indices.push_back(face_position[corner]);
+					if (corner < face_texcoord.size())
+						vertex_texcoord_indices.push_back(face_texcoord[corner]);
+					if (corner < face_normal.size())
+						vertex_normal_indices.push_back(face_normal[corner]);
+					color_indices.push_back(matNumber);
+				}
+			}
 		}
 		else if (prefix == "usemtl")
 		{
@@ -128,27 +173,427 @@ static std::pair <std::vector<Vertex>, std::vector<Material>> loadOBJ(const char
 
 	//debug
 	std::cout << "OBJ file "  << file_name << " loaded successfully with " << vertices.size() << "vertices" << "!\n";
-	std::vector <Material> materials;
-	std::ifstream mat(materialName);
-	if (!mat.is_open())
-	{
-		mat.close();
-		materialName = "AA/" + materialName;
-		std::ifstream mat2(materialName);
-		if (!mat2.is_open())
+	return std::make_pair(vertices, loadOBJMaterials(materialName));
+}
+
+//every .obj under directory, skipping build folders full of MSVC object files
+static std::vector<std::string> findOBJFiles(const std::string& directory)
+{
+	std::vector<std::string> files;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".obj")
+			continue;
+		bool buildOutput = false;
+		for (const std::filesystem::path& part : entry.path())
 		{
-			std::cout << materialName << " not found!";
+			if (part == "Debug" || part == "Release" || part == "x64")
+				buildOutput = true;
 		}
-		else
+		if (!buildOutput)
+			files.push_back(entry.path().string());
+	}
+	return files;
+}
+
+//whole file in one read, the tokenizer below walks it with raw pointers
+static bool readOBJBytes(const char* file_name, std::string& bytes)
+{
+	std::ifstream fin(file_name, std::ios::binary | std::ios::ate);
+	if (!fin.is_open())
+		return false;
+	std::streamoff size = fin.tellg();
+	bytes.resize((size_t)size);
+	fin.seekg(0, std::ios::beg);
+	fin.read(bytes.data(), size);
+	return true;
+}
+
+static inline const char* skipOBJSpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p;
+}
+
+static inline const char* parseOBJFloat(const char* p, const char* end, float& value)
+{
+	p = skipOBJSpaces(p, end);
+	if (p < end && *p == '+')
+		p++;
+	std::from_chars_result res = std::from_chars(p, end, value);
+	return res.ptr;
+}
+
+//raw attribute and face-corner arrays of an OBJ file, before any vertex is built
+struct OBJRecords
+{
+	//vertex vectors
+	std::vector<glm::fvec3> vertex_position;
+	std::vector<glm::fvec3> vertex_normal;
+	std::vector<glm::fvec2> vertex_texcoord;
+
+	//face vectors
+	std::vector<GLint> vertex_position_indices;
+	std::vector<GLint> vertex_texcoord_indices;
+	std::vector<GLint> vertex_normal_indices;
+	std::vector<GLint> color_indices;
+
+	std::string materialName;
+	//the name of every usemtl, color_indices count them in order
+	std::vector<std::string> materialUses;
+};
+
+//vertex for face corner i, with the same conventions as loadOBJ
+static inline Vertex makeOBJVertex(const OBJRecords& rec, size_t i)
+{
+	Vertex vertex = Vertex();
+	vertex.position = rec.vertex_position[rec.vertex_position_indices[i] - 1];
+	vertex.texcoord = rec.vertex_texcoord[rec.vertex_texcoord_indices[i] - 1];
+	vertex.normal = -0.5f * rec.vertex_normal[rec.vertex_normal_indices[i] - 1];
+	vertex.colorID = rec.color_indices[i];
+	vertex.color = glm::vec3(1.0f, 0.0f, 1.0f);
+	return vertex;
+}
+
+static bool parseOBJRecords(const char* file_name, OBJRecords& rec)
+{
+	std::string bytes;
+	if (!readOBJBytes(file_name, bytes))
+	{
+		std::cout << "Failed to load " << file_name << '\n';
+		return false;
+	}
+	const char* begin = bytes.data();
+	const char* end = begin + bytes.size();
+
+	//pre-scan: count records, and the triangle corners each face fans into, so nothing below reallocates
+	size_t nrPositions = 0, nrTexcoords = 0, nrNormals = 0, nrCorners = 0;
+	for (const char* p = begin; p < end; )
+	{
+		p = skipOBJSpaces(p, end);
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		const char* lineEnd = eol ? eol : end;
+		if (end - p > 1)
+		{
+			if (p[0] == 'v' && p[1] == ' ') nrPositions++;
+			else if (p[0] == 'v' && p[1] == 't') nrTexcoords++;
+			else if (p[0] == 'v' && p[1] == 'n') nrNormals++;
+			else if (p[0] == 'f' && p[1] == ' ')
+			{
+				size_t nrFaceCorners = 0;
+				for (const char* q = skipOBJSpaces(p + 1, lineEnd); q < lineEnd; q = skipOBJSpaces(q, lineEnd))
+				{
+					nrFaceCorners++;
+					while (q < lineEnd && *q != ' ' && *q != '\t' && *q != '\r')
+						q++;
+				}
+				if (nrFaceCorners > 2)
+					nrCorners += (nrFaceCorners - 2) * 3;
+			}
+		}
+		p = eol ? eol + 1 : end;
+	}
+
+	rec.vertex_position.reserve(nrPositions);
+	rec.vertex_normal.reserve(nrNormals);
+	rec.vertex_texcoord.reserve(nrTexcoords);
+	rec.vertex_position_indices.reserve(nrCorners);
+	rec.vertex_texcoord_indices.reserve(nrCorners);
+	rec.vertex_normal_indices.reserve(nrCorners);
+	rec.color_indices.reserve(nrCorners);
+
+	GLint matNumber = -1;
+	//corners of the face being read
+	std::vector<GLint> face_position, face_texcoord, face_normal;
+	const char* p = begin;
+	while (p < end)
+	{
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		const char* lineEnd = eol ? eol : end;
+
+		//get prefix
+		p = skipOBJSpaces(p, lineEnd);
+		const char* prefixEnd = p;
+		while (prefixEnd < lineEnd && *prefixEnd != ' ' && *prefixEnd != '\t' && *prefixEnd != '\r')
+			prefixEnd++;
+		std::string_view prefix(p, prefixEnd - p);
+		p = prefixEnd;
+
+		if (prefix == "mtllib")
+		{
+			p = skipOBJSpaces(p, lineEnd);
+			const char* nameEnd = p;
+			while (nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t' && *nameEnd != '\r')
+				nameEnd++;
+			rec.materialName.assign(p, nameEnd);
+		}
+		else if (prefix == "v")
+		{
+			glm::vec3 temp_vec3;
+			p = parseOBJFloat(p, lineEnd, temp_vec3.x);
+			p = parseOBJFloat(p, lineEnd, temp_vec3.y);
+			p = parseOBJFloat(p, lineEnd, temp_vec3.z);
+			rec.vertex_position.push_back(temp_vec3);
+		}
+		else if (prefix == "vt")
+		{
+			glm::vec2 temp_vec2;
+			p = parseOBJFloat(p, lineEnd, temp_vec2.x);
+			p = parseOBJFloat(p, lineEnd, temp_vec2.y);
+			rec.vertex_texcoord.push_back(temp_vec2);
+		}
+		else if (prefix == "vn")
+		{
+			glm::vec3 temp_vec3;
+			p = parseOBJFloat(p, lineEnd, temp_vec3.x);
+			p = parseOBJFloat(p, lineEnd, temp_vec3.y);
+			p = parseOBJFloat(p, lineEnd, temp_vec3.z);
+			rec.vertex_normal.push_back(temp_vec3);
+		}
+		else if (prefix == "f")
+		{
+			//same v/vt/vn cycling and fan as loadOBJ
+			face_position.clear();
+			face_texcoord.clear();
+			face_normal.clear();
+			int counter = 0;
+			while (true)
+			{
+				p = skipOBJSpaces(p, lineEnd);
+				GLint temp_glint;
+				std::from_chars_result res = std::from_chars(p, lineEnd, temp_glint);
+				if (res.ec != std::errc())
+					break;
+				p = res.ptr;
+
+				if (counter == 0)
+					face_position.push_back(temp_glint);
+				else if (counter == 1)
+					face_texcoord.push_back(temp_glint);
+				else if (counter == 2)
+					face_normal.push_back(temp_glint);
+
+				if (p < lineEnd && (*p == '/' || *p == ' '))
+				{
+					counter++;
+					p++;
+				}
+
+				if (counter > 2)
+				{
+					counter = 0;
+				}
+			}
+			for (size_t k = 1; k + 1 < face_position.size(); k++)
+			{
+				for (size_t corner : { (size_t)0, k, k + 1 })
+				{
+					rec.vertex_position_indices.push_back(face_position[corner]);
+					if (corner < face_texcoord.size())
+						rec.vertex_texcoord_indices.push_back(face_texcoord[corner]);
+					if (corner < face_normal.size())
+						rec.vertex_normal_indices.push_back(face_normal[corner]);
+					rec.color_indices.push_back(matNumber);
+				}
+			}
+		}
+		else if (prefix == "usemtl")
+		{
+			p = skipOBJSpaces(p, lineEnd);
+			const char* nameEnd = p;
+			while (nameEnd < lineEnd && *nameEnd != ' ' && *nameEnd != '\t' && *nameEnd != '\r')
+				nameEnd++;
+			rec.materialUses.emplace_back(p, nameEnd);
+			matNumber++;
+		}
+
+		p = eol ? eol + 1 : end;
+	}
+
+	return true;
+}
+
+//color_indices count usemtl lines; point each at the material of that name instead, so
+//a material used twice is one material. Uses naming no material keep their number.
+static void mapOBJMaterialUses(OBJRecords& rec, const std::vector<Material>& materials)
+{
+	std::vector<GLint> material(rec.materialUses.size());
+	bool identity = true;
+	for (size_t use = 0; use < rec.materialUses.size(); use++)
+	{
+		material[use] = (GLint)use;
+		for (size_t i = 0; i < materials.size(); i++)
 		{
-			mat.close();
-			materials = loadMTL(materialName.c_str());
+			if (materials[i].name == rec.materialUses[use])
+			{
+				material[use] = (GLint)i;
+				break;
+			}
 		}
+		identity = identity && material[use] == (GLint)use;
 	}
-	else
+	if (identity)
+		return;
+	for (GLint& index : rec.color_indices)
 	{
-			mat.close();
-			materials = loadMTL(materialName.c_str());
+		if (index >= 0)
+			index = material[index];
 	}
-	return std::make_pair(vertices, materials);
+}
+
+static std::pair <std::vector<Vertex>, std::vector<Material>> loadOBJFast(const char* file_name)
+{
+	OBJRecords rec;
+	if (!parseOBJRecords(file_name, rec))
+		return std::make_pair(std::vector<Vertex>(), std::vector <Material>());
+
+	//colorIDs by material name, as loadOBJIndexed numbers them
+	std::vector<Material> materials = loadOBJMaterials(rec.materialName);
+	mapOBJMaterialUses(rec, materials);
+
+	//Load in all indices
+	std::vector<Vertex> vertices;
+	vertices.reserve(rec.vertex_position_indices.size());
+	for (size_t i = 0; i < rec.vertex_position_indices.size(); i++)
+		vertices.push_back(makeOBJVertex(rec, i));
+
+	//debug
+	std::cout << "OBJ file "  << file_name << " loaded successfully with " << vertices.size() << "vertices" << "!\n";
+	return std::make_pair(std::move(vertices), std::move(materials));
+}
+
+//bytes of vertices, indices and materials duplicated by copying an OBJIndexedMesh;
+//loading only moves the data, parser to loader to Mesh, so this stays 0
+inline std::atomic<size_t> meshBytesCopied{ 0 };
+
+struct OBJIndexedMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	std::vector<Material> materials;
+	//one per material used, in index order
+	std::vector<MaterialRange> ranges;
+	//mtllib as the file names it, the mesh cache checks the .mtl found for it
+	std::string materialLibrary;
+
+	OBJIndexedMesh() = default;
+	OBJIndexedMesh(OBJIndexedMesh&&) noexcept = default;
+	OBJIndexedMesh& operator=(OBJIndexedMesh&&) noexcept = default;
+	//still allowed (the loader benchmarks compare copies) but counted
+	OBJIndexedMesh(const OBJIndexedMesh& other)
+		: vertices(other.vertices), indices(other.indices), materials(other.materials), ranges(other.ranges),
+		materialLibrary(other.materialLibrary)
+	{
+		meshBytesCopied += other.bytes();
+	}
+	OBJIndexedMesh& operator=(const OBJIndexedMesh& other)
+	{
+		vertices = other.vertices;
+		indices = other.indices;
+		materials = other.materials;
+		ranges = other.ranges;
+		materialLibrary = other.materialLibrary;
+		meshBytesCopied += other.bytes();
+		return *this;
+	}
+	size_t bytes() const
+	{
+		return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(GLuint) + materials.size() * sizeof(Material) +
+			ranges.size() * sizeof(MaterialRange);
+	}
+};
+
+//(position, texcoord, normal, material) of one face corner
+struct OBJCornerKey
+{
+	GLint position, texcoord, normal, material;
+	bool operator==(const OBJCornerKey& other) const
+	{
+		return position == other.position && texcoord == other.texcoord && normal == other.normal && material == other.material;
+	}
+};
+
+struct OBJCornerHash
+{
+	size_t operator()(const OBJCornerKey& key) const
+	{
+		size_t h = (size_t)(uint32_t)key.position * 0x9E3779B1u;
+		h ^= (size_t)(uint32_t)key.texcoord * 0x85EBCA77u + (h << 6) + (h >> 2);
+		h ^= (size_t)(uint32_t)key.normal * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+		h ^= (size_t)(uint32_t)key.material + (h << 6) + (h >> 2);
+		return h;
+	}
+};
+
+//reorders the triangles so each material's are contiguous, file order kept within
+//one material, and records the ranges; cornerMaterials has the material of every index
+static void groupOBJTrianglesByMaterial(OBJIndexedMesh& mesh, const std::vector<GLint>& cornerMaterials)
+{
+	mesh.ranges.clear();
+	if (mesh.indices.empty())
+		return;
+	size_t nrOfTriangles = mesh.indices.size() / 3;
+	if (nrOfTriangles * 3 != mesh.indices.size())
+	{
+		//not all triangles, left as one range
+		mesh.ranges.push_back({ 0, (GLuint)mesh.indices.size(), cornerMaterials[0] });
+		return;
+	}
+
+	//counting sort on material + 1, so faces before any usemtl (-1) come first
+	GLint maxMaterial = *std::max_element(cornerMaterials.begin(), cornerMaterials.end());
+	std::vector<GLuint> starts((size_t)maxMaterial + 3, 0);
+	for (size_t t = 0; t < nrOfTriangles; t++)
+		starts[(size_t)cornerMaterials[t * 3] + 2] += 3;
+	for (size_t slot = 1; slot < starts.size(); slot++)
+		starts[slot] += starts[slot - 1];
+	for (size_t slot = 0; slot + 1 < starts.size(); slot++)
+	{
+		if (starts[slot + 1] != starts[slot])
+			mesh.ranges.push_back({ starts[slot], starts[slot + 1] - starts[slot], (GLint)slot - 1 });
+	}
+	if (mesh.ranges.size() == 1)
+		return;
+	std::vector<GLuint> grouped(mesh.indices.size());
+	for (size_t t = 0; t < nrOfTriangles; t++)
+	{
+		GLuint& next = starts[(size_t)cornerMaterials[t * 3] + 1];
+		std::copy(mesh.indices.begin() + t * 3, mesh.indices.begin() + t * 3 + 3, grouped.begin() + next);
+		next += 3;
+	}
+	mesh.indices.swap(grouped);
+}
+
+//every face corner becomes an index, identical corners share one vertex; the triangles
+//are grouped into one range per material
+static OBJIndexedMesh loadOBJIndexed(const char* file_name)
+{
+	OBJIndexedMesh mesh;
+	OBJRecords rec;
+	if (!parseOBJRecords(file_name, rec))
+		return mesh;
+
+	mesh.materialLibrary = rec.materialName;
+	mesh.materials = loadOBJMaterials(rec.materialName);
+	mapOBJMaterialUses(rec, mesh.materials);
+
+	size_t nrOfCorners = rec.vertex_position_indices.size();
+	std::unordered_map<OBJCornerKey, GLuint, OBJCornerHash> unique;
+	unique.reserve(nrOfCorners);
+	mesh.indices.reserve(nrOfCorners);
+	for (size_t i = 0; i < nrOfCorners; i++)
+	{
+		OBJCornerKey key = { rec.vertex_position_indices[i], rec.vertex_texcoord_indices[i], rec.vertex_normal_indices[i], rec.color_indices[i] };
+		auto found = unique.try_emplace(key, (GLuint)mesh.vertices.size());
+		if (found.second)
+			mesh.vertices.push_back(makeOBJVertex(rec, i));
+		mesh.indices.push_back(found.first->second);
+	}
+	groupOBJTrianglesByMaterial(mesh, rec.color_indices);
+
+	//debug
+	std::cout << "OBJ file " << file_name << " loaded successfully with " << mesh.vertices.size() << " unique of "
+		<< nrOfCorners << " vertices (dedup " << (mesh.vertices.empty() ? 0.0 : (double)nrOfCorners / mesh.vertices.size()) << "x)!\n";
+	return mesh;
 }
\ No newline at end of file
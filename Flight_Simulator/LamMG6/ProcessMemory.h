@@ -0,0 +1,5 @@
+#pragma once
+#include <cstddef>
+
+//the most memory the process has had resident at once, in bytes
+size_t PeakResidentBytes();
@@ -0,0 +1,40 @@
+#include "RenderQueue.h"
+#include <algorithm>
+
+void RenderQueue::clear()
+{
+    items.clear();
+}
+
+void RenderQueue::push(Shader* shader, unsigned int texture, Mesh* mesh)
+{
+    items.push_back({ shader, texture, mesh });
+}
+
+void RenderQueue::sort()
+{
+    std::stable_sort(items.begin(), items.end(), [](const RenderItem& a, const RenderItem& b) {
+        if (a.shader->shaderIndex != b.shader->shaderIndex)
+            return a.shader->shaderIndex < b.shader->shaderIndex;
+        if (a.texture != b.texture)
+            return a.texture < b.texture;
+        return a.mesh->getVAO() < b.mesh->getVAO();
+    });
+}
+
+void RenderQueue::draw(const Frustum* frustum)
+{
+    Shader* shader = nullptr;
+    for (RenderItem& item : items)
+    {
+        if (frustum != nullptr && !item.mesh->isVisible(*frustum))
+            continue;
+        if (item.shader != shader)
+        {
+            shader = item.shader;
+            shader->Use();
+        }
+        //the mesh binds its material maps or texture itself, glState drops the repeats
+        item.mesh->render(shader);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include "Mesh.h"
+#include "Shader.h"
+#include "Frustum.h"
+
+struct RenderItem
+{
+	Shader* shader;
+	unsigned int texture;
+	Mesh* mesh;
+};
+
+//Draws sorted by shader, then texture, then VAO, so each switch happens
+//once per bucket instead of being decided per object.
+class RenderQueue
+{
+private:
+	std::vector<RenderItem> items;
+
+public:
+	void clear();
+	//texture is the one the mesh draws with first (Mesh::getTexture), only sorted by
+	void push(Shader* shader, unsigned int texture, Mesh* mesh);
+	void sort();
+	//items outside frustum are skipped, nullptr draws everything
+	void draw(const Frustum* frustum = nullptr);
+	size_t size() const { return items.size(); }
+};
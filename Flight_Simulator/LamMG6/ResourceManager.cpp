@@ -0,0 +1,221 @@
+#include "ResourceManager.h"
+#include "GLState.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t HashMeshData(const OBJIndexedMesh& mesh)
+{
+    uint64_t hash = HashBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+    hash = HashBytes(mesh.indices.data(), mesh.indices.size() * sizeof(GLuint), hash);
+    hash = HashBytes(mesh.ranges.data(), mesh.ranges.size() * sizeof(MaterialRange), hash);
+    for (const Material& material : mesh.materials)
+    {
+        hash = HashBytes(&material.ambient, sizeof(material.ambient), hash);
+        hash = HashBytes(&material.diffuse, sizeof(material.diffuse), hash);
+        hash = HashBytes(&material.specular, sizeof(material.specular), hash);
+        hash = HashBytes(&material.shininess, sizeof(material.shininess), hash);
+        hash = HashBytes(&material.opacity, sizeof(material.opacity), hash);
+        hash = HashBytes(&material.illum, sizeof(material.illum), hash);
+        //the terminator keeps "a" + "bc" apart from "ab" + "c"
+        for (const std::string* text : { &material.name, &material.diffuseMap, &material.specularMap, &material.bumpMap })
+            hash = HashBytes(text->data(), text->size() + 1, hash);
+    }
+    return hash;
+}
+
+uint64_t HashTextureData(const TextureData& data)
+{
+    uint64_t hash = HashBytes(&data.cooked.format, sizeof(data.cooked.format));
+    for (const CookedLevel& level : data.cooked.levels)
+        hash = HashBytes(level.blocks.data(), level.blocks.size(), hash);
+    const TextureImage& image = data.image;
+    int dimensions[3] = { image.width, image.height, image.nrChannels };
+    hash = HashBytes(dimensions, sizeof(dimensions), hash);
+    if (image.data != nullptr)
+        hash = HashBytes(image.data, (size_t)image.width * image.height * image.nrChannels, hash);
+    return hash;
+}
+
+Texture::~Texture()
+{
+    if (name != 0)
+        glState.deleteTexture(name);
+}
+
+template <typename T>
+std::shared_ptr<T> ResourceManager::resident(const std::map<uint64_t, Entry<T>>& entries, uint64_t key)
+{
+    auto entry = entries.find(key);
+    return entry == entries.end() ? nullptr : entry->second.resource.lock();
+}
+
+//a layout is part of what goes to the GPU, the same file in two layouts is two resources
+static uint64_t LayoutKey(uint64_t hash, VertexLayout layout)
+{
+    return HashBytes(&layout, sizeof(layout), hash);
+}
+
+bool ResourceManager::meshKey(const std::string& OBJfile, VertexLayout layout, uint64_t& key) const
+{
+    auto known = pathHashes.find(OBJfile);
+    if (known == pathHashes.end())
+        return false;
+    key = LayoutKey(known->second, layout);
+    return true;
+}
+
+void ResourceManager::queueMesh(const std::string& OBJfile, AssetLoader& loader, VertexLayout layout) const
+{
+    uint64_t key;
+    if (meshKey(OBJfile, layout, key) && resident(meshes, key))
+        return;
+    loader.queueMesh(OBJfile);
+}
+
+void ResourceManager::queueTexture(const std::string& path, AssetLoader& loader) const
+{
+    auto known = pathHashes.find(path);
+    if (known != pathHashes.end() && resident(textures, known->second))
+        return;
+    loader.queueTexture(path);
+}
+
+std::shared_ptr<MeshGeometry> ResourceManager::acquireMesh(const std::string& OBJfile, AssetLoader* loader, VertexLayout layout)
+{
+    uint64_t key;
+    if (meshKey(OBJfile, layout, key))
+    {
+        if (std::shared_ptr<MeshGeometry> geometry = resident(meshes, key))
+        {
+            pathHits++;
+            return geometry;
+        }
+    }
+
+    OBJIndexedMesh data = loader != nullptr ? loader->takeMesh(OBJfile) : LoadMeshData(OBJfile);
+    loads++;
+    uint64_t hash = HashMeshData(data);
+    pathHashes[OBJfile] = hash;
+    Entry<MeshGeometry>& entry = meshes[LayoutKey(hash, layout)];
+    if (std::shared_ptr<MeshGeometry> geometry = entry.resource.lock())
+    {
+        contentHits++;
+        if (std::find(entry.paths.begin(), entry.paths.end(), OBJfile) == entry.paths.end())
+            entry.paths.push_back(OBJfile);
+        return geometry;
+    }
+    std::shared_ptr<MeshGeometry> geometry = std::make_shared<MeshGeometry>(std::move(data), layout);
+    entry.paths.assign(1, OBJfile);
+    entry.resource = geometry;
+    return geometry;
+}
+
+std::shared_ptr<Texture> ResourceManager::acquireTexture(const std::string& path, AssetLoader* loader)
+{
+    auto known = pathHashes.find(path);
+    if (known != pathHashes.end())
+    {
+        if (std::shared_ptr<Texture> texture = resident(textures, known->second))
+        {
+            pathHits++;
+            return texture;
+        }
+    }
+
+    TextureData data = loader != nullptr ? loader->takeTextureData(path) : LoadTextureData(path);
+    loads++;
+    uint64_t hash = HashTextureData(data);
+    pathHashes[path] = hash;
+    Entry<Texture>& entry = textures[hash];
+    if (std::shared_ptr<Texture> texture = entry.resource.lock())
+    {
+        contentHits++;
+        if (data.image.data != nullptr)
+            stbi_image_free(data.image.data);
+        if (std::find(entry.paths.begin(), entry.paths.end(), path) == entry.paths.end())
+            entry.paths.push_back(path);
+        return texture;
+    }
+
+    size_t bytes = 0;
+    for (const CookedLevel& level : data.cooked.levels)
+        bytes += level.blocks.size();
+    //uploads expand to four channels, the mip chain adds a third
+    if (data.cooked.levels.empty())
+        bytes = (size_t)data.image.width * data.image.height * 4 * 4 / 3;
+    unsigned int name = loader != nullptr ? loader->uploadTexture(path, data) : UploadTextureData(data);
+    std::shared_ptr<Texture> texture = std::make_shared<Texture>(name, bytes);
+    entry.paths.assign(1, path);
+    entry.resource = texture;
+    return texture;
+}
+
+void ResourceManager::queueMaterialMaps(const MeshGeometry& geometry, AssetLoader& loader) const
+{
+    if (!geometry.maps.empty())
+        return;
+    for (const Material& material : geometry.materials)
+    {
+        if (!material.diffuseMap.empty())
+            queueTexture(material.diffuseMap, loader);
+    }
+}
+
+void ResourceManager::acquireMaterialMaps(MeshGeometry& geometry, AssetLoader* loader)
+{
+    if (!geometry.maps.empty())
+        return;
+    geometry.maps.resize(geometry.materials.size());
+    for (size_t i = 0; i < geometry.materials.size(); i++)
+    {
+        const Material& material = geometry.materials[i];
+        if (!material.diffuseMap.empty())
+            geometry.maps[i].diffuse = acquireTexture(material.diffuseMap, loader);
+    }
+}
+
+void ResourceManager::report() const
+{
+    size_t totalCPU = 0, totalGPU = 0;
+    //formatted on the side, std::cout keeps its own flags
+    std::ostringstream out;
+    out << std::left << std::setw(8) << "kind" << std::setw(44) << "paths" << std::right << std::setw(10) << "CPU KB"
+        << std::setw(10) << "GPU KB" << std::setw(8) << "refs" << '\n';
+    auto line = [&](const char* kind, const std::vector<std::string>& paths, size_t cpu, size_t gpu, long refs) {
+        std::string names = paths.front();
+        for (size_t i = 1; i < paths.size(); i++)
+            names += ", " + paths[i];
+        out << std::left << std::setw(8) << kind << std::setw(44) << names << std::right << std::setw(10) << cpu / 1024
+            << std::setw(10) << gpu / 1024 << std::setw(8) << refs << '\n';
+        totalCPU += cpu;
+        totalGPU += gpu;
+    };
+    for (const auto& mesh : meshes)
+    {
+        //the lock itself is one more reference
+        if (std::shared_ptr<MeshGeometry> geometry = mesh.second.resource.lock())
+            line("mesh", mesh.second.paths, geometry->getResidentBytes(), geometry->getGPUBytes(), geometry.use_count() - 1);
+    }
+    for (const auto& texture : textures)
+    {
+        if (std::shared_ptr<Texture> resident = texture.second.resource.lock())
+            line("texture", texture.second.paths, 0, resident->getGPUBytes(), resident.use_count() - 1);
+    }
+    out << std::left << std::setw(52) << "total" << std::right << std::setw(10) << totalCPU / 1024 << std::setw(10)
+        << totalGPU / 1024 << '\n';
+    out << loads << " loads, " << pathHits << " shared by path, " << contentHits << " by content\n";
+    std::cout << out.str();
+}
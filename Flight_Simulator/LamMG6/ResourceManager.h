@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "AssetLoader.h"
+
+//64-bit FNV-1a; pass the previous result as seed to hash several arrays as one
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+//vertices, indices, ranges and materials, so files that differ only in names (Avion.obj and
+//Plane.obj point at different .mtl files with the same contents) hash the same
+uint64_t HashMeshData(const OBJIndexedMesh& mesh);
+//the cooked blocks or decoded pixels the upload would use
+uint64_t HashTextureData(const TextureData& data);
+
+//One uploaded texture, deleted with the last handle to it.
+class Texture
+{
+private:
+	unsigned int name = 0;
+	size_t bytes = 0;
+
+public:
+	Texture(unsigned int name, size_t bytes) : name(name), bytes(bytes) {}
+	~Texture();
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	unsigned int get() const { return name; }
+	//mip chain included, an estimate for uncompressed images
+	size_t getGPUBytes() const { return bytes; }
+};
+
+//Hands out shared handles to mesh geometry and textures. A path seen before comes
+//back without loading anything; a new one is loaded (through the AssetLoader when
+//given) and hashed, so the same content under another name is shared as well.
+//Entries only hold weak references: a resource goes with its last handle.
+//Main thread only, like the GL uploads it does.
+class ResourceManager
+{
+private:
+	template <typename T>
+	struct Entry
+	{
+		std::vector<std::string> paths;
+		std::weak_ptr<T> resource;
+	};
+	//content hash of what each path loaded last
+	std::map<std::string, uint64_t> pathHashes;
+	//keyed by content hash, meshes with the vertex layout mixed in
+	std::map<uint64_t, Entry<MeshGeometry>> meshes;
+	std::map<uint64_t, Entry<Texture>> textures;
+	size_t loads = 0, pathHits = 0, contentHits = 0;
+
+	//the entry's resource while someone still holds it
+	template <typename T>
+	static std::shared_ptr<T> resident(const std::map<uint64_t, Entry<T>>& entries, uint64_t key);
+	//key of the mesh a path loaded last, false for new paths
+	bool meshKey(const std::string& OBJfile, VertexLayout layout, uint64_t& key) const;
+
+public:
+	//queues on the loader what isn't resident already
+	void queueMesh(const std::string& OBJfile, AssetLoader& loader, VertexLayout layout = VertexLayout::Compact) const;
+	void queueTexture(const std::string& path, AssetLoader& loader) const;
+	std::shared_ptr<MeshGeometry> acquireMesh(const std::string& OBJfile, AssetLoader* loader = nullptr,
+		VertexLayout layout = VertexLayout::Compact);
+	std::shared_ptr<Texture> acquireTexture(const std::string& path, AssetLoader* loader = nullptr);
+	//the map_Kd images of the geometry's materials: queued to decode in parallel, then
+	//acquired like any texture into geometry.maps (once per geometry)
+	void queueMaterialMaps(const MeshGeometry& geometry, AssetLoader& loader) const;
+	void acquireMaterialMaps(MeshGeometry& geometry, AssetLoader* loader = nullptr);
+
+	//files actually read, and acquires answered by path and by content
+	size_t getLoads() const { return loads; }
+	size_t getPathHits() const { return pathHits; }
+	size_t getContentHits() const { return contentHits; }
+	//every resident resource with its paths, CPU and GPU bytes and handles held
+	void report() const;
+};
+
+//the one every Scene and the main scene load through
+inline ResourceManager resources;
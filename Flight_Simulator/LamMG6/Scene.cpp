@@ -0,0 +1,146 @@
+#include "Scene.h"
+#include <fstream>
+#include <sstream>
+
+bool Scene::load(const std::string& path)
+{
+    std::ifstream fin(path);
+    if (!fin.is_open())
+    {
+        std::cout << "Failed to load scene: " << path << '\n';
+        return false;
+    }
+
+    objects.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(fin, line))
+    {
+        lineNumber++;
+        std::stringstream ss(line);
+        std::string prefix;
+        if (!(ss >> prefix) || prefix[0] == '#')
+            continue;
+
+        if (prefix == "object")
+        {
+            objects.emplace_back();
+            ss >> objects.back().mesh;
+            continue;
+        }
+        if (objects.empty())
+        {
+            std::cout << path << ':' << lineNumber << ": \"" << prefix << "\" before the first object\n";
+            continue;
+        }
+
+        SceneObject& object = objects.back();
+        if (prefix == "shader")
+            ss >> object.shader;
+        else if (prefix == "texture")
+            ss >> object.texture;
+        else if (prefix == "parent")
+            ss >> object.parent;
+        else if (prefix == "position")
+            ss >> object.position.x >> object.position.y >> object.position.z;
+        else if (prefix == "rotation")
+            ss >> object.rotation.x >> object.rotation.y >> object.rotation.z;
+        else if (prefix == "scale")
+            ss >> object.scale.x >> object.scale.y >> object.scale.z;
+        else if (prefix == "color")
+        {
+            std::pair<int, glm::vec3> color;
+            ss >> color.first >> color.second.x >> color.second.y >> color.second.z;
+            object.colors.push_back(color);
+        }
+        else if (prefix == "residency")
+        {
+            std::string residency;
+            ss >> residency;
+            if (residency == "discard")
+                object.residency = MeshResidency::Discard;
+            else if (residency == "positions")
+                object.residency = MeshResidency::Positions;
+            else if (residency == "full")
+                object.residency = MeshResidency::Full;
+            else
+                std::cout << path << ':' << lineNumber << ": unknown residency \"" << residency << "\"\n";
+        }
+        else
+            std::cout << path << ':' << lineNumber << ": unknown keyword \"" << prefix << "\"\n";
+
+        if (ss.fail())
+            std::cout << path << ':' << lineNumber << ": malformed \"" << prefix << "\" line\n";
+    }
+    return true;
+}
+
+void Scene::queue(AssetLoader& loader) const
+{
+    for (const SceneObject& object : objects)
+    {
+        resources.queueMesh(object.mesh, loader);
+        if (!object.texture.empty())
+            resources.queueTexture(object.texture, loader);
+    }
+}
+
+void Scene::init(AssetLoader& loader)
+{
+    //built in place from the loader's data; Mesh is move-only, the reserve just saves the moves
+    meshes.clear();
+    meshes.reserve(objects.size());
+    root = TransformNode(sceneTransforms);
+    //geometry first, so the maps its materials name decode in parallel
+    std::vector<std::shared_ptr<MeshGeometry>> geometries;
+    geometries.reserve(objects.size());
+    for (const SceneObject& object : objects)
+    {
+        geometries.push_back(resources.acquireMesh(object.mesh, &loader));
+        resources.queueMaterialMaps(*geometries.back(), loader);
+    }
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        const SceneObject& object = objects[i];
+        resources.acquireMaterialMaps(*geometries[i], &loader);
+        Mesh& mesh = meshes.emplace_back(std::move(geometries[i]));
+        TransformHandle parent = root.get();
+        if (!object.parent.empty())
+        {
+            //the last object before this one with that mesh
+            size_t above = i;
+            while (above > 0 && objects[above - 1].mesh != object.parent)
+                above--;
+            if (above > 0)
+                parent = meshes[above - 1].getTransform();
+            else
+                std::cout << "No object " << object.parent << " before " << object.mesh << " to attach it to\n";
+        }
+        mesh.setParent(parent);
+        mesh.setPosition(object.position);
+        mesh.setRotation(object.rotation);
+        mesh.setScale(object.scale);
+        for (const auto& color : object.colors)
+            mesh.setColor(color.first, color.second);
+        mesh.setResidency(object.residency);
+        mesh.initVAO();
+
+        if (!object.texture.empty())
+            mesh.setTexture(resources.acquireTexture(object.texture, &loader));
+    }
+}
+
+void Scene::submit(RenderQueue& queue, const std::map<std::string, Shader*>& shaders)
+{
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        auto shader = shaders.find(objects[i].shader);
+        if (shader == shaders.end())
+        {
+            std::cout << "Unknown shader \"" << objects[i].shader << "\" for " << objects[i].mesh << '\n';
+            continue;
+        }
+        queue.push(shader->second, meshes[i].getTexture(), &meshes[i]);
+    }
+}
+
@@ -0,0 +1,51 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "AssetLoader.h"
+#include "Mesh.h"
+#include "ResourceManager.h"
+#include "RenderQueue.h"
+
+//one "object" block of a .scene file
+struct SceneObject
+{
+	std::string mesh;
+	std::string shader = "basic";
+	//for the materials whose .mtl names no map_Kd
+	std::string texture;
+	//mesh of an earlier object this one is placed relative to, empty for the scene's root
+	std::string parent;
+	glm::vec3 position = glm::vec3(0.f);
+	glm::vec3 rotation = glm::vec3(0.f);
+	glm::vec3 scale = glm::vec3(1.f);
+	std::vector<std::pair<int, glm::vec3>> colors;
+	//the airport's positions feed the collision BVH
+	MeshResidency residency = MeshResidency::Positions;
+};
+
+//Static meshes listed in a text file (see Aeroport.scene), so airports,
+//hangars and trees can be added without recompiling.
+class Scene
+{
+private:
+	std::vector<SceneObject> objects;
+	//shared through resources: objects using one file share its geometry and images
+	std::vector<Mesh> meshes;
+	//every object hangs below it, directly or through its parent
+	TransformNode root;
+
+public:
+	bool load(const std::string& path);
+	//start parsing/decoding everything init needs on the loader threads
+	void queue(AssetLoader& loader) const;
+	//GL thread: builds the meshes and uploads the textures, material maps included, not resident already
+	void init(AssetLoader& loader);
+	//shaders by the names used in the file; objects with an unknown shader are skipped
+	void submit(RenderQueue& queue, const std::map<std::string, Shader*>& shaders);
+
+	const std::vector<SceneObject>& getObjects() const { return objects; }
+	std::vector<Mesh>& getMeshes() { return meshes; }
+	//moves the whole scene; valid after init
+	TransformHandle getRoot() const { return root.get(); }
+};
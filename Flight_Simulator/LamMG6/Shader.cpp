@@ -1,7 +1,11 @@
 #include "Shader.h"
+#include "Material.h"
+#include "GLStats.h"
+#include "GLState.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 ShaderSource Shader::ParseShader(const std::string& filepath)
 {
@@ -75,35 +79,106 @@ void Shader::Set(std::string SourceFilePath)
 {
     ShaderSource source = ParseShader(SourceFilePath);
     shaderIndex = CreateShader(source.VertexSource, source.FragmentSource);
+
+    //GLSL 330 has no layout(binding), so attach the material block here
+    unsigned int materialBlock = glGetUniformBlockIndex(shaderIndex, "Materials");
+    if (materialBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(shaderIndex, materialBlock, MATERIAL_BINDING);
+
+    IntrospectUniforms();
+    ModelUniform = GetUniform<glm::mat4>("model");
+    ViewUniform = GetUniform<glm::mat4>("view");
+    ProjectionUniform = GetUniform<glm::mat4>("projection");
+    ViewPosUniform = GetUniform<glm::vec3>("viewPos");
+    MaterialUniform = GetUniform<int>("materialIndex");
+}
+
+//one pass over the active uniforms after linking, Set* by name never asks GL again
+void Shader::IntrospectUniforms()
+{
+    uniformLocations.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(shaderIndex, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(shaderIndex, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(std::max(maxLength, 1), '\0');
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(shaderIndex, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        std::string uniformName(name.data(), length);
+        //uniform block members have no location
+        GLint location = glGetUniformLocation(shaderIndex, uniformName.c_str());
+        if (location < 0)
+            continue;
+        uniformLocations[uniformName] = location;
+        //arrays are reported as "name[0]", also answer to "name"
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos)
+            uniformLocations[uniformName.substr(0, bracket)] = location;
+    }
+}
+
+GLint Shader::GetUniformLocation(const std::string& name) const
+{
+    auto found = uniformLocations.find(name);
+    return found == uniformLocations.end() ? -1 : found->second;
 }
 
 void Shader::Use()
 {
-    glUseProgram(shaderIndex);
+    glState.useProgram(shaderIndex);
 }
 
 void Shader::Delete()
 {
-    glDeleteProgram(shaderIndex);
+    glState.deleteProgram(shaderIndex);
 }
 
 void Shader::SetInt(const std::string& name, int value) const
 {
-    glUniform1i(glGetUniformLocation(shaderIndex, name.c_str()), value);
+    glStats.uniformLookups++;
+    SetInt(Uniform<int>{ GetUniformLocation(name) }, value);
 }
 void Shader::SetFloat(const std::string& name, const float& value) const
 {
-    glUniform1f(glGetUniformLocation(shaderIndex, name.c_str()), value);
+    glStats.uniformLookups++;
+    SetFloat(Uniform<float>{ GetUniformLocation(name) }, value);
 }
 void Shader::SetVec3(const std::string& name, const glm::vec3& value) const
 {
-    glUniform3fv(glGetUniformLocation(shaderIndex, name.c_str()), 1, &value[0]);
+    glStats.uniformLookups++;
+    SetVec3(Uniform<glm::vec3>{ GetUniformLocation(name) }, value);
 }
 void Shader::SetVec3(const std::string& name, float x, float y, float z) const
 {
-    glUniform3f(glGetUniformLocation(shaderIndex, name.c_str()), x, y, z);
+    glStats.uniformLookups++;
+    SetVec3(Uniform<glm::vec3>{ GetUniformLocation(name) }, glm::vec3(x, y, z));
 }
 void Shader::SetMat4(const std::string& name, const glm::mat4& mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(shaderIndex, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-}
\ No newline at end of file
+    glStats.uniformLookups++;
+    SetMat4(Uniform<glm::mat4>{ GetUniformLocation(name) }, mat);
+}
+
+void Shader::SetInt(Uniform<int> uniform, int value) const
+{
+    glStats.calls++;
+    glUniform1i(uniform.location, value);
+}
+void Shader::SetFloat(Uniform<float> uniform, float value) const
+{
+    glStats.calls++;
+    glUniform1f(uniform.location, value);
+}
+void Shader::SetVec3(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+    glStats.calls++;
+    glUniform3fv(uniform.location, 1, &value[0]);
+}
+void Shader::SetMat4(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+{
+    glStats.calls++;
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <unordered_map>
 #include <GL/glew.h>
 #include <glfw3.h>
 #include <glm.hpp>
@@ -10,9 +11,18 @@ struct ShaderSource
 	std::string FragmentSource;
 };
 
+//location resolved once; the type picks the matching Set overload
+template <typename T>
+struct Uniform
+{
+	GLint location = -1;
+};
+
 class Shader
 {
 private:
+	std::unordered_map<std::string, GLint> uniformLocations;
+	void IntrospectUniforms();
 protected:
 	ShaderSource ParseShader(const std::string& filepath);
     unsigned int CompileShader(unsigned int type, const std::string& source);
@@ -20,6 +30,14 @@ protected:
 public:
 	ShaderSource Source;
 	unsigned int shaderIndex;
+	//handles for the uniforms every frame sets, -1 when the shader lacks them
+	Uniform<glm::mat4> ModelUniform;
+	Uniform<glm::mat4> ViewUniform;
+	Uniform<glm::mat4> ProjectionUniform;
+	Uniform<glm::vec3> ViewPosUniform;
+	//index into the Materials block, set per draw range
+	Uniform<int> MaterialUniform;
+
 	void Set(std::string SourceFilePath);
 	void Use();
 	void Delete();
@@ -28,4 +46,12 @@ public:
 	void SetFloat(const std::string& name, const float& value) const;
 	void SetVec3(const std::string& name, const glm::vec3& value) const;
 	void SetVec3(const std::string& name, float x, float y, float z) const;
+
+	GLint GetUniformLocation(const std::string& name) const;
+	template <typename T>
+	Uniform<T> GetUniform(const std::string& name) const { return { GetUniformLocation(name) }; }
+	void SetMat4(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+	void SetInt(Uniform<int> uniform, int value) const;
+	void SetFloat(Uniform<float> uniform, float value) const;
+	void SetVec3(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
 };
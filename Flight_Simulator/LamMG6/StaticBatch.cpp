@@ -0,0 +1,242 @@
+#include "StaticBatch.h"
+#include "GLState.h"
+#include "GLStats.h"
+#include <algorithm>
+#include <map>
+
+StaticBatch::~StaticBatch()
+{
+    if (VAO == 0)
+        return;
+    glState.deleteVertexArray(VAO);
+    for (GLuint buffer : { VBO, EBO, drawIDs, commandBuffer, drawBuffer, materialBuffer })
+        glState.deleteBuffer(buffer);
+}
+
+void StaticBatch::build(Scene& scene, Shader* shader)
+{
+    this->shader = shader;
+    std::vector<MaterialEntry> materials;
+    std::vector<BatchDraw> draws;
+    //meshes the batch takes with where their vertices and indices go, copied buffer to
+    //buffer; instances of one geometry reuse the first one's place
+    struct Source
+    {
+        const Mesh* mesh;
+        GLuint firstIndex;
+        GLint baseVertex;
+    };
+    std::vector<Source> sources;
+    std::map<const MeshGeometry*, size_t> placed;
+    GLuint nrOfShared = 0;
+    GLuint nrOfVertices = 0, nrOfIndices = 0;
+
+    const std::vector<SceneObject>& objects = scene.getObjects();
+    std::vector<Mesh>& meshes = scene.getMeshes();
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        Mesh& mesh = meshes[i];
+        if (mesh.getVertexCount() == 0)
+            continue;
+        if (mesh.getVBO() == 0 || mesh.getLayout() != VertexLayout::Compact)
+        {
+            std::cout << "Static batch needs " << objects[i].mesh << " uploaded with the compact layout, left out\n";
+            continue;
+        }
+
+        auto first = placed.find(&mesh.getGeometry());
+        if (first != placed.end())
+            nrOfShared++;
+        else
+        {
+            first = placed.emplace(&mesh.getGeometry(), sources.size()).first;
+            sources.push_back({ &mesh, nrOfIndices, (GLint)nrOfVertices });
+            nrOfVertices += (GLuint)mesh.getVertexCount();
+            nrOfIndices += mesh.getIndexCount() != 0 ? (GLuint)mesh.getIndexCount() : (GLuint)mesh.getVertexCount();
+        }
+        const Source& source = sources[first->second];
+
+        GLint materialBase = (GLint)materials.size();
+        const std::vector<MaterialEntry>& table = mesh.getMaterialTable();
+        materials.insert(materials.end(), table.begin(), table.end());
+        //meshes without an .mtl still need one entry to index
+        if (table.empty())
+            materials.push_back({ glm::vec4(1.f, 0.f, 1.f, 1.f), glm::vec4(0.f), glm::vec4(0.f), glm::vec4(0.f) });
+        GLint materialCount = (GLint)materials.size() - materialBase;
+        AABB meshBounds = mesh.getWorldBounds();
+
+        //a command per material range, the draw picks its material and texture
+        const std::vector<MaterialRange>& ranges = mesh.getRanges();
+        for (size_t range = 0; range < ranges.size(); range++)
+        {
+            DrawElementsIndirectCommand command;
+            command.instanceCount = 1;
+            command.baseInstance = (GLuint)draws.size();
+            command.count = ranges[range].count;
+            command.firstIndex = source.firstIndex + ranges[range].firstIndex;
+            command.baseVertex = source.baseVertex;
+            commands.push_back(command);
+            bounds.push_back(meshBounds);
+
+            BatchDraw draw = BatchDraw();
+            draw.model = mesh.getModel();
+            draw.materialIndex = materialBase + std::clamp(ranges[range].material, 0, materialCount - 1);
+            draw.textureIndex = -1;
+            unsigned int texture = mesh.getTexture(range);
+            if (texture != 0)
+            {
+                auto slot = std::find(textures.begin(), textures.end(), texture);
+                draw.textureIndex = (GLint)(slot - textures.begin());
+                if (slot == textures.end())
+                    textures.push_back(texture);
+            }
+            draws.push_back(draw);
+        }
+    }
+    nrOfDraws = (GLsizei)commands.size();
+
+    //grouped by texture, untextured first; baseInstance still finds each command's draw
+    std::vector<size_t> order(commands.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return draws[commands[a].baseInstance].textureIndex < draws[commands[b].baseInstance].textureIndex; });
+    std::vector<DrawElementsIndirectCommand> sortedCommands;
+    std::vector<AABB> sortedBounds;
+    for (size_t i : order)
+    {
+        GLint slot = draws[commands[i].baseInstance].textureIndex;
+        unsigned int texture = slot >= 0 ? textures[slot] : 0;
+        if (groups.empty() || groups.back().texture != texture)
+            groups.push_back({ texture, (GLsizei)sortedCommands.size(), 0 });
+        groups.back().count++;
+        sortedCommands.push_back(commands[i]);
+        sortedBounds.push_back(bounds[i]);
+    }
+    commands.swap(sortedCommands);
+    bounds.swap(sortedBounds);
+
+    std::vector<GLuint> drawIndices(draws.size());
+    for (GLuint i = 0; i < drawIndices.size(); i++)
+        drawIndices[i] = i;
+
+    glCreateVertexArrays(1, &VAO);
+    glState.bindVertexArray(VAO);
+
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)nrOfVertices * sizeof(CompactVertex), nullptr, GL_STATIC_DRAW);
+    //same compact layout as Mesh::initVAO
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CompactVertex), (GLvoid*)offsetof(CompactVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (GLvoid*)offsetof(CompactVertex, texcoord));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (GLvoid*)offsetof(CompactVertex, normal));
+    glEnableVertexAttribArray(3);
+
+    //draw id per instance, the command's baseInstance picks the entry
+    glGenBuffers(1, &drawIDs);
+    glBindBuffer(GL_ARRAY_BUFFER, drawIDs);
+    glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+    glVertexAttribIPointer(8, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+    glVertexAttribDivisor(8, 1);
+    glEnableVertexAttribArray(8);
+
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)nrOfIndices * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+    glState.bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    //the meshes' own buffers already hold compact vertices and local indices (baseVertex
+    //offsets them), so nothing has to be resident on the CPU
+    std::vector<GLuint> sequence;
+    for (const Source& source : sources)
+    {
+        const Mesh& mesh = *source.mesh;
+        GLuint count = mesh.getIndexCount() != 0 ? (GLuint)mesh.getIndexCount() : (GLuint)mesh.getVertexCount();
+        glCopyNamedBufferSubData(mesh.getVBO(), VBO, 0, (GLintptr)source.baseVertex * sizeof(CompactVertex),
+            (GLsizeiptr)mesh.getVertexCount() * sizeof(CompactVertex));
+        if (mesh.getEBO() != 0)
+            glCopyNamedBufferSubData(mesh.getEBO(), EBO, 0, (GLintptr)source.firstIndex * sizeof(GLuint), (GLsizeiptr)count * sizeof(GLuint));
+        else
+        {
+            sequence.resize(count);
+            for (GLuint index = 0; index < count; index++)
+                sequence[index] = index;
+            glNamedBufferSubData(EBO, (GLintptr)source.firstIndex * sizeof(GLuint), (GLsizeiptr)count * sizeof(GLuint), sequence.data());
+        }
+    }
+
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glGenBuffers(1, &drawBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, draws.size() * sizeof(BatchDraw), draws.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &materialBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(MaterialEntry), materials.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    shader->Use();
+    shader->SetInt("batchTexture", 0);
+
+    std::cout << "Static batch: " << nrOfDraws << " draws in " << groups.size() << " multi-draws, " << nrOfVertices << " vertices, "
+        << nrOfIndices << " indices, " << textures.size() << " textures";
+    if (nrOfShared != 0)
+        std::cout << ", " << nrOfShared << " objects reuse another's geometry";
+    std::cout << '\n';
+}
+
+void StaticBatch::draw(const Frustum* frustum)
+{
+    if (nrOfDraws == 0)
+        return;
+    GLsizei nrVisible = nrOfDraws;
+    if (frustum != nullptr)
+    {
+        bool changed = false;
+        nrVisible = 0;
+        for (GLsizei i = 0; i < nrOfDraws; i++)
+        {
+            GLuint instanceCount = frustum->intersects(bounds[i]) ? 1 : 0;
+            changed |= commands[i].instanceCount != instanceCount;
+            commands[i].instanceCount = instanceCount;
+            nrVisible += instanceCount;
+        }
+        glStats.visible += nrVisible;
+        glStats.culled += nrOfDraws - nrVisible;
+        if (changed)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+            glStats.calls += 2;
+        }
+    }
+    if (nrVisible == 0)
+        return;
+    shader->Use();
+    glState.bindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_DRAW_BINDING, drawBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_MATERIAL_BINDING, materialBuffer);
+    glStats.calls += 3;
+    for (const TextureGroup& group : groups)
+    {
+        //a group culled entirely costs nothing
+        bool visible = false;
+        for (GLsizei i = group.first; i < group.first + group.count && !visible; i++)
+            visible = commands[i].instanceCount != 0;
+        if (!visible)
+            continue;
+        if (group.texture != 0)
+            glState.bindTexture2D(group.texture, 0);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)(group.first * sizeof(DrawElementsIndirectCommand)),
+            group.count, 0);
+        glStats.calls++;
+        glStats.draws++;
+    }
+}
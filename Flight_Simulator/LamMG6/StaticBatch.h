@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <glm.hpp>
+#include "Scene.h"
+#include "Shader.h"
+#include "Frustum.h"
+
+//shader storage binding points of the blocks in Batch.shader
+const unsigned int BATCH_DRAW_BINDING = 1;
+const unsigned int BATCH_MATERIAL_BINDING = 2;
+
+//layout of glMultiDrawElementsIndirect commands
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+//one std430 entry of the BatchDraws block
+struct BatchDraw
+{
+	glm::mat4 model;
+	//slot in StaticBatch::textures, -1 for material colored draws
+	GLint textureIndex;
+	//entry of the BatchMaterials block the draw's range uses
+	GLint materialIndex;
+	GLint padding[2];
+};
+
+//All objects of a Scene merged into one vertex/index buffer and drawn with one
+//glMultiDrawElementsIndirect per texture. Model matrices and material tables come
+//from shader storage buffers indexed by the draw. Every material range of an object
+//is one command; objects sharing one geometry draw the same indices.
+class StaticBatch
+{
+private:
+	//commands [first, first + count) sample texture, 0 for the untextured ones; a
+	//sampler must be the same for a whole multi-draw, GLSL can't index one per draw
+	struct TextureGroup
+	{
+		unsigned int texture;
+		GLsizei first;
+		GLsizei count;
+	};
+
+	Shader* shader = nullptr;
+	std::vector<unsigned int> textures;
+	std::vector<TextureGroup> groups;
+	//CPU copy of the command buffer, sorted by texture; culling writes instanceCount 0 or 1
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<AABB> bounds;
+	GLsizei nrOfDraws = 0;
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLuint EBO = 0;
+	GLuint drawIDs = 0;
+	GLuint commandBuffer = 0;
+	GLuint drawBuffer = 0;
+	GLuint materialBuffer = 0;
+
+public:
+	StaticBatch() = default;
+	~StaticBatch();
+	StaticBatch(const StaticBatch&) = delete;
+	StaticBatch& operator=(const StaticBatch&) = delete;
+
+	//copies the scene's uploaded meshes on the GPU, they can be dropped afterwards and
+	//need no CPU data; shader is Batch.shader
+	void build(Scene& scene, Shader* shader);
+	//commands outside frustum get instanceCount 0, re-uploaded only when that changes
+	void draw(const Frustum* frustum = nullptr);
+	GLsizei getDrawCount() const { return nrOfDraws; }
+};
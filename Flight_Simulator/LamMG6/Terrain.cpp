@@ -0,0 +1,386 @@
+#include "Terrain.h"
+#include "GLState.h"
+#include "GLStats.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+Terrain::Terrain(const Heightmap& heightmap, TerrainSettings settings)
+    : heightmap(heightmap), settings(settings)
+{
+    int T = settings.tileSize;
+    verticesPerChunk = (T + 1) * (T + 1) + 4 * (T + 1);
+    nrOfIndices = T * T * 6 + 4 * T * 6;
+    buildTree();
+}
+
+Terrain::~Terrain()
+{
+    if (VAO == 0)
+        return;
+    glState.deleteVertexArray(VAO);
+    for (GLuint buffer : { VBO, EBO, commandBuffer })
+        glState.deleteBuffer(buffer);
+}
+
+void Terrain::buildTree()
+{
+    if (heightmap.empty())
+        return;
+    int T = settings.tileSize;
+    int size = std::max(heightmap.width, heightmap.height) - 1;
+    levels = 1;
+    while ((T << (levels - 1)) < size)
+        levels++;
+    nodes.resize(levels);
+
+    //leaves: height range of their full resolution samples
+    int leaf = levels - 1;
+    int count = 1 << leaf;
+    nodes[leaf].resize((size_t)count * count);
+    for (int z = 0; z < count; z++)
+    {
+        for (int x = 0; x < count; x++)
+        {
+            int sx = x * T, sz = z * T;
+            if ((sx >= heightmap.width - 1 && sx > 0) || (sz >= heightmap.height - 1 && sz > 0))
+                continue;
+            Node& leafNode = node(leaf, x, z);
+            leafNode.minY = leafNode.maxY = heightmap.at(sx, sz);
+            for (int j = sz; j <= std::min(sz + T, heightmap.height - 1); j++)
+            {
+                for (int i = sx; i <= std::min(sx + T, heightmap.width - 1); i++)
+                {
+                    float y = heightmap.at(i, j);
+                    leafNode.minY = std::min(leafNode.minY, y);
+                    leafNode.maxY = std::max(leafNode.maxY, y);
+                }
+            }
+        }
+    }
+
+    //parents: children's range, children's error plus what the coarser grid
+    //misses at the children's sample points
+    for (int level = leaf - 1; level >= 0; level--)
+    {
+        count = 1 << level;
+        nodes[level].resize((size_t)count * count);
+        int step = span(level) / T;
+        int half = step / 2;
+        for (int z = 0; z < count; z++)
+        {
+            for (int x = 0; x < count; x++)
+            {
+                Node& parent = node(level, x, z);
+                float childError = 0.f;
+                for (int c = 0; c < 4; c++)
+                {
+                    const Node& child = node(level + 1, 2 * x + c % 2, 2 * z + c / 2);
+                    if (!child.exists())
+                        continue;
+                    if (!parent.exists())
+                    {
+                        parent.minY = child.minY;
+                        parent.maxY = child.maxY;
+                    }
+                    parent.minY = std::min(parent.minY, child.minY);
+                    parent.maxY = std::max(parent.maxY, child.maxY);
+                    childError = std::max(childError, child.error);
+                }
+                if (!parent.exists())
+                    continue;
+
+                int sx = x * span(level), sz = z * span(level);
+                float deviation = 0.f;
+                for (int v = 0; v <= 2 * T; v++)
+                {
+                    int j = sz + v * half;
+                    if (j > heightmap.height - 1)
+                        break;
+                    for (int u = (v % 2 == 0) ? 1 : 0; u <= 2 * T; u += (v % 2 == 0) ? 2 : 1)
+                    {
+                        int i = sx + u * half;
+                        if (i > heightmap.width - 1)
+                            break;
+                        //the parent's surface here: edge midpoint or the quad's diagonal
+                        float coarse;
+                        if (v % 2 == 0)
+                            coarse = (heightmap.at(i - half, j) + heightmap.at(i + half, j)) * 0.5f;
+                        else if (u % 2 == 0)
+                            coarse = (heightmap.at(i, j - half) + heightmap.at(i, j + half)) * 0.5f;
+                        else
+                            coarse = (heightmap.at(i - half, j - half) + heightmap.at(i + half, j + half)) * 0.5f;
+                        deviation = std::max(deviation, std::abs(heightmap.at(i, j) - coarse));
+                    }
+                }
+                parent.error = childError + deviation;
+            }
+        }
+    }
+}
+
+void Terrain::setModel(const glm::mat4& model)
+{
+    this->model = model;
+}
+
+void Terrain::initGPU()
+{
+    if (levels == 0)
+        return;
+    int T = settings.tileSize;
+    int T1 = T + 1;
+    std::vector<GLuint> indices;
+    indices.reserve(nrOfIndices);
+    for (int b = 0; b < T; b++)
+    {
+        for (int a = 0; a < T; a++)
+        {
+            GLuint v00 = b * T1 + a, v10 = v00 + 1, v01 = v00 + T1, v11 = v01 + 1;
+            indices.insert(indices.end(), { v00, v01, v11, v00, v11, v10 });
+        }
+    }
+    //skirt strips hang below the four borders, in the order buildChunk writes them
+    GLuint skirt = T1 * T1;
+    for (int edge = 0; edge < 4; edge++)
+    {
+        for (int k = 0; k < T; k++)
+        {
+            GLuint border0, border1;
+            if (edge < 2)
+            {
+                border0 = (edge == 0 ? 0 : T) * T1 + k;
+                border1 = border0 + 1;
+            }
+            else
+            {
+                border0 = k * T1 + (edge == 2 ? 0 : T);
+                border1 = border0 + T1;
+            }
+            GLuint skirt0 = skirt + edge * T1 + k, skirt1 = skirt0 + 1;
+            indices.insert(indices.end(), { border0, skirt0, skirt1, border0, skirt1, border1 });
+        }
+    }
+
+    //room for the drawn chunks plus the ancestors the selection walks through
+    slots.resize((size_t)settings.maxChunks * 2);
+    chunkVertices.resize(verticesPerChunk);
+
+    glCreateVertexArrays(1, &VAO);
+    glState.bindVertexArray(VAO);
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, slots.size() * verticesPerChunk * sizeof(TerrainVertex), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (GLvoid*)offsetof(TerrainVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (GLvoid*)offsetof(TerrainVertex, texcoord));
+    glEnableVertexAttribArray(2);
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glState.bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, settings.maxChunks * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    std::cout << "Terrain: " << heightmap.width << 'x' << heightmap.height << " samples, " << levels << " levels, "
+        << nrOfIndices / 3 << " triangles per chunk, at most " << getMaxTriangles() << " per frame\n";
+}
+
+float Terrain::skirtDepth(int level, int x, int z)
+{
+    //a neighbour one level coarser is off by at most the parent's error
+    float depth = level > 0 ? node(level - 1, x / 2, z / 2).error : node(level, x, z).error;
+    return depth + 0.01f * span(level) * std::min(heightmap.spacingX, heightmap.spacingZ);
+}
+
+AABB Terrain::nodeBounds(int level, int x, int z)
+{
+    const Node& bounded = node(level, x, z);
+    int sx = x * span(level), sz = z * span(level);
+    AABB box;
+    box.min = glm::vec3(heightmap.origin.x + sx * heightmap.spacingX, bounded.minY - skirtDepth(level, x, z),
+        heightmap.origin.z + sz * heightmap.spacingZ);
+    box.max = glm::vec3(heightmap.origin.x + std::min(sx + span(level), heightmap.width - 1) * heightmap.spacingX, bounded.maxY,
+        heightmap.origin.z + std::min(sz + span(level), heightmap.height - 1) * heightmap.spacingZ);
+    return TransformAABB(box, model);
+}
+
+void Terrain::buildChunk(int level, int x, int z, int slot)
+{
+    int T = settings.tileSize;
+    int T1 = T + 1;
+    int step = span(level) / T;
+    int sx = x * span(level), sz = z * span(level);
+    float u = 1.f / std::max(heightmap.width - 1, 1);
+    float v = 1.f / std::max(heightmap.height - 1, 1);
+    for (int b = 0; b <= T; b++)
+    {
+        int j = std::min(sz + b * step, heightmap.height - 1);
+        for (int a = 0; a <= T; a++)
+        {
+            int i = std::min(sx + a * step, heightmap.width - 1);
+            TerrainVertex& vertex = chunkVertices[b * T1 + a];
+            vertex.position = heightmap.position(i, j);
+            vertex.texcoord = glm::vec2(i * u, 1.f - j * v);
+        }
+    }
+    float depth = skirtDepth(level, x, z);
+    TerrainVertex* skirt = &chunkVertices[T1 * T1];
+    for (int k = 0; k <= T; k++)
+    {
+        skirt[k] = chunkVertices[k];
+        skirt[T1 + k] = chunkVertices[T * T1 + k];
+        skirt[2 * T1 + k] = chunkVertices[k * T1];
+        skirt[3 * T1 + k] = chunkVertices[k * T1 + T];
+    }
+    for (int k = 0; k < 4 * T1; k++)
+        skirt[k].position.y -= depth;
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)slot * verticesPerChunk * sizeof(TerrainVertex), verticesPerChunk * sizeof(TerrainVertex), chunkVertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glStats.calls += 3;
+}
+
+bool Terrain::makeResident(int level, int x, int z, bool force)
+{
+    Node& resident = node(level, x, z);
+    if (resident.slot >= 0)
+    {
+        slots[resident.slot].lastUsed = frame;
+        return true;
+    }
+    if (!force && buildsLastUpdate >= settings.buildsPerFrame)
+        return false;
+
+    //a free slot, else the least recently used one not needed this frame
+    int chosen = -1;
+    for (int i = 0; i < (int)slots.size(); i++)
+    {
+        if (slots[i].level < 0)
+        {
+            chosen = i;
+            break;
+        }
+        if (slots[i].lastUsed != frame && (chosen < 0 || slots[i].lastUsed < slots[chosen].lastUsed))
+            chosen = i;
+    }
+    if (chosen < 0)
+        return false;
+    Slot& slot = slots[chosen];
+    if (slot.level >= 0)
+        node(slot.level, slot.x, slot.z).slot = -1;
+
+    buildChunk(level, x, z, chosen);
+    slot.level = level;
+    slot.x = x;
+    slot.z = z;
+    slot.lastUsed = frame;
+    resident.slot = chosen;
+    buildsLastUpdate++;
+    return true;
+}
+
+void Terrain::update(const glm::vec3& eye, const Frustum& frustum, float screenHeight, float fovY)
+{
+    frame++;
+    buildsLastUpdate = 0;
+    commands.clear();
+    if (VAO == 0)
+        return;
+
+    //pixels per unit of error at distance 1; errors are vertical in terrain space
+    float lodScale = screenHeight / (2.f * std::tan(fovY * 0.5f));
+    float errorScale = glm::length(glm::vec3(model[1]));
+    struct Candidate
+    {
+        float screenError;
+        int level, x, z;
+        bool operator<(const Candidate& other) const { return screenError < other.screenError; }
+    };
+    auto candidate = [&](int level, int x, int z, const AABB& box) {
+        glm::vec3 nearest = glm::clamp(eye, box.min, box.max);
+        float distance = std::max(glm::length(eye - nearest), 1e-3f);
+        return Candidate{ node(level, x, z).error * errorScale * lodScale / distance, level, x, z };
+    };
+
+    AABB rootBox = nodeBounds(0, 0, 0);
+    if (!frustum.intersects(rootBox))
+    {
+        glStats.culled++;
+        return;
+    }
+    makeResident(0, 0, 0, true);
+    std::priority_queue<Candidate> open;
+    open.push(candidate(0, 0, 0, rootBox));
+    size_t selected = 1;
+    Candidate children[4];
+    while (!open.empty())
+    {
+        Candidate top = open.top();
+        open.pop();
+        int nrOfChildren = 0, culled = 0;
+        bool refine = top.level + 1 < levels && top.screenError > settings.pixelError;
+        if (refine)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                int level = top.level + 1, x = 2 * top.x + c % 2, z = 2 * top.z + c / 2;
+                if (!node(level, x, z).exists())
+                    continue;
+                AABB box = nodeBounds(level, x, z);
+                if (frustum.intersects(box))
+                    children[nrOfChildren++] = candidate(level, x, z, box);
+                else
+                    culled++;
+            }
+            refine = selected - 1 + nrOfChildren <= (size_t)settings.maxChunks;
+            for (int c = 0; c < nrOfChildren && refine; c++)
+                refine = makeResident(children[c].level, children[c].x, children[c].z, false);
+        }
+        if (!refine)
+        {
+            const Node& drawn = node(top.level, top.x, top.z);
+            commands.push_back({ (GLuint)nrOfIndices, 1, 0, drawn.slot * verticesPerChunk, 0 });
+            continue;
+        }
+        glStats.culled += culled;
+        selected += nrOfChildren - 1;
+        for (int c = 0; c < nrOfChildren; c++)
+            open.push(children[c]);
+    }
+    glStats.visible += (unsigned int)commands.size();
+}
+
+void Terrain::draw(Shader* shader)
+{
+    if (commands.empty())
+        return;
+    shader->Use();
+    shader->SetMat4(shader->ModelUniform, model);
+    glState.bindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)commands.size(), 0);
+    glStats.calls += 3;
+    glStats.draws++;
+}
+
+size_t Terrain::getResidentChunks() const
+{
+    return std::count_if(slots.begin(), slots.end(), [](const Slot& slot) { return slot.level >= 0; });
+}
+
+size_t Terrain::getMemoryBytes() const
+{
+    size_t bytes = 0;
+    for (const std::vector<Node>& level : nodes)
+        bytes += level.size() * sizeof(Node);
+    bytes += (size_t)settings.maxChunks * 2 * verticesPerChunk * sizeof(TerrainVertex);
+    bytes += (size_t)nrOfIndices * sizeof(GLuint) + settings.maxChunks * sizeof(DrawElementsIndirectCommand);
+    return bytes;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <glm.hpp>
+#include "Heightmap.h"
+#include "Frustum.h"
+#include "Shader.h"
+#include "StaticBatch.h"
+
+struct TerrainSettings
+{
+	//quads per chunk side, every chunk has the same vertex count whatever its level
+	int tileSize = 32;
+	//allowed geometric error on screen
+	float pixelError = 2.f;
+	//upper bound of chunks drawn per frame, so of triangles too
+	int maxChunks = 384;
+	//chunks generated and uploaded per update, refinement waits for the rest
+	int buildsPerFrame = 16;
+};
+
+//positions and uvs only, the layout terrain.shader reads (locations 0 and 2)
+struct TerrainVertex
+{
+	glm::vec3 position;
+	glm::vec2 texcoord;
+};
+
+//Chunked LOD over a Heightmap. A quadtree splits the grid down to tileSize quads
+//per leaf; a node is drawn as the same (tileSize + 1)^2 grid sampled every 2^k
+//samples. Each update refines the nodes with the largest screen space error first
+//until they are under pixelError or maxChunks is reached. Chunk vertices live in
+//fixed slots of one buffer, evicted least recently used, and the selection goes
+//out as one glMultiDrawElementsIndirect. Skirts hide the cracks between levels.
+class Terrain
+{
+private:
+	struct Node
+	{
+		float minY = 1.f;
+		float maxY = 0.f;
+		//largest height difference to the full resolution grid, in terrain space
+		float error = 0.f;
+		int slot = -1;
+		bool exists() const { return minY <= maxY; }
+	};
+	struct Slot
+	{
+		int level = -1;
+		int x = 0;
+		int z = 0;
+		unsigned int lastUsed = 0;
+	};
+
+	const Heightmap& heightmap;
+	TerrainSettings settings;
+	int levels = 0;
+	//nodes[level][z * (1 << level) + x], level 0 is the root
+	std::vector<std::vector<Node>> nodes;
+	glm::mat4 model = glm::mat4(1.f);
+
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLuint EBO = 0;
+	GLuint commandBuffer = 0;
+	GLsizei nrOfIndices = 0;
+	GLint verticesPerChunk = 0;
+	std::vector<Slot> slots;
+	std::vector<TerrainVertex> chunkVertices;
+	std::vector<DrawElementsIndirectCommand> commands;
+	unsigned int frame = 0;
+	int buildsLastUpdate = 0;
+
+	Node& node(int level, int x, int z) { return nodes[level][(size_t)z * ((size_t)1 << level) + x]; }
+	int span(int level) const { return settings.tileSize << (levels - 1 - level); }
+	void buildTree();
+	float skirtDepth(int level, int x, int z);
+	AABB nodeBounds(int level, int x, int z);
+	bool makeResident(int level, int x, int z, bool force);
+	void buildChunk(int level, int x, int z, int slot);
+
+public:
+	Terrain(const Heightmap& heightmap, TerrainSettings settings = TerrainSettings());
+	~Terrain();
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+
+	//terrain space to world, e.g. the model matrix of the mesh the heightmap came from
+	void setModel(const glm::mat4& model);
+	void initGPU();
+	//selects the chunks for this view; fovY in radians, screenHeight in pixels
+	void update(const glm::vec3& eye, const Frustum& frustum, float screenHeight, float fovY);
+	void draw(Shader* shader);
+
+	int getLevels() const { return levels; }
+	size_t getDrawnChunks() const { return commands.size(); }
+	size_t getDrawnTriangles() const { return commands.size() * nrOfIndices / 3; }
+	size_t getMaxTriangles() const { return (size_t)settings.maxChunks * nrOfIndices / 3; }
+	int getBuildsLastUpdate() const { return buildsLastUpdate; }
+	size_t getResidentChunks() const;
+	bool hasGPU() const { return VAO != 0; }
+	//quadtree plus the chunk buffers initGPU allocates
+	size_t getMemoryBytes() const;
+};
@@ -0,0 +1,38 @@
+#include "TerrainQuery.h"
+
+TerrainQuery::TerrainQuery(const Heightmap& heightmap, const glm::mat4& model)
+    : heightmap(heightmap.empty() ? nullptr : &heightmap), model(model), inverseModel(glm::inverse(model)),
+    normalMatrix(glm::mat3(glm::transpose(glm::inverse(model))))
+{
+}
+
+void TerrainQuery::addFlatArea(const AABB& area, float height)
+{
+    flatAreas.push_back({ area.min.x, area.min.z, area.max.x, area.max.z, height });
+}
+
+bool TerrainQuery::sample(float x, float z, GroundSample& ground) const
+{
+    for (const FlatArea& area : flatAreas)
+    {
+        if (x >= area.minX && x <= area.maxX && z >= area.minZ && z <= area.maxZ)
+        {
+            ground.height = area.height;
+            ground.normal = glm::vec3(0.f, 1.f, 0.f);
+            return true;
+        }
+    }
+    if (heightmap == nullptr)
+    {
+        ground = GroundSample();
+        return false;
+    }
+    //y up: the terrain space x/z of a world x/z doesn't depend on the world y
+    glm::vec4 local = inverseModel * glm::vec4(x, 0.f, z, 1.f);
+    float height;
+    glm::vec3 normal;
+    bool inside = SampleHeightmap(*heightmap, local.x, local.z, height, normal);
+    ground.height = (model * glm::vec4(local.x, height, local.z, 1.f)).y;
+    ground.normal = glm::normalize(normalMatrix * normal);
+    return inside;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <glm.hpp>
+#include "Frustum.h"
+#include "Heightmap.h"
+
+//what lies under a point, in world space
+struct GroundSample
+{
+	float height = 0.f;
+	glm::vec3 normal = glm::vec3(0.f, 1.f, 0.f);
+};
+
+//Height and normal queries against a heightmap placed in the world by a model matrix
+//that keeps y up (translation, scale, rotation about y). The grid is its own index: a
+//query finds its cell by division and interpolates one triangle, so it costs the same
+//anywhere on the map. Flat areas, such as the airport's apron, cover the relief where
+//they are. The heightmap is not copied and must outlive the query.
+class TerrainQuery
+{
+private:
+	struct FlatArea
+	{
+		float minX, minZ, maxX, maxZ;
+		float height;
+	};
+
+	const Heightmap* heightmap = nullptr;
+	glm::mat4 model = glm::mat4(1.f);
+	glm::mat4 inverseModel = glm::mat4(1.f);
+	glm::mat3 normalMatrix = glm::mat3(1.f);
+	std::vector<FlatArea> flatAreas;
+
+public:
+	//only flat areas; the y = 0 plane elsewhere
+	TerrainQuery() = default;
+	explicit TerrainQuery(const Heightmap& heightmap, const glm::mat4& model = glm::mat4(1.f));
+
+	//the x/z extent of a world box, at a given height
+	void addFlatArea(const AABB& area, float height);
+	//false off the map (the nearest border's sample) or, without a heightmap, outside the flat areas
+	bool sample(float x, float z, GroundSample& ground) const;
+	GroundSample sample(float x, float z) const
+	{
+		GroundSample ground;
+		sample(x, z, ground);
+		return ground;
+	}
+	float heightAt(float x, float z) const { return sample(x, z).height; }
+	bool hasHeightmap() const { return heightmap != nullptr; }
+};
@@ -0,0 +1,227 @@
+#include "TerrainStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+TerrainStreamer::TerrainStreamer(const std::string& directory, TerrainStreamerSettings settings, unsigned int nrOfThreads)
+    : pool(nrOfThreads), settings(settings)
+{
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        int latitude, longitude;
+        std::string extension = entry.path().extension().string();
+        if (entry.is_regular_file() && (extension == ".hgt" || extension == ".HGT") &&
+            ParseHgtName(entry.path().filename().string(), latitude, longitude))
+            available[{ latitude, longitude }] = entry.path().string();
+    }
+    if (available.empty())
+    {
+        std::cout << "No .hgt tiles in " << directory << '\n';
+        return;
+    }
+    int south = available.begin()->first.first, north = available.rbegin()->first.first + 1;
+    int west = 180, east = -180;
+    for (const auto& tile : available)
+    {
+        west = std::min(west, tile.first.second);
+        east = std::max(east, tile.first.second + 1);
+    }
+    origin.latitude = (south + north) * 0.5;
+    origin.longitude = (west + east) * 0.5;
+    std::cout << available.size() << " SRTM tiles in " << directory << ", " << south << ".." << north << " N, "
+        << west << ".." << east << " E\n";
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+    //workers may still be decoding into tiles
+    waitForLoads();
+}
+
+void TerrainStreamer::setOrigin(const GeoOrigin& origin)
+{
+    //tiles already loaded were placed around the old origin
+    waitForLoads();
+    tiles.clear();
+    residentBytes = 0;
+    this->origin = origin;
+}
+
+void TerrainStreamer::setModel(const glm::mat4& model)
+{
+    this->model = model;
+    this->inverseModel = glm::inverse(model);
+    for (auto& tile : tiles)
+    {
+        if (tile.second.loaded)
+        {
+            tile.second.loaded->terrain->setModel(model);
+            tile.second.loaded->query = TerrainQuery(tile.second.loaded->heightmap, model);
+        }
+    }
+}
+
+void TerrainStreamer::startLoading(const TileKey& key, StreamedTile& tile)
+{
+    std::string path = available[key];
+    GeoOrigin origin = this->origin;
+    TerrainSettings terrainSettings = settings.terrain;
+    tile.state = TileState::Loading;
+    tile.loading = pool.submit([path, origin, terrainSettings]() {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<LoadedTile> loaded;
+        HgtTile hgt;
+        if (!hgt.open(path))
+            return loaded;
+        loaded = std::make_unique<LoadedTile>();
+        loaded->heightmap = HgtToHeightmap(hgt, origin);
+        loaded->terrain = std::make_unique<Terrain>(loaded->heightmap, terrainSettings);
+        loaded->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        return loaded;
+    });
+}
+
+void TerrainStreamer::poll(StreamedTile& tile)
+{
+    if (tile.state != TileState::Loading || tile.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+    tile.loaded = tile.loading.get();
+    if (!tile.loaded)
+    {
+        tile.state = TileState::Failed;
+        return;
+    }
+    tile.loaded->terrain->setModel(model);
+    tile.loaded->query = TerrainQuery(tile.loaded->heightmap, model);
+    tile.bytes = tile.loaded->heightmap.samples.size() * sizeof(int16_t) + tile.loaded->terrain->getMemoryBytes();
+    residentBytes += tile.bytes;
+    loads++;
+    pageInSeconds += tile.loaded->seconds;
+    maxPageInSeconds = std::max(maxPageInSeconds, tile.loaded->seconds);
+    tile.state = TileState::Ready;
+}
+
+void TerrainStreamer::evict()
+{
+    while (residentBytes > settings.memoryBudget)
+    {
+        auto victim = tiles.end();
+        for (auto it = tiles.begin(); it != tiles.end(); ++it)
+        {
+            if (it->second.state != TileState::Loading && it->second.lastUsed != frame &&
+                (victim == tiles.end() || it->second.lastUsed < victim->second.lastUsed))
+                victim = it;
+        }
+        if (victim == tiles.end())
+        {
+            //everything left is around the aircraft
+            if (!overBudget)
+                std::cout << "Terrain tiles around the aircraft need " << residentBytes / (1024 * 1024) << " MB, over the "
+                    << settings.memoryBudget / (1024 * 1024) << " MB budget\n";
+            overBudget = true;
+            return;
+        }
+        residentBytes -= victim->second.bytes;
+        if (victim->second.state == TileState::Ready)
+            evictions++;
+        tiles.erase(victim);
+    }
+    overBudget = false;
+}
+
+void TerrainStreamer::update(const glm::vec3& aircraft)
+{
+    frame++;
+    glm::vec3 local = glm::vec3(inverseModel * glm::vec4(aircraft, 1.f));
+    double latitude, longitude;
+    origin.toGeo(local, latitude, longitude);
+    int centreLatitude = (int)std::floor(latitude), centreLongitude = (int)std::floor(longitude);
+
+    for (int dLat = -settings.radius; dLat <= settings.radius; dLat++)
+    {
+        for (int dLon = -settings.radius; dLon <= settings.radius; dLon++)
+        {
+            TileKey key(centreLatitude + dLat, centreLongitude + dLon);
+            if (available.count(key) == 0)
+                continue;
+            auto found = tiles.find(key);
+            if (found == tiles.end())
+            {
+                found = tiles.emplace(key, StreamedTile()).first;
+                startLoading(key, found->second);
+            }
+            found->second.lastUsed = frame;
+        }
+    }
+    for (auto& tile : tiles)
+        poll(tile.second);
+    evict();
+}
+
+bool TerrainStreamer::sample(float x, float z, GroundSample& ground) const
+{
+    glm::vec3 local = glm::vec3(inverseModel * glm::vec4(x, 0.f, z, 1.f));
+    double latitude, longitude;
+    origin.toGeo(local, latitude, longitude);
+    auto found = tiles.find(TileKey((int)std::floor(latitude), (int)std::floor(longitude)));
+    if (found == tiles.end() || found->second.state != TileState::Ready)
+        return false;
+    return found->second.loaded->query.sample(x, z, ground);
+}
+
+void TerrainStreamer::draw(Shader* shader, const glm::vec3& eye, const Frustum& frustum, float screenHeight, float fovY)
+{
+    bool built = false;
+    for (auto& tile : tiles)
+    {
+        if (tile.second.state != TileState::Ready)
+            continue;
+        Terrain& terrain = *tile.second.loaded->terrain;
+        if (!terrain.hasGPU())
+        {
+            if (built)
+                continue;
+            terrain.initGPU();
+            built = true;
+        }
+        terrain.update(eye, frustum, screenHeight, fovY);
+        terrain.draw(shader);
+    }
+}
+
+void TerrainStreamer::waitForLoads()
+{
+    for (auto& tile : tiles)
+    {
+        if (tile.second.state == TileState::Loading)
+            tile.second.loading.wait();
+        poll(tile.second);
+    }
+}
+
+TileState TerrainStreamer::getState(int latitude, int longitude) const
+{
+    auto found = tiles.find({ latitude, longitude });
+    if (found == tiles.end())
+        return TileState::Unloaded;
+    return found->second.state;
+}
+
+size_t TerrainStreamer::getLoadedTiles() const
+{
+    return std::count_if(tiles.begin(), tiles.end(), [](const auto& tile) { return tile.second.state == TileState::Ready; });
+}
+
+size_t TerrainStreamer::getDrawnTriangles() const
+{
+    size_t triangles = 0;
+    for (const auto& tile : tiles)
+    {
+        if (tile.second.state == TileState::Ready)
+            triangles += tile.second.loaded->terrain->getDrawnTriangles();
+    }
+    return triangles;
+}
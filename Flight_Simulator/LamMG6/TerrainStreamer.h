@@ -0,0 +1,103 @@
+#pragma once
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include "ThreadPool.h"
+#include "Hgt.h"
+#include "Terrain.h"
+#include "TerrainQuery.h"
+
+enum class TileState
+{
+	Unloaded,
+	Loading,
+	Ready,
+	Failed
+};
+
+struct TerrainStreamerSettings
+{
+	//tiles kept around the one under the aircraft: 1 is a 3x3 block
+	int radius = 1;
+	//heights, quadtrees and chunk buffers of the loaded tiles; least recently used go first
+	size_t memoryBudget = (size_t)512 * 1024 * 1024;
+	//per tile, fewer chunks than a lone Terrain since up to (2 * radius + 1)^2 tiles draw
+	TerrainSettings terrain = { 32, 2.f, 128, 8 };
+};
+
+//Pages the .hgt tiles of a directory in and out around the aircraft. A worker maps
+//the file, decodes it into a Heightmap and builds its Terrain quadtree; the chunk
+//buffers are made on the GL thread the first time the tile is drawn.
+class TerrainStreamer
+{
+private:
+	struct LoadedTile
+	{
+		Heightmap heightmap;
+		std::unique_ptr<Terrain> terrain;
+		//over heightmap with the streamer's model, made when the tile turns Ready
+		TerrainQuery query;
+		double seconds = 0.0;
+	};
+	struct StreamedTile
+	{
+		TileState state = TileState::Loading;
+		std::future<std::unique_ptr<LoadedTile>> loading;
+		std::unique_ptr<LoadedTile> loaded;
+		unsigned int lastUsed = 0;
+		size_t bytes = 0;
+	};
+	typedef std::pair<int, int> TileKey;
+
+	ThreadPool pool;
+	TerrainStreamerSettings settings;
+	std::map<TileKey, std::string> available;
+	std::map<TileKey, StreamedTile> tiles;
+	GeoOrigin origin;
+	glm::mat4 model = glm::mat4(1.f);
+	glm::mat4 inverseModel = glm::mat4(1.f);
+	unsigned int frame = 0;
+	size_t residentBytes = 0;
+	unsigned int loads = 0;
+	unsigned int evictions = 0;
+	double pageInSeconds = 0.0;
+	double maxPageInSeconds = 0.0;
+	bool overBudget = false;
+
+	void startLoading(const TileKey& key, StreamedTile& tile);
+	void poll(StreamedTile& tile);
+	void evict();
+
+public:
+	//indexes the directory's .hgt files, the origin starts at the centre of them
+	TerrainStreamer(const std::string& directory, TerrainStreamerSettings settings = TerrainStreamerSettings(), unsigned int nrOfThreads = 2);
+	~TerrainStreamer();
+	TerrainStreamer(const TerrainStreamer&) = delete;
+	TerrainStreamer& operator=(const TerrainStreamer&) = delete;
+
+	void setOrigin(const GeoOrigin& origin);
+	const GeoOrigin& getOrigin() const { return origin; }
+	//metres on the origin's plane to world
+	void setModel(const glm::mat4& model);
+	//once per frame with the aircraft's world position: loads, collects and evicts
+	void update(const glm::vec3& aircraft);
+	//on the GL thread; builds at most one tile's chunk buffers per call
+	void draw(Shader* shader, const glm::vec3& eye, const Frustum& frustum, float screenHeight, float fovY);
+	//blocks until every requested tile has been decoded
+	void waitForLoads();
+	//the ground at a world x/z; false when its tile isn't loaded
+	bool sample(float x, float z, GroundSample& ground) const;
+
+	TileState getState(int latitude, int longitude) const;
+	bool isLoaded(int latitude, int longitude) const { return getState(latitude, longitude) == TileState::Ready; }
+	size_t getAvailableTiles() const { return available.size(); }
+	size_t getLoadedTiles() const;
+	size_t getResidentBytes() const { return residentBytes; }
+	unsigned int getLoads() const { return loads; }
+	unsigned int getEvictions() const { return evictions; }
+	double getAveragePageIn() const { return loads > 0 ? pageInSeconds / loads : 0.0; }
+	double getMaxPageIn() const { return maxPageInSeconds; }
+	size_t getDrawnTriangles() const;
+};
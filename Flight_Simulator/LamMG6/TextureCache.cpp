@@ -0,0 +1,585 @@
+#include "TextureCache.h"
+#include "ResourceManager.h"
+#include "GLState.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+
+//bump whenever the layout below or the encoders change
+static const uint32_t TEXTURE_CACHE_VERSION = 1;
+static const char TEXTURE_CACHE_MAGIC[4] = { 'M', 'G', 'T', 'X' };
+
+struct TextureCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t nrOfLevels;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+};
+
+struct TextureLevelHeader
+{
+    int32_t width;
+    int32_t height;
+    uint32_t size;
+};
+
+static bool readSourceBytes(const std::string& path, std::string& bytes)
+{
+    std::ifstream fin(path, std::ios::binary | std::ios::ate);
+    if (!fin.is_open())
+        return false;
+    bytes.resize((size_t)fin.tellg());
+    fin.seekg(0);
+    return (bool)fin.read(bytes.data(), bytes.size());
+}
+
+static bool sourceKey(const std::string& path, int64_t& time)
+{
+    std::error_code error;
+    auto stamp = std::filesystem::last_write_time(path, error);
+    if (error)
+        return false;
+    time = (int64_t)stamp.time_since_epoch().count();
+    return true;
+}
+
+static size_t blockSize(GLenum format)
+{
+    return format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : 8;
+}
+
+//RGB and RGBA sources are both encoded from RGBA8
+static std::vector<unsigned char> toRGBA(const TextureImage& image)
+{
+    size_t count = (size_t)image.width * image.height;
+    std::vector<unsigned char> pixels(count * 4);
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned char* source = image.data + i * image.nrChannels;
+        pixels[i * 4 + 0] = source[0];
+        pixels[i * 4 + 1] = source[1];
+        pixels[i * 4 + 2] = source[2];
+        pixels[i * 4 + 3] = image.nrChannels == 4 ? source[3] : 255;
+    }
+    return pixels;
+}
+
+//2x2 box filter, same level sizes glGenerateMipmap produces
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& pixels, int width, int height, int& nextWidth, int& nextHeight)
+{
+    nextWidth = std::max(1, width / 2);
+    nextHeight = std::max(1, height / 2);
+    std::vector<unsigned char> next((size_t)nextWidth * nextHeight * 4);
+    for (int y = 0; y < nextHeight; y++)
+    {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < nextWidth; x++)
+        {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; c++)
+            {
+                int sum = pixels[((size_t)y0 * width + x0) * 4 + c] + pixels[((size_t)y0 * width + x1) * 4 + c] +
+                    pixels[((size_t)y1 * width + x0) * 4 + c] + pixels[((size_t)y1 * width + x1) * 4 + c];
+                next[((size_t)y * nextWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return next;
+}
+
+//4x4 block, edge pixels repeated past the image border
+static void fetchBlock(const unsigned char* pixels, int width, int height, int blockX, int blockY, unsigned char block[16][4])
+{
+    for (int i = 0; i < 16; i++)
+    {
+        int x = std::min(blockX * 4 + i % 4, width - 1);
+        int y = std::min(blockY * 4 + i / 4, height - 1);
+        memcpy(block[i], pixels + ((size_t)y * width + x) * 4, 4);
+    }
+}
+
+static uint16_t to565(const float color[3])
+{
+    int r = (int)std::lround(std::clamp(color[0], 0.f, 255.f) * 31.f / 255.f);
+    int g = (int)std::lround(std::clamp(color[1], 0.f, 255.f) * 63.f / 255.f);
+    int b = (int)std::lround(std::clamp(color[2], 0.f, 255.f) * 31.f / 255.f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void from565(uint16_t color, int rgb[3])
+{
+    int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+//endpoints at the extremes of the block's principal axis, then nearest of the 4 palette colors
+static void encodeColorBlock(const unsigned char block[16][4], unsigned char* out)
+{
+    float mean[3] = { 0.f, 0.f, 0.f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i][c] / 16.f;
+
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+        for (int a = 0; a < 3; a++)
+            for (int b = 0; b < 3; b++)
+                covariance[a][b] += d[a] * d[b];
+    }
+
+    float axis[3] = { 1.f, 1.f, 1.f };
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3];
+        for (int a = 0; a < 3; a++)
+            next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+        float largest = std::max({ std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2]) });
+        if (largest < 1e-6f)
+            break;
+        for (int a = 0; a < 3; a++)
+            axis[a] = next[a] / largest;
+    }
+    float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (int a = 0; a < 3; a++)
+        axis[a] /= length;
+
+    float lowest = 0.f, highest = 0.f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+    float high[3], low[3];
+    for (int a = 0; a < 3; a++)
+    {
+        high[a] = mean[a] + axis[a] * highest;
+        low[a] = mean[a] + axis[a] * lowest;
+    }
+
+    uint16_t color0 = to565(high), color1 = to565(low);
+    //color0 > color1 selects the 4 color mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    int palette[4][3];
+    from565(color0, palette[0]);
+    from565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = INT32_MAX;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int b = 0; b < 4; b++)
+        out[4 + b] = (indices >> (8 * b)) & 0xFF;
+}
+
+static void alphaPalette(int alpha0, int alpha1, int palette[8])
+{
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    if (alpha0 > alpha1)
+    {
+        for (int i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7;
+    }
+    else
+    {
+        //6 value mode, never written by the encoder but valid BC3
+        for (int i = 2; i < 6; i++)
+            palette[i] = ((6 - i) * alpha0 + (i - 1) * alpha1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static void encodeAlphaBlock(const unsigned char block[16][4], unsigned char* out)
+{
+    int alpha0 = 0, alpha1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        alpha0 = std::max(alpha0, (int)block[i][3]);
+        alpha1 = std::min(alpha1, (int)block[i][3]);
+    }
+    int palette[8];
+    alphaPalette(alpha0, alpha1, palette);
+
+    uint64_t indices = 0;
+    if (alpha0 != alpha1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            for (int p = 1; p < 8; p++)
+            {
+                if (std::abs(block[i][3] - palette[p]) < std::abs(block[i][3] - palette[best]))
+                    best = p;
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    out[0] = (unsigned char)alpha0;
+    out[1] = (unsigned char)alpha1;
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = (indices >> (8 * b)) & 0xFF;
+}
+
+static void decodeColorBlock(const unsigned char* in, unsigned char block[16][4])
+{
+    uint16_t color0 = in[0] | (in[1] << 8), color1 = in[2] | (in[3] << 8);
+    uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+    int palette[4][3];
+    from565(color0, palette[0]);
+    from565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        if (color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        int index = (indices >> (2 * i)) & 3;
+        for (int c = 0; c < 3; c++)
+            block[i][c] = (unsigned char)palette[index][c];
+        block[i][3] = 255;
+    }
+}
+
+static void decodeAlphaBlock(const unsigned char* in, unsigned char block[16][4])
+{
+    int palette[8];
+    alphaPalette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (int b = 0; b < 6; b++)
+        indices |= (uint64_t)in[2 + b] << (8 * b);
+    for (int i = 0; i < 16; i++)
+        block[i][3] = (unsigned char)palette[(indices >> (3 * i)) & 7];
+}
+
+static CookedLevel compressLevel(const std::vector<unsigned char>& pixels, int width, int height, GLenum format)
+{
+    CookedLevel level;
+    level.width = width;
+    level.height = height;
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    level.blocks.resize((size_t)blocksX * blocksY * blockSize(format));
+
+    unsigned char* out = level.blocks.data();
+    unsigned char block[16][4];
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            fetchBlock(pixels.data(), width, height, bx, by, block);
+            if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            {
+                encodeAlphaBlock(block, out);
+                out += 8;
+            }
+            encodeColorBlock(block, out);
+            out += 8;
+        }
+    }
+    return level;
+}
+
+static std::vector<unsigned char> decompressLevel(const CookedLevel& level, GLenum format)
+{
+    std::vector<unsigned char> pixels((size_t)level.width * level.height * 4);
+    int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+    const unsigned char* in = level.blocks.data();
+    unsigned char block[16][4];
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            {
+                decodeColorBlock(in + 8, block);
+                decodeAlphaBlock(in, block);
+            }
+            else
+                decodeColorBlock(in, block);
+            in += blockSize(format);
+
+            for (int i = 0; i < 16; i++)
+            {
+                int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x < level.width && y < level.height)
+                    memcpy(&pixels[((size_t)y * level.width + x) * 4], block[i], 4);
+            }
+        }
+    }
+    return pixels;
+}
+
+std::string TextureCachePath(const std::string& path)
+{
+    return path + ".mgtex";
+}
+
+bool LoadTextureCache(const std::string& path, CookedTexture& cooked)
+{
+    std::ifstream fin(TextureCachePath(path), std::ios::binary);
+    if (!fin.is_open())
+        return false;
+
+    TextureCacheHeader header;
+    if (!fin.read((char*)&header, sizeof(header)))
+        return false;
+    if (memcmp(header.magic, TEXTURE_CACHE_MAGIC, 4) != 0 || header.version != TEXTURE_CACHE_VERSION ||
+        (header.format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && header.format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT))
+        return false;
+
+    int64_t time;
+    if (!sourceKey(path, time))
+        return false;
+    //a touched but unchanged source (e.g. fresh checkout) still hits
+    if (time != header.sourceTime)
+    {
+        std::string bytes;
+        if (!readSourceBytes(path, bytes) || HashBytes(bytes.data(), bytes.size()) != header.sourceHash)
+            return false;
+    }
+
+    cooked.format = header.format;
+    cooked.levels.resize(header.nrOfLevels);
+    for (CookedLevel& level : cooked.levels)
+    {
+        TextureLevelHeader levelHeader;
+        if (!fin.read((char*)&levelHeader, sizeof(levelHeader)))
+            return false;
+        level.width = levelHeader.width;
+        level.height = levelHeader.height;
+        level.blocks.resize(levelHeader.size);
+        fin.read((char*)level.blocks.data(), levelHeader.size);
+    }
+    if (!fin)
+        return false;
+
+    //debug
+    std::cout << "Texture cache " << TextureCachePath(path) << " loaded with " << cooked.levels.size() << " levels!\n";
+    return true;
+}
+
+bool SaveTextureCache(const std::string& path, const CookedTexture& cooked)
+{
+    std::string bytes;
+    TextureCacheHeader header;
+    if (cooked.levels.empty() || !readSourceBytes(path, bytes) || !sourceKey(path, header.sourceTime))
+        return false;
+
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = cooked.format;
+    header.nrOfLevels = (uint32_t)cooked.levels.size();
+    header.sourceHash = HashBytes(bytes.data(), bytes.size());
+
+    std::ofstream fout(TextureCachePath(path), std::ios::binary | std::ios::trunc);
+    if (!fout.is_open())
+        return false;
+    fout.write((const char*)&header, sizeof(header));
+    for (const CookedLevel& level : cooked.levels)
+    {
+        TextureLevelHeader levelHeader = { level.width, level.height, (uint32_t)level.blocks.size() };
+        fout.write((const char*)&levelHeader, sizeof(levelHeader));
+        fout.write((const char*)level.blocks.data(), level.blocks.size());
+    }
+    return (bool)fout;
+}
+
+CookedTexture CompressTexture(const TextureImage& image)
+{
+    CookedTexture cooked;
+    if (!image.data || image.nrChannels < 3)
+        return cooked;
+
+    cooked.format = image.nrChannels == 4 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    std::vector<unsigned char> pixels = toRGBA(image);
+    int width = image.width, height = image.height;
+    while (true)
+    {
+        cooked.levels.push_back(compressLevel(pixels, width, height, cooked.format));
+        if (width == 1 && height == 1)
+            break;
+        pixels = downsample(pixels, width, height, width, height);
+    }
+    return cooked;
+}
+
+TextureData LoadTextureData(const std::string& path)
+{
+    TextureData data;
+    if (!LoadTextureCache(path, data.cooked))
+    {
+        data.cooked = CookedTexture();
+        data.image = DecodeTexture(path);
+    }
+    return data;
+}
+
+unsigned int UploadCookedTexture(const CookedTexture& cooked, unsigned int textureId)
+{
+    if (textureId == 0)
+        glGenTextures(1, &textureId);
+    glState.bindTexture2D(textureId);
+    for (size_t i = 0; i < cooked.levels.size(); i++)
+    {
+        const CookedLevel& level = cooked.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, cooked.format, level.width, level.height, 0,
+            (GLsizei)level.blocks.size(), level.blocks.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.levels.size() - 1);
+
+    // same wrapping and filtering as UploadTexture
+    GLint wrap = cooked.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureId;
+}
+
+unsigned int UploadTextureData(TextureData& data)
+{
+    if (!data.cooked.levels.empty())
+        return UploadCookedTexture(data.cooked);
+    return UploadTexture(data.image);
+}
+
+unsigned int LoadTexture(const std::string& path)
+{
+    CookedTexture cooked;
+    if (LoadTextureCache(path, cooked))
+        return UploadCookedTexture(cooked);
+    return CreateTexture(path);
+}
+
+static bool isTextureFile(const std::filesystem::path& file)
+{
+    std::string extension = file.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp" || extension == ".tga";
+}
+
+static double psnr(const std::vector<unsigned char>& source, const std::vector<unsigned char>& decoded, int nrChannels)
+{
+    double squaredError = 0.0;
+    size_t samples = 0;
+    for (size_t i = 0; i < source.size(); i += 4)
+    {
+        for (int c = 0; c < nrChannels; c++)
+        {
+            double d = (double)source[i + c] - decoded[i + c];
+            squaredError += d * d;
+            samples++;
+        }
+    }
+    if (squaredError == 0.0)
+        return INFINITY;
+    return 10.0 * std::log10(255.0 * 255.0 / (squaredError / samples));
+}
+
+void CookTextureCaches(const std::string& directory)
+{
+    size_t rawTotal = 0, cookedTotal = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+    {
+        if (!entry.is_regular_file() || !isTextureFile(entry.path()))
+            continue;
+        bool buildOutput = false;
+        for (const std::filesystem::path& part : entry.path())
+        {
+            if (part == "Debug" || part == "Release" || part == "x64")
+                buildOutput = true;
+        }
+        if (buildOutput)
+            continue;
+
+        std::string file = entry.path().string();
+        TextureImage image = DecodeTexture(file);
+        if (!image.data)
+        {
+            std::cout << "Failed to load texture: " << file << '\n';
+            continue;
+        }
+
+        auto begin = std::chrono::high_resolution_clock::now();
+        CookedTexture cooked = CompressTexture(image);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+        if (cooked.levels.empty())
+        {
+            std::cout << "Skipped " << file << " (" << image.nrChannels << " channels)\n";
+            stbi_image_free(image.data);
+            continue;
+        }
+
+        //what glTexImage2D + glGenerateMipmap keep resident, a full chain is ~4/3 of level 0
+        size_t raw = 0, size = 0;
+        for (const CookedLevel& level : cooked.levels)
+        {
+            raw += (size_t)level.width * level.height * image.nrChannels;
+            size += level.blocks.size();
+        }
+        rawTotal += raw;
+        cookedTotal += size;
+        double quality = psnr(toRGBA(image), decompressLevel(cooked.levels[0], cooked.format), image.nrChannels);
+        stbi_image_free(image.data);
+
+        bool written = SaveTextureCache(file, cooked);
+        std::cout << (written ? "Wrote " : "Failed to write ") << std::left << std::setw(56) << TextureCachePath(file) << std::right
+            << (cooked.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? " BC3 " : " BC1 ")
+            << image.width << 'x' << image.height << ", " << cooked.levels.size() << " levels, "
+            << raw / 1024 << " KB -> " << size / 1024 << " KB (" << (double)raw / size << "x), PSNR "
+            << quality << " dB, " << seconds * 1000.0 << " ms\n";
+    }
+    if (cookedTotal > 0)
+        std::cout << "Total " << rawTotal / 1024 << " KB -> " << cookedTotal / 1024 << " KB (" << (double)rawTotal / cookedTotal << "x)\n";
+}
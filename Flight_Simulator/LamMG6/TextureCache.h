@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "TextureLoader.h"
+
+//one pre-generated mip level, already in GPU block layout
+struct CookedLevel
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> blocks;
+};
+
+//BC1 for RGB sources, BC3 when there is an alpha channel
+struct CookedTexture
+{
+	GLenum format = 0;
+	std::vector<CookedLevel> levels;
+};
+
+//cooked blocks when a fresh .mgtex exists, decoded pixels otherwise
+struct TextureData
+{
+	TextureImage image;
+	CookedTexture cooked;
+};
+
+//.mgtex files sit next to their source image (Grass.jpg -> Grass.jpg.mgtex)
+std::string TextureCachePath(const std::string& path);
+bool LoadTextureCache(const std::string& path, CookedTexture& cooked);
+bool SaveTextureCache(const std::string& path, const CookedTexture& cooked);
+//box-filtered mip chain, block compressed on the CPU; empty for 1/2 channel images
+CookedTexture CompressTexture(const TextureImage& image);
+
+//no GL calls, safe on loader threads
+TextureData LoadTextureData(const std::string& path);
+//needs the GL context; uploads into textureId when given, frees decoded pixels
+unsigned int UploadCookedTexture(const CookedTexture& cooked, unsigned int textureId = 0);
+unsigned int UploadTextureData(TextureData& data);
+//cooked file when there is one, CreateTexture otherwise
+unsigned int LoadTexture(const std::string& path);
+
+//offline converter: writes a fresh .mgtex for every image under directory and
+//reports size ratio and PSNR of the top level against the decoded source
+void CookTextureCaches(const std::string& directory);
@@ -1,25 +1,32 @@
 #include "TextureLoader.h"
+#include "GLState.h"
 
-unsigned int CreateTexture(const std::string& strTexturePath)
+TextureImage DecodeTexture(const std::string& strTexturePath)
+{
+    TextureImage image;
+    image.path = strTexturePath;
+    //stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+    image.data = stbi_load(strTexturePath.c_str(), &image.width, &image.height, &image.nrChannels, 0);
+    return image;
+}
+
+unsigned int UploadTexture(TextureImage& image)
 {
     unsigned int textureId = -1;
 
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    //stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-    unsigned char* data = stbi_load(strTexturePath.c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
+    // create texture and generate mipmaps
+    if (image.data) {
         GLenum format;
-        if (nrChannels == 1)
+        if (image.nrChannels == 1)
             format = GL_RED;
-        else if (nrChannels == 3)
+        else if (image.nrChannels == 3)
             format = GL_RGB;
-        else if (nrChannels == 4)
+        else if (image.nrChannels == 4)
             format = GL_RGBA;
 
         glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glState.bindTexture2D(textureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         // set the texture wrapping parameters
@@ -30,9 +37,16 @@ unsigned int CreateTexture(const std::string& strTexturePath)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
     else {
-        std::cout << "Failed to load texture: " << strTexturePath << std::endl;
+        std::cout << "Failed to load texture: " << image.path << std::endl;
     }
-    stbi_image_free(data);
+    stbi_image_free(image.data);
+    image.data = nullptr;
 
     return textureId;
-}
\ No newline at end of file
+}
+
+unsigned int CreateTexture(const std::string& strTexturePath)
+{
+    TextureImage image = DecodeTexture(strTexturePath);
+    return UploadTexture(image);
+}
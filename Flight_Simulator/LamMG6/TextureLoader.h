@@ -4,4 +4,17 @@
 #include <stb_image.h>
 #include <iostream>
 
-	unsigned int CreateTexture(const std::string& strTexturePath);
\ No newline at end of file
+	//decoded pixels, safe to produce on any thread
+	struct TextureImage
+	{
+		std::string path;
+		int width = 0;
+		int height = 0;
+		int nrChannels = 0;
+		unsigned char* data = nullptr;
+	};
+
+	TextureImage DecodeTexture(const std::string& strTexturePath);
+	//needs the GL context, frees the pixels
+	unsigned int UploadTexture(TextureImage& image);
+	unsigned int CreateTexture(const std::string& strTexturePath);
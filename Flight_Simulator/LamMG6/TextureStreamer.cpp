@@ -0,0 +1,242 @@
+#include "TextureStreamer.h"
+#include "GLState.h"
+#include <algorithm>
+#include <cstring>
+
+TextureStreamer::TextureStreamer(size_t uploadBudget, unsigned int nrOfThreads)
+    : pool(nrOfThreads), uploadBudget(uploadBudget)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    for (auto& texture : textures)
+    {
+        if (texture.second.state == TextureState::Decoding)
+            texture.second.image = texture.second.decoded.get().image;
+        stbi_image_free(texture.second.image.data);
+        if (texture.second.staging != 0)
+            glState.deleteTexture(texture.second.staging);
+    }
+    for (GLsync& fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    if (PBO != 0)
+    {
+        if (mapped)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &PBO);
+    }
+}
+
+void TextureStreamer::initRing()
+{
+    glGenBuffers(1, &PBO);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+    GLsizeiptr size = (GLsizeiptr)(uploadBudget * RING_SEGMENTS);
+    if (GLEW_ARB_buffer_storage)
+    {
+        //persistent + coherent: written once per frame, never remapped
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    }
+    else
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+unsigned int TextureStreamer::request(const std::string& path)
+{
+    static const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+
+    unsigned int texture = 0;
+    glGenTextures(1, &texture);
+    glState.bindTexture2D(texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    StreamedTexture& streamed = textures[texture];
+    streamed.path = path;
+    streamed.decoded = pool.submit([path]() { return LoadTextureData(path); });
+    return texture;
+}
+
+//the segment is free once the GPU has consumed what was copied into it 3 updates ago
+bool TextureStreamer::acquireSegment()
+{
+    GLsync& fence = fences[segment];
+    if (!fence)
+        return true;
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        return false;
+    glDeleteSync(fence);
+    fence = nullptr;
+    return true;
+}
+
+void TextureStreamer::beginUpload(unsigned int texture, StreamedTexture& streamed)
+{
+    TextureImage& image = streamed.image;
+    if (!image.data)
+    {
+        std::cout << "Failed to load texture: " << streamed.path << std::endl;
+        streamed.state = TextureState::Failed;
+        return;
+    }
+    if (image.nrChannels == 1)
+        streamed.format = GL_RED;
+    else if (image.nrChannels == 4)
+        streamed.format = GL_RGBA;
+    else
+        streamed.format = GL_RGB;
+    streamed.rowBytes = (size_t)image.width * image.nrChannels;
+    streamed.state = TextureState::Uploading;
+    bytesInFlight += streamed.rowBytes * image.height;
+
+    //rows arrive in the staging texture over the next frames, texture keeps its placeholder
+    glGenTextures(1, &streamed.staging);
+    glState.bindTexture2D(streamed.staging);
+    glTexImage2D(GL_TEXTURE_2D, 0, streamed.format, image.width, image.height, 0, streamed.format, GL_UNSIGNED_BYTE, nullptr);
+}
+
+size_t TextureStreamer::uploadRows(StreamedTexture& streamed, size_t budget)
+{
+    TextureImage& image = streamed.image;
+    //whole rows when one fits the budget, else as much of the current row as does
+    int rows = 1, columns = image.width;
+    if (streamed.rowBytes <= budget)
+        rows = (int)std::min<size_t>(budget / streamed.rowBytes, (size_t)(image.height - streamed.nextRow));
+    else
+        columns = (int)std::min<size_t>(budget / image.nrChannels, (size_t)(image.width - streamed.nextColumn));
+    if (rows <= 0 || columns <= 0)
+        return 0;
+    size_t bytes = (size_t)rows * columns * image.nrChannels;
+    size_t offset = segment * uploadBudget;
+    const unsigned char* source = image.data + streamed.nextRow * streamed.rowBytes + (size_t)streamed.nextColumn * image.nrChannels;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+    if (mapped)
+        memcpy(mapped + offset, source, bytes);
+    else
+    {
+        void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        memcpy(target, source, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glState.bindTexture2D(streamed.staging);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, streamed.nextColumn, streamed.nextRow, columns, rows, streamed.format, GL_UNSIGNED_BYTE,
+        (const void*)offset);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    streamed.nextColumn += columns;
+    if (streamed.nextColumn >= image.width)
+    {
+        streamed.nextColumn = 0;
+        streamed.nextRow += rows;
+    }
+    bytesInFlight -= bytes;
+    return bytes;
+}
+
+void TextureStreamer::finish(unsigned int texture, StreamedTexture& streamed)
+{
+    //the placeholder is only replaced now, by a GPU side copy of the staged image
+    TextureImage& image = streamed.image;
+    glState.bindTexture2D(texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, streamed.format, image.width, image.height, 0, streamed.format, GL_UNSIGNED_BYTE, nullptr);
+    glCopyImageSubData(streamed.staging, GL_TEXTURE_2D, 0, 0, 0, 0, texture, GL_TEXTURE_2D, 0, 0, 0, 0, image.width, image.height, 1);
+    glState.deleteTexture(streamed.staging);
+    streamed.staging = 0;
+    glState.bindTexture2D(texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    // same wrapping and filtering as CreateTexture
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, streamed.format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, streamed.format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    stbi_image_free(streamed.image.data);
+    streamed.image.data = nullptr;
+    streamed.state = TextureState::Resident;
+    std::cout << "Texture " << streamed.path << " streamed in " << streamed.frames << " frames\n";
+}
+
+void TextureStreamer::update()
+{
+    bytesUploadedLastUpdate = 0;
+    if (PBO == 0)
+        initRing();
+
+    for (auto& texture : textures)
+    {
+        StreamedTexture& streamed = texture.second;
+        if (streamed.state == TextureState::Decoding &&
+            streamed.decoded.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            TextureData data = streamed.decoded.get();
+            if (!data.cooked.levels.empty())
+            {
+                UploadCookedTexture(data.cooked, texture.first);
+                streamed.state = TextureState::Resident;
+                std::cout << "Texture " << streamed.path << " loaded from " << TextureCachePath(streamed.path) << '\n';
+                continue;
+            }
+            streamed.image = data.image;
+            beginUpload(texture.first, streamed);
+        }
+    }
+
+    if (!acquireSegment())
+        return;
+    size_t budget = uploadBudget;
+    for (auto& texture : textures)
+    {
+        StreamedTexture& streamed = texture.second;
+        if (streamed.state != TextureState::Uploading)
+            continue;
+        streamed.frames++;
+        size_t uploaded = uploadRows(streamed, budget);
+        budget -= uploaded;
+        bytesUploadedLastUpdate += uploaded;
+        if (streamed.nextRow >= streamed.image.height)
+            finish(texture.first, streamed);
+        //one texture per segment keeps the PBO offsets simple
+        break;
+    }
+
+    if (bytesUploadedLastUpdate > 0)
+    {
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        segment = (segment + 1) % RING_SEGMENTS;
+    }
+}
+
+TextureState TextureStreamer::getState(unsigned int texture) const
+{
+    auto found = textures.find(texture);
+    return found == textures.end() ? TextureState::Failed : found->second.state;
+}
+
+int TextureStreamer::getPendingCount() const
+{
+    int pending = 0;
+    for (const auto& texture : textures)
+    {
+        if (texture.second.state == TextureState::Decoding || texture.second.state == TextureState::Uploading)
+            pending++;
+    }
+    return pending;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <future>
+#include <map>
+#include <string>
+#include "ThreadPool.h"
+#include "TextureCache.h"
+
+enum class TextureState
+{
+	Decoding,
+	Uploading,
+	Resident,
+	Failed
+};
+
+//Hands out texture names right away with a 1x1 placeholder bound to them,
+//decodes on a worker and uploads the pixels a few rows at a time through a
+//ring of pixel buffer objects, at most uploadBudget bytes per update(). The
+//rows go into a staging texture, the handed out name keeps its placeholder
+//until the last row is in and the whole image is copied over on the GPU.
+//Cooked .mgtex files are already small and go up in one piece.
+class TextureStreamer
+{
+private:
+	struct StreamedTexture
+	{
+		std::string path;
+		TextureState state = TextureState::Decoding;
+		std::future<TextureData> decoded;
+		TextureImage image;
+		GLenum format = GL_RGB;
+		GLuint staging = 0;
+		size_t rowBytes = 0;
+		int nextRow = 0;
+		//rows wider than uploadBudget go up in pieces, this is where the next one starts
+		int nextColumn = 0;
+		int frames = 0;
+	};
+
+	static const int RING_SEGMENTS = 3;
+
+	ThreadPool pool;
+	std::map<unsigned int, StreamedTexture> textures;
+	size_t uploadBudget;
+	GLuint PBO = 0;
+	unsigned char* mapped = nullptr;
+	GLsync fences[RING_SEGMENTS] = {};
+	int segment = 0;
+	size_t bytesInFlight = 0;
+	size_t bytesUploadedLastUpdate = 0;
+
+	void initRing();
+	bool acquireSegment();
+	void beginUpload(unsigned int texture, StreamedTexture& streamed);
+	size_t uploadRows(StreamedTexture& streamed, size_t budget);
+	void finish(unsigned int texture, StreamedTexture& streamed);
+
+public:
+	TextureStreamer(size_t uploadBudget = 4 * 1024 * 1024, unsigned int nrOfThreads = 2);
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	unsigned int request(const std::string& path);
+	//once per frame on the GL thread
+	void update();
+	TextureState getState(unsigned int texture) const;
+	size_t getBytesInFlight() const { return bytesInFlight; }
+	size_t getBytesUploadedLastUpdate() const { return bytesUploadedLastUpdate; }
+	int getPendingCount() const;
+};
@@ -0,0 +1,212 @@
+#include "Transform.h"
+#include <cmath>
+
+glm::mat4 ComposeTransform(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+{
+    //Rx * Rz * Ry written out, columns scaled, instead of three glm::rotate calls
+    float x = glm::radians(rotation.x), y = glm::radians(rotation.y), z = glm::radians(rotation.z);
+    float sx = std::sin(x), cx = std::cos(x);
+    float sy = std::sin(y), cy = std::cos(y);
+    float sz = std::sin(z), cz = std::cos(z);
+    glm::mat4 model;
+    model[0] = glm::vec4(cz * cy, cx * sz * cy + sx * sy, sx * sz * cy - cx * sy, 0.f) * scale.x;
+    model[1] = glm::vec4(-sz, cx * cz, sx * cz, 0.f) * scale.y;
+    model[2] = glm::vec4(cz * sy, cx * sz * sy - sx * cy, sx * sz * sy + cx * cy, 0.f) * scale.z;
+    model[3] = glm::vec4(position, 1.f);
+    return model;
+}
+
+TransformHandle TransformGraph::create(TransformHandle parent)
+{
+    TransformHandle node;
+    if (!freeNodes.empty())
+    {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else
+    {
+        node = (TransformHandle)flags.size();
+        positions.emplace_back();
+        rotations.emplace_back();
+        scales.emplace_back();
+        locals.emplace_back();
+        worlds.emplace_back();
+        parents.push_back(NO_TRANSFORM);
+        firstChildren.push_back(NO_TRANSFORM);
+        nextSiblings.push_back(NO_TRANSFORM);
+        flags.push_back(0);
+    }
+    positions[node] = glm::vec3(0.f);
+    rotations[node] = glm::vec3(0.f);
+    scales[node] = glm::vec3(1.f);
+    locals[node] = glm::mat4(1.f);
+    worlds[node] = glm::mat4(1.f);
+    parents[node] = firstChildren[node] = nextSiblings[node] = NO_TRANSFORM;
+    //no children yet, so flagging the node alone keeps the subtree rule
+    flags[node] = ALIVE | WORLD_DIRTY;
+    link(node, parent);
+    return node;
+}
+
+void TransformGraph::release(TransformHandle node)
+{
+    while (firstChildren[node] != NO_TRANSFORM)
+    {
+        TransformHandle child = firstChildren[node];
+        unlink(child);
+        markDirty(child, 0);
+    }
+    unlink(node);
+    flags[node] = 0;
+    freeNodes.push_back(node);
+}
+
+void TransformGraph::link(TransformHandle node, TransformHandle parent)
+{
+    parents[node] = parent;
+    if (parent == NO_TRANSFORM)
+        return;
+    nextSiblings[node] = firstChildren[parent];
+    firstChildren[parent] = node;
+}
+
+void TransformGraph::unlink(TransformHandle node)
+{
+    TransformHandle parent = parents[node];
+    if (parent != NO_TRANSFORM)
+    {
+        TransformHandle* next = &firstChildren[parent];
+        while (*next != node)
+            next = &nextSiblings[*next];
+        *next = nextSiblings[node];
+    }
+    parents[node] = NO_TRANSFORM;
+    nextSiblings[node] = NO_TRANSFORM;
+}
+
+bool TransformGraph::setParent(TransformHandle node, TransformHandle parent)
+{
+    if (parents[node] == parent)
+        return true;
+    for (TransformHandle above = parent; above != NO_TRANSFORM; above = parents[above])
+    {
+        if (above == node)
+            return false;
+    }
+    unlink(node);
+    link(node, parent);
+    markDirty(node, 0);
+    return true;
+}
+
+void TransformGraph::markDirty(TransformHandle node, uint8_t flag)
+{
+    flags[node] |= flag;
+    //the subtree below a flagged node is flagged already
+    if (flags[node] & WORLD_DIRTY)
+        return;
+    chain.clear();
+    chain.push_back(node);
+    while (!chain.empty())
+    {
+        TransformHandle next = chain.back();
+        chain.pop_back();
+        if (flags[next] & WORLD_DIRTY)
+            continue;
+        flags[next] |= WORLD_DIRTY;
+        for (TransformHandle child = firstChildren[next]; child != NO_TRANSFORM; child = nextSiblings[child])
+            chain.push_back(child);
+    }
+}
+
+void TransformGraph::setPosition(TransformHandle node, const glm::vec3& position)
+{
+    if (positions[node] == position && !(flags[node] & EXPLICIT_LOCAL))
+        return;
+    positions[node] = position;
+    flags[node] &= ~EXPLICIT_LOCAL;
+    markDirty(node, LOCAL_DIRTY);
+}
+
+void TransformGraph::setRotation(TransformHandle node, const glm::vec3& rotation)
+{
+    if (rotations[node] == rotation && !(flags[node] & EXPLICIT_LOCAL))
+        return;
+    rotations[node] = rotation;
+    flags[node] &= ~EXPLICIT_LOCAL;
+    markDirty(node, LOCAL_DIRTY);
+}
+
+void TransformGraph::setScale(TransformHandle node, const glm::vec3& scale)
+{
+    if (scales[node] == scale && !(flags[node] & EXPLICIT_LOCAL))
+        return;
+    scales[node] = scale;
+    flags[node] &= ~EXPLICIT_LOCAL;
+    markDirty(node, LOCAL_DIRTY);
+}
+
+void TransformGraph::setLocal(TransformHandle node, const glm::mat4& local)
+{
+    locals[node] = local;
+    flags[node] = (flags[node] | EXPLICIT_LOCAL) & ~LOCAL_DIRTY;
+    markDirty(node, 0);
+}
+
+const glm::mat4& TransformGraph::getLocal(TransformHandle node)
+{
+    if (flags[node] & LOCAL_DIRTY)
+    {
+        locals[node] = ComposeTransform(positions[node], rotations[node], scales[node]);
+        flags[node] &= ~LOCAL_DIRTY;
+    }
+    return locals[node];
+}
+
+void TransformGraph::resolve(TransformHandle node)
+{
+    //flagged ancestors come first, from the topmost one down
+    chain.clear();
+    for (TransformHandle above = node; above != NO_TRANSFORM && (flags[above] & WORLD_DIRTY); above = parents[above])
+        chain.push_back(above);
+    while (!chain.empty())
+    {
+        TransformHandle next = chain.back();
+        chain.pop_back();
+        const glm::mat4& local = getLocal(next);
+        worlds[next] = parents[next] == NO_TRANSFORM ? local : worlds[parents[next]] * local;
+        flags[next] &= ~WORLD_DIRTY;
+        recomputed++;
+    }
+}
+
+const glm::mat4& TransformGraph::getWorld(TransformHandle node)
+{
+    if (flags[node] & WORLD_DIRTY)
+        resolve(node);
+    return worlds[node];
+}
+
+size_t TransformGraph::update()
+{
+    size_t before = recomputed;
+    size_t count = flags.size();
+    for (size_t node = 0; node < count; node++)
+    {
+        if (!(flags[node] & WORLD_DIRTY))
+            continue;
+        TransformHandle parent = parents[node];
+        //parents usually come first and are clean by now, the rest go through resolve
+        if (parent != NO_TRANSFORM && (flags[parent] & WORLD_DIRTY))
+        {
+            resolve((TransformHandle)node);
+            continue;
+        }
+        const glm::mat4& local = getLocal((TransformHandle)node);
+        worlds[node] = parent == NO_TRANSFORM ? local : worlds[parent] * local;
+        flags[node] &= ~WORLD_DIRTY;
+        recomputed++;
+    }
+    return recomputed - before;
+}
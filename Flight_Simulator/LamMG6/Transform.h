@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm.hpp>
+
+//index of a node in a TransformGraph
+using TransformHandle = uint32_t;
+const TransformHandle NO_TRANSFORM = 0xFFFFFFFF;
+
+//translate * rotate x, z, y (degrees) * scale, the order Mesh has always used
+glm::mat4 ComposeTransform(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
+
+//Parent/child transforms kept as a structure of arrays. Setters only flag the node
+//and its subtree; local and world matrices are rebuilt by update() in one pass over
+//the flags, or on demand by getWorld() for the chain above one node. A node whose
+//world is flagged always has its whole subtree flagged, so both stop early.
+//Not thread safe: the main thread owns it.
+class TransformGraph
+{
+private:
+	enum : uint8_t
+	{
+		LOCAL_DIRTY = 1,
+		WORLD_DIRTY = 2,
+		//local came from setLocal, not from position, rotation and scale
+		EXPLICIT_LOCAL = 4,
+		ALIVE = 8
+	};
+
+	std::vector<glm::vec3> positions, rotations, scales;
+	std::vector<glm::mat4> locals, worlds;
+	std::vector<TransformHandle> parents, firstChildren, nextSiblings;
+	std::vector<uint8_t> flags;
+	std::vector<TransformHandle> freeNodes;
+	//scratch for walks down a subtree and up a chain of ancestors
+	std::vector<TransformHandle> chain;
+	size_t recomputed = 0;
+
+	void markDirty(TransformHandle node, uint8_t flag);
+	void link(TransformHandle node, TransformHandle parent);
+	void unlink(TransformHandle node);
+	void resolve(TransformHandle node);
+
+public:
+	//identity local, under parent when given
+	TransformHandle create(TransformHandle parent = NO_TRANSFORM);
+	//the node's children become roots with their locals unchanged
+	void release(TransformHandle node);
+	//false (and nothing changes) when parent is the node or below it
+	bool setParent(TransformHandle node, TransformHandle parent);
+
+	//unchanged values don't flag anything
+	void setPosition(TransformHandle node, const glm::vec3& position);
+	void setRotation(TransformHandle node, const glm::vec3& rotation);
+	void setScale(TransformHandle node, const glm::vec3& scale);
+	//replaces the local matrix until the next position, rotation or scale
+	void setLocal(TransformHandle node, const glm::mat4& local);
+
+	const glm::vec3& getPosition(TransformHandle node) const { return positions[node]; }
+	const glm::vec3& getRotation(TransformHandle node) const { return rotations[node]; }
+	const glm::vec3& getScale(TransformHandle node) const { return scales[node]; }
+	TransformHandle getParent(TransformHandle node) const { return parents[node]; }
+	const glm::mat4& getLocal(TransformHandle node);
+	//brings the node and its ancestors up to date first
+	const glm::mat4& getWorld(TransformHandle node);
+
+	//every flagged node, returns how many world matrices were rebuilt
+	size_t update();
+	size_t getNodeCount() const { return flags.size() - freeNodes.size(); }
+	//world matrices rebuilt so far, by update() and getWorld()
+	size_t getRecomputeCount() const { return recomputed; }
+};
+
+//the graph every Mesh places itself in
+inline TransformGraph sceneTransforms;
+
+//Owns one node of a graph: released with the owner, moved with it, never copied.
+class TransformNode
+{
+private:
+	TransformGraph* graph = nullptr;
+	TransformHandle handle = NO_TRANSFORM;
+
+public:
+	TransformNode() = default;
+	explicit TransformNode(TransformGraph& graph, TransformHandle parent = NO_TRANSFORM)
+		: graph(&graph), handle(graph.create(parent)) {}
+	~TransformNode() { reset(); }
+	TransformNode(TransformNode&& other) noexcept
+		: graph(std::exchange(other.graph, nullptr)), handle(std::exchange(other.handle, NO_TRANSFORM)) {}
+	TransformNode& operator=(TransformNode&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			graph = std::exchange(other.graph, nullptr);
+			handle = std::exchange(other.handle, NO_TRANSFORM);
+		}
+		return *this;
+	}
+	TransformNode(const TransformNode&) = delete;
+	TransformNode& operator=(const TransformNode&) = delete;
+
+	void reset()
+	{
+		if (graph != nullptr && handle != NO_TRANSFORM)
+			graph->release(handle);
+		graph = nullptr;
+		handle = NO_TRANSFORM;
+	}
+	TransformGraph* getGraph() const { return graph; }
+	TransformHandle get() const { return handle; }
+};
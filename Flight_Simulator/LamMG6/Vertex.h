@@ -1,5 +1,7 @@
 #pragma once
 #include <glm.hpp>
+#include <gtc/packing.hpp>
+#include <cstdint>
 
 struct Vertex
 {
@@ -10,5 +12,29 @@ struct Vertex
 	glm::vec3 ambient;
 	glm::vec3 diffuse;
 	glm::vec3 specular;
+	//material index, what the loader groups triangles into draw ranges by
 	int colorID = -1;
-};
\ No newline at end of file
+};
+
+//20 byte vertex: the material comes from the draw range, not the vertex
+struct CompactVertex
+{
+	glm::vec3 position;
+	uint32_t normal;	//snorm 10_10_10_2, GL_INT_2_10_10_10_REV
+	uint32_t texcoord;	//2 x half float
+};
+
+enum class VertexLayout
+{
+	Full,
+	Compact
+};
+
+inline CompactVertex toCompactVertex(const Vertex& vertex)
+{
+	CompactVertex compact;
+	compact.position = vertex.position;
+	compact.normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.normal, 0.f));
+	compact.texcoord = glm::packHalf2x16(vertex.texcoord);
+	return compact;
+}